@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "olcPixelGameEngine.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // Buffer
+    //   Fixed length array of typed elements shared between Lua
+    //   and the engine. Owned buffers keep their elements right
+    //   after the header in the same allocation, views point into
+    //   memory owned by someone else (e.g. sprite pixels). Buffers
+    //   received from another Lua state own a separate heap block.
+    //   Lua userdata is only aligned to LUAI_MAXALIGN, so the header
+    //   asks for nothing more than that.
+    /////////////////////////////////////////////////
+    struct Buffer {
+        enum Type : uint8_t {
+            F32,
+            I32,
+            U8,
+            RGBA,
+        };
+
+        Type type;
+        size_t length;
+        uint8_t *data;
+        // pixels viewed by this buffer, their span cache goes stale on writes
+        olc::Sprite *sprite;
+        // new[] block behind data, freed with the buffer
+        uint8_t *heap;
+
+        static size_t ElementSize(Type type) {
+            switch (type) {
+                case U8:
+                    return 1;
+                default:
+                    return 4;
+            }
+        }
+
+        inline size_t Bytes() const { return length * ElementSize(type); }
+
+        template<typename T>
+        inline T *As() const { return (T *) data; }
+
+        double Get(size_t i) const {
+            switch (type) {
+                case F32:
+                    return As<float>()[i];
+                case I32:
+                    return As<int32_t>()[i];
+                case U8:
+                    return data[i];
+                case RGBA:
+                    return As<uint32_t>()[i];
+            }
+            return 0.0;
+        }
+
+        void Set(size_t i, double v) {
+            switch (type) {
+                case F32:
+                    As<float>()[i] = float(v);
+                    break;
+                case I32:
+                    As<int32_t>()[i] = int32_t(v);
+                    break;
+                case U8:
+                    data[i] = uint8_t(v);
+                    break;
+                case RGBA:
+                    As<uint32_t>()[i] = uint32_t(int64_t(v));
+                    break;
+            }
+        }
+
+        void Fill(double v, size_t first, size_t count) {
+            if (first >= length)
+                return;
+            count = std::min(count, length - first);
+
+            switch (type) {
+                case F32:
+                    std::fill_n(As<float>() + first, count, float(v));
+                    break;
+                case I32:
+                    std::fill_n(As<int32_t>() + first, count, int32_t(v));
+                    break;
+                case U8:
+                    std::memset(data + first, uint8_t(v), count);
+                    break;
+                case RGBA:
+                    std::fill_n(As<uint32_t>() + first, count, uint32_t(int64_t(v)));
+                    break;
+            }
+            Touch();
+        }
+
+        // Copies elements of the same type, overlapping ranges are fine
+        bool Copy(const Buffer &src, size_t dstOffset, size_t srcOffset, size_t count) {
+            if (src.type != type || dstOffset > length || srcOffset > src.length)
+                return false;
+
+            count = std::min({count, length - dstOffset, src.length - srcOffset});
+            size_t size = ElementSize(type);
+            std::memmove(data + dstOffset * size, src.data + srcOffset * size, count * size);
+            Touch();
+            return true;
+        }
+
+        // Takes the elements out and leaves the buffer empty. A heap block is
+        // handed over as is, other storage is copied into a new one.
+        uint8_t *Detach() {
+            uint8_t *block = heap;
+            if (block == nullptr) {
+                block = new uint8_t[std::max<size_t>(Bytes(), 1)];
+                std::memcpy(block, data, Bytes());
+            }
+
+            length = 0;
+            data = nullptr;
+            sprite = nullptr;
+            heap = nullptr;
+            return block;
+        }
+
+        inline void Touch() {
+            if (sprite)
+                sprite->InvalidateSpanCache();
+        }
+    };
+
+    // owned elements start right after the header
+    static_assert(sizeof(Buffer) % alignof(double) == 0, "Buffer header must keep its elements aligned");
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "olcPixelGameEngine.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // CommandBuffer
+    //   Packed list of draw operations recorded once and replayed
+    //   by Submit. Each command is an op word followed by 32-bit
+    //   arguments, sprites/decals and strings are stored on the side
+    //   and referenced by index. Submitting does not consume the
+    //   commands, an unchanged buffer can be submitted every frame.
+    /////////////////////////////////////////////////
+    class CommandBuffer {
+    public:
+        enum Op : uint32_t {
+            CLEAR,
+            DRAW,
+            DRAW_LINE,
+            DRAW_RECT,
+            FILL_RECT,
+            DRAW_CIRCLE,
+            FILL_CIRCLE,
+            DRAW_TRIANGLE,
+            FILL_TRIANGLE,
+            DRAW_SPRITE,
+            DRAW_PARTIAL_SPRITE,
+            DRAW_STRING,
+            DRAW_DECAL,
+            DRAW_ROTATED_DECAL,
+            SET_PIXEL_MODE,
+            SET_PIXEL_BLEND,
+        };
+
+    public:
+        inline size_t Count() const { return _count; }
+
+        inline size_t GetWords() const { return _words.size(); }
+
+        void Reset() {
+            _words.clear();
+            _pointers.clear();
+            _strings.clear();
+            _count = 0;
+        }
+
+        // Appends an op, the arguments follow through the Push* calls
+        inline void Begin(Op op) {
+            _words.push_back(op);
+            _count++;
+        }
+
+        inline void PushInt(int32_t v) { _words.push_back(uint32_t(v)); }
+
+        inline void PushFloat(float v) {
+            uint32_t w;
+            std::memcpy(&w, &v, sizeof(w));
+            _words.push_back(w);
+        }
+
+        inline void PushPixel(olc::Pixel p) { _words.push_back(p.n); }
+
+        inline void PushPointer(void *p) {
+            _words.push_back(uint32_t(_pointers.size()));
+            _pointers.push_back(p);
+        }
+
+        inline void PushString(std::string s) {
+            _words.push_back(uint32_t(_strings.size()));
+            _strings.push_back(std::move(s));
+        }
+
+        void Submit(olc::PixelGameEngine *pge) const {
+            const uint32_t *w = _words.data();
+            const uint32_t *end = w + _words.size();
+
+            while (w < end) {
+                switch (Op(*w++)) {
+                    case CLEAR:
+                        pge->Clear(olc::Pixel(w[0]));
+                        w += 1;
+                        break;
+                    case DRAW:
+                        pge->Draw(I(w[0]), I(w[1]), olc::Pixel(w[2]));
+                        w += 3;
+                        break;
+                    case DRAW_LINE:
+                        pge->DrawLine(I(w[0]), I(w[1]), I(w[2]), I(w[3]), olc::Pixel(w[4]));
+                        w += 5;
+                        break;
+                    case DRAW_RECT:
+                        pge->DrawRect(I(w[0]), I(w[1]), I(w[2]), I(w[3]), olc::Pixel(w[4]));
+                        w += 5;
+                        break;
+                    case FILL_RECT:
+                        pge->FillRect(I(w[0]), I(w[1]), I(w[2]), I(w[3]), olc::Pixel(w[4]));
+                        w += 5;
+                        break;
+                    case DRAW_CIRCLE:
+                        pge->DrawCircle(I(w[0]), I(w[1]), I(w[2]), olc::Pixel(w[3]));
+                        w += 4;
+                        break;
+                    case FILL_CIRCLE:
+                        pge->FillCircle(I(w[0]), I(w[1]), I(w[2]), olc::Pixel(w[3]));
+                        w += 4;
+                        break;
+                    case DRAW_TRIANGLE:
+                        pge->DrawTriangle(I(w[0]), I(w[1]), I(w[2]), I(w[3]), I(w[4]), I(w[5]), olc::Pixel(w[6]));
+                        w += 7;
+                        break;
+                    case FILL_TRIANGLE:
+                        pge->FillTriangle(I(w[0]), I(w[1]), I(w[2]), I(w[3]), I(w[4]), I(w[5]), olc::Pixel(w[6]));
+                        w += 7;
+                        break;
+                    case DRAW_SPRITE:
+                        pge->DrawSprite(I(w[0]), I(w[1]), (olc::Sprite *) _pointers[w[2]], w[3]);
+                        w += 4;
+                        break;
+                    case DRAW_PARTIAL_SPRITE:
+                        pge->DrawPartialSprite(I(w[0]), I(w[1]), (olc::Sprite *) _pointers[w[2]],
+                                               I(w[3]), I(w[4]), I(w[5]), I(w[6]), w[7]);
+                        w += 8;
+                        break;
+                    case DRAW_STRING:
+                        pge->DrawString(I(w[0]), I(w[1]), _strings[w[2]], olc::Pixel(w[3]), w[4]);
+                        w += 5;
+                        break;
+                    case DRAW_DECAL:
+                        pge->DrawDecal({F(w[0]), F(w[1])}, (olc::Decal *) _pointers[w[2]],
+                                       {F(w[3]), F(w[4])}, olc::Pixel(w[5]));
+                        w += 6;
+                        break;
+                    case DRAW_ROTATED_DECAL:
+                        pge->DrawRotatedDecal({F(w[0]), F(w[1])}, (olc::Decal *) _pointers[w[2]], F(w[3]),
+                                              {F(w[4]), F(w[5])}, {F(w[6]), F(w[7])}, olc::Pixel(w[8]));
+                        w += 9;
+                        break;
+                    case SET_PIXEL_MODE:
+                        pge->SetPixelMode(olc::Pixel::Mode(w[0]));
+                        w += 1;
+                        break;
+                    case SET_PIXEL_BLEND:
+                        pge->SetPixelBlend(F(w[0]));
+                        w += 1;
+                        break;
+                }
+            }
+        }
+
+    private:
+        static inline int32_t I(uint32_t w) { return int32_t(w); }
+
+        static inline float F(uint32_t w) {
+            float v;
+            std::memcpy(&v, &w, sizeof(v));
+            return v;
+        }
+
+    private:
+        std::vector<uint32_t> _words;
+        std::vector<void *> _pointers;
+        std::vector<std::string> _strings;
+        size_t _count = 0;
+    };
+}
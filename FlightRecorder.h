@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // FlightRecorder
+    //   Always-on ring of per frame records. When a frame blows the
+    //   spike budget the app writes the ring out, so the frames that
+    //   led up to a hitch can be inspected after the fact.
+    //
+    //   File layout, every field a little endian 32-bit word:
+    //     FlightHeader, then `count` FlightRecords, oldest first
+    /////////////////////////////////////////////////
+    struct FlightRecord {
+        uint32_t frame = 0;
+        // whole frame and its engine phases
+        float frameMs = 0.0f;
+        float inputMs = 0.0f;
+        float updateMs = 0.0f;
+        float layersMs = 0.0f;
+        float displayMs = 0.0f;
+        // parts of updateMs
+        float luaMs = 0.0f;
+        float gcMs = 0.0f;
+        uint32_t gcSteps = 0;
+        uint32_t gcCycles = 0;
+        uint32_t gcFullCollect = 0;
+        uint32_t heapKB = 0;
+        uint32_t externalKB = 0;
+        uint32_t decals = 0;
+        uint32_t drawCalls = 0;
+        uint32_t uploadBytes = 0;
+
+        // Visits the fields in file order, adding one here changes the format
+        template<typename F>
+        void Fields(F &&f) {
+            f(frame);
+            f(frameMs);
+            f(inputMs);
+            f(updateMs);
+            f(layersMs);
+            f(displayMs);
+            f(luaMs);
+            f(gcMs);
+            f(gcSteps);
+            f(gcCycles);
+            f(gcFullCollect);
+            f(heapKB);
+            f(externalKB);
+            f(decals);
+            f(drawCalls);
+            f(uploadBytes);
+        }
+    };
+
+    struct FlightHeader {
+        static constexpr uint32_t Magic = 0x52464750; // "PGFR"
+        static constexpr uint32_t Version = 1;
+
+        uint32_t magic = Magic;
+        uint32_t version = Version;
+        // lets readers skip fields added by newer versions
+        uint32_t recordWords = 0;
+        uint32_t count = 0;
+        // index of the record that triggered the dump
+        uint32_t trigger = 0;
+        float budgetMs = 0.0f;
+
+        template<typename F>
+        void Fields(F &&f) {
+            f(magic);
+            f(version);
+            f(recordWords);
+            f(count);
+            f(trigger);
+            f(budgetMs);
+        }
+    };
+
+    class FlightRecorder {
+    public:
+        explicit FlightRecorder(size_t capacity = 240) {
+            SetCapacity(capacity);
+        }
+
+        // Drops the recorded frames
+        void SetCapacity(size_t capacity) {
+            _records.assign(capacity > 0 ? capacity : 1, FlightRecord());
+            _next = 0;
+            _size = 0;
+        }
+
+        inline size_t Capacity() const { return _records.size(); }
+
+        inline size_t Size() const { return _size; }
+
+        // Slot for the next frame, overwrites the oldest once the ring is full
+        FlightRecord &Next() {
+            FlightRecord &record = _records[_next];
+            record = FlightRecord();
+            _next = (_next + 1) % _records.size();
+            if (_size < _records.size())
+                _size++;
+            return record;
+        }
+
+        // i = 0 is the oldest frame still in the ring
+        inline const FlightRecord &At(size_t i) const {
+            return _records[(_next + _records.size() - _size + i) % _records.size()];
+        }
+
+        // Writes the ring, the newest record is marked as the trigger
+        bool Write(const char *path, float budgetMs) const {
+            std::FILE *out = std::fopen(path, "wb");
+            if (out == nullptr)
+                return false;
+
+            FlightHeader header;
+            header.recordWords = WordCount<FlightRecord>();
+            header.count = uint32_t(_size);
+            header.trigger = _size > 0 ? uint32_t(_size - 1) : 0;
+            header.budgetMs = budgetMs;
+
+            std::vector<uint8_t> bytes;
+            bytes.reserve((WordCount<FlightHeader>() + _size * header.recordWords) * 4);
+            Put(bytes, header);
+            for (size_t i = 0; i < _size; i++)
+                Put(bytes, At(i));
+
+            bool written = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+            return std::fclose(out) == 0 && written;
+        }
+
+        static bool Read(const char *path, FlightHeader &header, std::vector<FlightRecord> &records) {
+            std::FILE *in = std::fopen(path, "rb");
+            if (in == nullptr)
+                return false;
+
+            std::vector<uint8_t> bytes;
+            uint8_t buffer[4096];
+            size_t n;
+            while ((n = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+                bytes.insert(bytes.end(), buffer, buffer + n);
+            std::fclose(in);
+
+            size_t pos = 0;
+            if (!Get(bytes, pos, header, WordCount<FlightHeader>()) ||
+                header.magic != FlightHeader::Magic || header.recordWords == 0)
+                return false;
+
+            // the records must fit in what is left before anything is allocated for them
+            size_t recordBytes = size_t(header.recordWords) * 4;
+            if (header.count > (bytes.size() - pos) / recordBytes)
+                return false;
+
+            records.assign(header.count, FlightRecord());
+            for (FlightRecord &record : records) {
+                if (!Get(bytes, pos, record, header.recordWords))
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        template<typename T>
+        static uint32_t WordCount() {
+            uint32_t words = 0;
+            T().Fields([&words](auto &) { words++; });
+            return words;
+        }
+
+        template<typename T>
+        static void Put(std::vector<uint8_t> &bytes, T value) {
+            value.Fields([&bytes](auto &field) {
+                uint32_t w;
+                std::memcpy(&w, &field, 4);
+                for (int i = 0; i < 4; i++)
+                    bytes.push_back(uint8_t(w >> (8 * i)));
+            });
+        }
+
+        // Reads `words` words into the known fields, extra ones are skipped
+        template<typename T>
+        static bool Get(const std::vector<uint8_t> &bytes, size_t &pos, T &value, uint32_t words) {
+            if (pos + size_t(words) * 4 > bytes.size())
+                return false;
+
+            size_t end = pos + size_t(words) * 4;
+            value.Fields([&](auto &field) {
+                if (pos >= end)
+                    return;
+                uint32_t w = 0;
+                for (int i = 0; i < 4; i++)
+                    w |= uint32_t(bytes[pos + i]) << (8 * i);
+                std::memcpy(&field, &w, 4);
+                pos += 4;
+            });
+            pos = end;
+            return true;
+        }
+
+    private:
+        std::vector<FlightRecord> _records;
+        size_t _next = 0;
+        size_t _size = 0;
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // JobKernel
+    //   Native loop over buffer elements that Lua can run on the job
+    //   system. The first buffer sets the element range, the others
+    //   must be at least as long. A kernel only touches elements in
+    //   [first, last), so chunks can run on any thread.
+    /////////////////////////////////////////////////
+    struct JobKernel {
+        using Fn = void (*)(Buffer *const *buffers, const double *numbers, size_t first, size_t last);
+
+        // limit on both buffers and numbers
+        static constexpr int MaxArgs = 8;
+
+        std::string name;
+        std::vector<Buffer::Type> buffers;
+        int numbers = 0;
+        Fn fn = nullptr;
+        // smallest chunk worth a job
+        size_t grain = 16384;
+    };
+
+    /////////////////////////////////////////////////
+    // JobKernels
+    //   Name -> kernel registry shared by every Lua state. Register
+    //   kernels before the game starts, lookups are not locked.
+    /////////////////////////////////////////////////
+    class JobKernels {
+    public:
+        static JobKernels &Get() {
+            static JobKernels kernels;
+            return kernels;
+        }
+
+        // Replaces a kernel of the same name, false when it takes too many arguments
+        bool Register(const JobKernel &kernel) {
+            if (kernel.buffers.size() > JobKernel::MaxArgs || kernel.numbers > JobKernel::MaxArgs)
+                return false;
+
+            for (JobKernel &k : _kernels) {
+                if (k.name == kernel.name) {
+                    k = kernel;
+                    return true;
+                }
+            }
+            _kernels.push_back(kernel);
+            return true;
+        }
+
+        const JobKernel *Find(const char *name) const {
+            for (const JobKernel &k : _kernels) {
+                if (k.name == name)
+                    return &k;
+            }
+            return nullptr;
+        }
+
+        inline const std::vector<JobKernel> &All() const { return _kernels; }
+
+    private:
+        JobKernels() {
+            // x *= a
+            Register({"scale", {Buffer::F32}, 1, [](Buffer *const *b, const double *n, size_t first, size_t last) {
+                float *x = b[0]->As<float>();
+                const auto a = float(n[0]);
+                for (size_t i = first; i < last; i++)
+                    x[i] *= a;
+            }});
+
+            // y += a * x
+            Register({"axpy", {Buffer::F32, Buffer::F32}, 1, [](Buffer *const *b, const double *n, size_t first, size_t last) {
+                float *y = b[0]->As<float>();
+                const float *x = b[1]->As<float>();
+                const auto a = float(n[0]);
+                for (size_t i = first; i < last; i++)
+                    y[i] += a * x[i];
+            }});
+
+            // x = min(max(x, lo), hi)
+            Register({"clamp", {Buffer::F32}, 2, [](Buffer *const *b, const double *n, size_t first, size_t last) {
+                float *x = b[0]->As<float>();
+                const auto lo = float(n[0]), hi = float(n[1]);
+                for (size_t i = first; i < last; i++)
+                    x[i] = std::min(std::max(x[i], lo), hi);
+            }});
+
+            // multiplies every channel by r, g, b, a / 255
+            Register({"tint", {Buffer::RGBA}, 4, [](Buffer *const *b, const double *n, size_t first, size_t last) {
+                auto *p = b[0]->As<olc::Pixel>();
+                uint32_t m[4];
+                for (int c = 0; c < 4; c++)
+                    m[c] = uint32_t(std::min(std::max(n[c], 0.0), 255.0));
+                auto mul = [](uint8_t v, uint32_t f) { uint32_t x = v * f + 128; return uint8_t((x + (x >> 8)) >> 8); };
+                for (size_t i = first; i < last; i++)
+                    p[i] = olc::Pixel(mul(p[i].r, m[0]), mul(p[i].g, m[1]), mul(p[i].b, m[2]), mul(p[i].a, m[3]));
+            }, 8192});
+        }
+
+    private:
+        std::vector<JobKernel> _kernels;
+    };
+}
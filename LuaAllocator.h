@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // LuaAllocator
+    //   lua_Alloc with size class free lists for the small blocks
+    //   Lua churns through (tables, closures, short strings).
+    //   Blocks are carved out of large chunks and recycled through
+    //   the free lists, larger requests go to realloc/free.
+    /////////////////////////////////////////////////
+    class LuaAllocator {
+    public:
+        static constexpr size_t ChunkSize = 64 * 1024;
+        static constexpr size_t MaxSmallSize = 256;
+        static constexpr size_t ClassCount = 12;
+        static constexpr size_t ClassSizes[ClassCount] = {16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256};
+
+        struct ClassStats {
+            size_t size = 0;
+            size_t inUse = 0;
+            size_t peak = 0;
+            size_t allocs = 0;
+            size_t frees = 0;
+            size_t chunks = 0;
+        };
+
+        struct LargeStats {
+            size_t bytes = 0;
+            size_t peakBytes = 0;
+            size_t allocs = 0;
+            size_t frees = 0;
+        };
+
+    public:
+        LuaAllocator() {
+            for (size_t i = 0; i < ClassCount; i++)
+                _classes[i].stats.size = ClassSizes[i];
+
+            for (size_t n = 0, c = 0; n < _lookup.size(); n++) {
+                while (ClassSizes[c] < n * 16)
+                    c++;
+                _lookup[n] = uint8_t(c);
+            }
+        }
+
+        LuaAllocator(const LuaAllocator &) = delete;
+
+        ~LuaAllocator() {
+            for (void *chunk : _chunks)
+                std::free(chunk);
+        }
+
+        // lua_Alloc entry point, ud is the allocator
+        static void *Alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+            auto self = (LuaAllocator *) ud;
+
+            // for new blocks osize encodes the object type, not a size
+            if (ptr == nullptr)
+                osize = 0;
+
+            if (nsize == 0) {
+                if (ptr)
+                    self->Free(ptr, osize);
+                return nullptr;
+            }
+
+            if (ptr == nullptr)
+                return self->Allocate(nsize);
+
+            return self->Reallocate(ptr, osize, nsize);
+        }
+
+    public:
+        inline const ClassStats &GetClassStats(size_t i) const { return _classes[i].stats; }
+
+        inline const LargeStats &GetLargeStats() const { return _large; }
+
+        // Bytes handed to Lua, small blocks count their full class size
+        size_t GetBytesInUse() const {
+            size_t bytes = _large.bytes;
+            for (const auto &c : _classes)
+                bytes += c.stats.inUse * c.stats.size;
+            return bytes;
+        }
+
+        inline size_t GetChunkBytes() const { return _chunks.size() * ChunkSize; }
+
+    private:
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        struct SizeClass {
+            FreeBlock *free = nullptr;
+            uint8_t *cursor = nullptr;
+            uint8_t *end = nullptr;
+            ClassStats stats;
+        };
+
+        inline size_t ClassOf(size_t size) const {
+            return _lookup[(size + 15) >> 4];
+        }
+
+        void *Allocate(size_t size) {
+            if (size > MaxSmallSize) {
+                void *ptr = std::malloc(size);
+                if (ptr) {
+                    _large.allocs++;
+                    _large.bytes += size;
+                    if (_large.bytes > _large.peakBytes)
+                        _large.peakBytes = _large.bytes;
+                }
+                return ptr;
+            }
+
+            SizeClass &c = _classes[ClassOf(size)];
+            void *ptr = nullptr;
+
+            if (c.free) {
+                ptr = c.free;
+                c.free = c.free->next;
+            } else {
+                if (c.cursor == c.end) {
+                    auto chunk = (uint8_t *) std::malloc(ChunkSize);
+                    if (chunk == nullptr)
+                        return nullptr;
+
+                    _chunks.push_back(chunk);
+                    c.stats.chunks++;
+                    c.cursor = chunk;
+                    c.end = chunk + (ChunkSize / c.stats.size) * c.stats.size;
+                }
+
+                ptr = c.cursor;
+                c.cursor += c.stats.size;
+            }
+
+            c.stats.allocs++;
+            if (++c.stats.inUse > c.stats.peak)
+                c.stats.peak = c.stats.inUse;
+
+            return ptr;
+        }
+
+        void Free(void *ptr, size_t size) {
+            if (size > MaxSmallSize) {
+                std::free(ptr);
+                _large.frees++;
+                _large.bytes -= size;
+                return;
+            }
+
+            SizeClass &c = _classes[ClassOf(size)];
+            auto block = (FreeBlock *) ptr;
+            block->next = c.free;
+            c.free = block;
+
+            c.stats.frees++;
+            c.stats.inUse--;
+        }
+
+        void *Reallocate(void *ptr, size_t osize, size_t nsize) {
+            if (osize > MaxSmallSize && nsize > MaxSmallSize) {
+                void *nptr = std::realloc(ptr, nsize);
+                if (nptr) {
+                    _large.bytes += nsize - osize;
+                    if (_large.bytes > _large.peakBytes)
+                        _large.peakBytes = _large.bytes;
+                }
+                return nptr;
+            }
+
+            // still fits the same class, nothing to move
+            if (osize <= MaxSmallSize && nsize <= MaxSmallSize && ClassOf(osize) == ClassOf(nsize))
+                return ptr;
+
+            void *nptr = Allocate(nsize);
+            if (nptr == nullptr)
+                return nullptr;
+
+            std::memcpy(nptr, ptr, osize < nsize ? osize : nsize);
+            Free(ptr, osize);
+            return nptr;
+        }
+
+    private:
+        std::array<SizeClass, ClassCount> _classes;
+        std::array<uint8_t, MaxSmallSize / 16 + 1> _lookup{};
+        std::vector<void *> _chunks;
+        LargeStats _large;
+    };
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "olcPixelGameEngine.h"
+
+#if defined(BUILD_LUA_AS_CLIB)
+extern "C"
+{
+#endif
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#if defined(BUILD_LUA_AS_CLIB)
+}
+#endif
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // LuaBind
+    //   Generates lua_CFunction thunks from plain C++ signatures.
+    //   Every parameter type maps to a LuaArg specialization that
+    //   knows how many stack slots it takes and how to read them,
+    //   so the stack index of each argument is a compile time
+    //   constant and a thunk is just the reads plus the call.
+    //
+    //     static void FillCircle(int32_t x, int32_t y, int32_t r, olc::Pixel p);
+    //     {"fill_circle", LuaBind<FillCircle>}
+    //
+    //   Missing numbers read as 0, like lua_tonumber. Trailing
+    //   parameters with another default are wrapped in LuaOpt.
+    /////////////////////////////////////////////////
+
+    // Optional parameter, Default is used when the slot is none or nil
+    template<typename T, auto Default>
+    struct LuaOpt {
+        T value;
+
+        inline operator T() const { return value; }
+    };
+
+    template<typename T, typename Enable = void>
+    struct LuaArg;
+
+    template<typename T>
+    struct LuaArg<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+        static constexpr int Slots = 1;
+
+        static inline T Get(lua_State *L, int idx) {
+            int isInteger = 0;
+            lua_Integer i = lua_tointegerx(L, idx, &isInteger);
+            // floats truncate towards zero instead of failing the conversion
+            return isInteger ? T(i) : T(int64_t(lua_tonumber(L, idx)));
+        }
+    };
+
+    template<typename T>
+    struct LuaArg<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+        static constexpr int Slots = 1;
+
+        static inline T Get(lua_State *L, int idx) { return T(lua_tonumber(L, idx)); }
+    };
+
+    template<typename T>
+    struct LuaArg<T, std::enable_if_t<std::is_enum_v<T>>> {
+        static constexpr int Slots = 1;
+
+        static inline T Get(lua_State *L, int idx) { return T(lua_tointeger(L, idx)); }
+    };
+
+    template<>
+    struct LuaArg<bool> {
+        static constexpr int Slots = 1;
+
+        static inline bool Get(lua_State *L, int idx) { return lua_toboolean(L, idx); }
+    };
+
+    template<>
+    struct LuaArg<const char *> {
+        static constexpr int Slots = 1;
+
+        static inline const char *Get(lua_State *L, int idx) { return luaL_checkstring(L, idx); }
+    };
+
+    template<>
+    struct LuaArg<std::string> {
+        static constexpr int Slots = 1;
+
+        static inline std::string Get(lua_State *L, int idx) {
+            size_t length = 0;
+            const char *s = luaL_checklstring(L, idx, &length);
+            return std::string(s, length);
+        }
+    };
+
+    // r, g, b [, a], alpha is optional so a colour can also end the argument list
+    template<>
+    struct LuaArg<olc::Pixel> {
+        static constexpr int Slots = 4;
+
+        static inline olc::Pixel Get(lua_State *L, int idx) {
+            auto r = LuaArg<uint8_t>::Get(L, idx + 0);
+            auto g = LuaArg<uint8_t>::Get(L, idx + 1);
+            auto b = LuaArg<uint8_t>::Get(L, idx + 2);
+            auto a = lua_type(L, idx + 3) <= LUA_TNIL ? uint8_t(255) : LuaArg<uint8_t>::Get(L, idx + 3);
+            return {r, g, b, a};
+        }
+    };
+
+    template<typename T, auto Default>
+    struct LuaArg<LuaOpt<T, Default>> {
+        static constexpr int Slots = LuaArg<T>::Slots;
+
+        static inline LuaOpt<T, Default> Get(lua_State *L, int idx) {
+            if (lua_type(L, idx) <= LUA_TNIL)
+                return {T(Default)};
+            return {LuaArg<T>::Get(L, idx)};
+        }
+    };
+
+    template<typename T, typename Enable = void>
+    struct LuaRet;
+
+    template<typename T>
+    struct LuaRet<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+        static inline int Push(lua_State *L, T v) {
+            lua_pushinteger(L, lua_Integer(v));
+            return 1;
+        }
+    };
+
+    template<typename T>
+    struct LuaRet<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+        static inline int Push(lua_State *L, T v) {
+            lua_pushnumber(L, lua_Number(v));
+            return 1;
+        }
+    };
+
+    template<typename T>
+    struct LuaRet<T, std::enable_if_t<std::is_enum_v<T>>> {
+        static inline int Push(lua_State *L, T v) {
+            lua_pushinteger(L, lua_Integer(v));
+            return 1;
+        }
+    };
+
+    template<>
+    struct LuaRet<bool> {
+        static inline int Push(lua_State *L, bool v) {
+            lua_pushboolean(L, v);
+            return 1;
+        }
+    };
+
+    template<>
+    struct LuaRet<const char *> {
+        static inline int Push(lua_State *L, const char *v) {
+            lua_pushstring(L, v);
+            return 1;
+        }
+    };
+
+    template<>
+    struct LuaRet<olc::Pixel> {
+        static inline int Push(lua_State *L, olc::Pixel p) {
+            lua_pushinteger(L, p.r);
+            lua_pushinteger(L, p.g);
+            lua_pushinteger(L, p.b);
+            lua_pushinteger(L, p.a);
+            return 4;
+        }
+    };
+
+    namespace _ {
+        // 1 based stack index of every parameter, a running sum of the slot counts
+        template<typename... Args>
+        constexpr std::array<int, sizeof...(Args)> LuaArgIndices() {
+            std::array<int, sizeof...(Args)> indices{};
+            constexpr int slots[] = {LuaArg<Args>::Slots..., 0};
+
+            int idx = 1;
+            for (size_t i = 0; i < sizeof...(Args); i++) {
+                indices[i] = idx;
+                idx += slots[i];
+            }
+            return indices;
+        }
+
+        template<typename Fn>
+        struct LuaThunk;
+
+        template<typename R, typename... Args>
+        struct LuaThunk<R (*)(Args...)> {
+            static constexpr size_t Arity = sizeof...(Args);
+
+            template<auto Fn, size_t... I>
+            static inline int Call(lua_State *L, std::index_sequence<I...>) {
+                constexpr auto indices = LuaArgIndices<std::decay_t<Args>...>();
+
+                if constexpr (std::is_void_v<R>) {
+                    Fn(LuaArg<std::decay_t<Args>>::Get(L, indices[I])...);
+                    return 0;
+                } else {
+                    return LuaRet<std::decay_t<R>>::Push(L, Fn(LuaArg<std::decay_t<Args>>::Get(L, indices[I])...));
+                }
+            }
+        };
+    }
+
+    template<auto Fn>
+    int LuaBind(lua_State *L) {
+        using Thunk = _::LuaThunk<decltype(Fn)>;
+        return Thunk::template Call<Fn>(L, std::make_index_sequence<Thunk::Arity>());
+    }
+
+    /////////////////////////////////////////////////
+    // Constant tables
+    //   Name/value lists pushed as one presized table.
+    /////////////////////////////////////////////////
+    struct LuaConstant {
+        const char *name;
+        lua_Integer value;
+    };
+
+    template<size_t N>
+    void PushLuaConstants(lua_State *L, const LuaConstant (&constants)[N]) {
+        lua_createtable(L, 0, int(N));
+        for (const LuaConstant &c : constants) {
+            lua_pushinteger(L, c.value);
+            lua_setfield(L, -2, c.name);
+        }
+    }
+}
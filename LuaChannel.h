@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Buffer.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // LuaChannel
+    //   Unbounded single producer / single consumer queue. The
+    //   producer links nodes at the tail, the consumer unlinks them
+    //   at the head, the two sides only meet on the `next` pointer
+    //   of a node, so neither takes a lock.
+    /////////////////////////////////////////////////
+    template<typename T>
+    class LuaChannel {
+    public:
+        LuaChannel() : _head(new Node()), _tail(_head) {}
+
+        LuaChannel(const LuaChannel &) = delete;
+
+        ~LuaChannel() {
+            while (_head != nullptr) {
+                Node *next = _head->next.load(std::memory_order_relaxed);
+                delete _head;
+                _head = next;
+            }
+        }
+
+        // Producer side
+        void Push(T value) {
+            auto node = new Node();
+            node->value = std::move(value);
+            _tail->next.store(node, std::memory_order_release);
+            _tail = node;
+            _size.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Consumer side, false when the channel is empty
+        bool Pop(T &value) {
+            Node *next = _head->next.load(std::memory_order_acquire);
+            if (next == nullptr)
+                return false;
+
+            // next becomes the new stub, its value is moved out
+            value = std::move(next->value);
+            delete _head;
+            _head = next;
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Consumer side
+        inline bool Empty() const { return _head->next.load(std::memory_order_acquire) == nullptr; }
+
+        // Either side, may lag behind the other one
+        inline size_t Size() const { return _size.load(std::memory_order_relaxed); }
+
+    private:
+        struct Node {
+            std::atomic<Node *> next{nullptr};
+            T value;
+        };
+
+        // consumer owned, always a stub whose value was taken
+        Node *_head;
+        // producer owned
+        Node *_tail;
+        std::atomic<size_t> _size{0};
+    };
+
+    /////////////////////////////////////////////////
+    // WorkerMessage
+    //   Values copied out of one Lua state for another. `bytes` is
+    //   the encoded value list, buffers travel as blocks that the
+    //   receiving state adopts without copying them again.
+    /////////////////////////////////////////////////
+    struct WorkerMessage {
+        enum Tag : uint8_t {
+            Nil,
+            // followed by a byte, 0 or 1
+            Boolean,
+            Integer,
+            Number,
+            String,
+            TableBegin,
+            TableEnd,
+            Block,
+        };
+
+        struct Blob {
+            Buffer::Type type;
+            size_t length;
+            // new[] allocation, owned by the message until a buffer adopts it
+            uint8_t *data;
+        };
+
+        std::string bytes;
+        std::vector<Blob> blobs;
+        // number of top level values
+        int count = 0;
+
+        WorkerMessage() = default;
+
+        WorkerMessage(const WorkerMessage &) = delete;
+
+        WorkerMessage(WorkerMessage &&other) noexcept { *this = std::move(other); }
+
+        WorkerMessage &operator=(WorkerMessage &&other) noexcept {
+            if (this != &other) {
+                Free();
+                bytes = std::move(other.bytes);
+                blobs = std::move(other.blobs);
+                count = other.count;
+                other.blobs.clear();
+                other.count = 0;
+            }
+            return *this;
+        }
+
+        ~WorkerMessage() { Free(); }
+
+        template<typename T>
+        void Put(T value) {
+            bytes.append((const char *) &value, sizeof(T));
+        }
+
+        template<typename T>
+        bool Get(size_t &pos, T &value) const {
+            if (pos + sizeof(T) > bytes.size())
+                return false;
+            std::memcpy(&value, bytes.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+
+    private:
+        void Free() {
+            for (Blob &blob : blobs)
+                delete[] blob.data;
+            blobs.clear();
+        }
+    };
+}
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(BUILD_LUA_AS_CLIB)
+extern "C"
+{
+#endif
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#if defined(BUILD_LUA_AS_CLIB)
+}
+#endif
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // LuaProfiler
+    //   Sampling profiler driven by lua_sethook. A count hook fires
+    //   every `interval` VM instructions, call/return hooks catch
+    //   C functions (which run no instructions) so bindings get
+    //   their exact time. Every event charges the time since the
+    //   previous event to the call stack seen at this event. Stacks
+    //   are interned in a tree, each node keeps its self time.
+    //
+    //   The profiler is found through lua_getextraspace, coroutines
+    //   created after Attach inherit it together with the hook.
+    /////////////////////////////////////////////////
+    class LuaProfiler {
+    public:
+        static constexpr int MaxDepth = 128;
+
+        struct Options {
+            // VM instructions between two samples
+            int interval = 1000;
+            // also hook calls/returns so C functions are timed exactly
+            bool bindings = true;
+        };
+
+        struct FunctionStats {
+            std::string name;
+            // only C functions are counted, Lua code is sampled
+            uint64_t calls = 0;
+            uint64_t samples = 0;
+            double selfMs = 0.0;
+            double totalMs = 0.0;
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+    public:
+        LuaProfiler() = default;
+
+        LuaProfiler(const LuaProfiler &) = delete;
+
+        // Makes the profiler reachable from the hook of L and of threads created from it
+        void Attach(lua_State *L) {
+            *(LuaProfiler **) lua_getextraspace(L) = this;
+        }
+
+        void Start(lua_State *L, const Options &options) {
+            if (_running)
+                Stop(L);
+
+            _options = options;
+            _options.interval = std::max(1, _options.interval);
+            _running = true;
+            _active = true;
+            _last = Clock::now();
+
+            IndexFunctionNames(L);
+
+            int mask = LUA_MASKCOUNT;
+            if (_options.bindings)
+                mask |= LUA_MASKCALL | LUA_MASKRET;
+            lua_sethook(L, Hook, mask, _options.interval);
+        }
+
+        void Stop(lua_State *L) {
+            if (!_running)
+                return;
+
+            Suspend();
+            _running = false;
+            lua_sethook(L, nullptr, 0, 0);
+        }
+
+        // Host code between Lua calls is not charged to any stack. Suspend
+        // before leaving Lua, Resume right before calling back in
+        inline void Resume() {
+            if (_running && !_active) {
+                _active = true;
+                _last = Clock::now();
+            }
+        }
+
+        void Suspend() {
+            if (!_running || !_active)
+                return;
+
+            // the tail after the last event most likely ran where that event was
+            auto now = Clock::now();
+            Charge(_lastNode, now - _last);
+            _active = false;
+        }
+
+        void Reset() {
+            _nodes.clear();
+            _children.clear();
+            _frames.clear();
+            _frameIds.clear();
+            _events = 0;
+            _overhead = Clock::duration::zero();
+            _lastNode = -1;
+            _last = Clock::now();
+        }
+
+        inline bool IsRunning() const { return _running; }
+
+        inline const Options &GetOptions() const { return _options; }
+
+        inline uint64_t GetEvents() const { return _events; }
+
+        inline double GetOverheadMs() const { return ToMs(_overhead); }
+
+        double GetProfiledMs() const {
+            Clock::duration total = Clock::duration::zero();
+            for (const Node &node : _nodes)
+                total += node.self;
+            return ToMs(total);
+        }
+
+        // Per function totals, sorted by self time
+        std::vector<FunctionStats> GetFunctionStats() const {
+            std::vector<FunctionStats> stats(_frames.size());
+            std::vector<Clock::duration> self(_frames.size(), Clock::duration::zero());
+            std::vector<Clock::duration> total(_frames.size(), Clock::duration::zero());
+
+            for (size_t i = 0; i < _frames.size(); i++) {
+                stats[i].name = _frames[i].name;
+                stats[i].calls = _frames[i].calls;
+            }
+
+            // a node's self time counts once towards every distinct function on its path
+            std::vector<int> seen;
+            for (const Node &node : _nodes) {
+                if (node.self == Clock::duration::zero() && node.samples == 0)
+                    continue;
+
+                self[node.frame] += node.self;
+                stats[node.frame].samples += node.samples;
+
+                seen.clear();
+                for (int n = int(&node - _nodes.data()); n >= 0; n = _nodes[n].parent) {
+                    int frame = _nodes[n].frame;
+                    if (std::find(seen.begin(), seen.end(), frame) != seen.end())
+                        continue;
+                    seen.push_back(frame);
+                    total[frame] += node.self;
+                }
+            }
+
+            for (size_t i = 0; i < _frames.size(); i++) {
+                stats[i].selfMs = ToMs(self[i]);
+                stats[i].totalMs = ToMs(total[i]);
+            }
+
+            stats.erase(std::remove_if(stats.begin(), stats.end(), [](const FunctionStats &s) {
+                return s.totalMs == 0.0 && s.calls == 0;
+            }), stats.end());
+
+            std::sort(stats.begin(), stats.end(), [](const FunctionStats &a, const FunctionStats &b) {
+                return a.selfMs > b.selfMs;
+            });
+            return stats;
+        }
+
+        // One "root;caller;callee weight" line per stack, weight is self time in
+        // microseconds. Feeds flamegraph.pl, inferno or speedscope directly
+        bool WriteFolded(const char *path) const {
+            std::FILE *out = std::fopen(path, "w");
+            if (out == nullptr)
+                return false;
+
+            std::string line;
+            for (size_t i = 0; i < _nodes.size(); i++) {
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(_nodes[i].self).count();
+                if (us <= 0)
+                    continue;
+
+                line.clear();
+                AppendPath(line, int(i));
+                std::fprintf(out, "%s %lld\n", line.c_str(), (long long) us);
+            }
+
+            std::fclose(out);
+            return true;
+        }
+
+        bool WriteReport(const char *path) const {
+            std::FILE *out = std::fopen(path, "w");
+            if (out == nullptr)
+                return false;
+
+            WriteReport(out);
+            std::fclose(out);
+            return true;
+        }
+
+        void WriteReport(std::FILE *out, size_t maxRows = SIZE_MAX) const {
+            double profiledMs = GetProfiledMs();
+            std::fprintf(out, "Lua profile: %.3f ms profiled, %llu events, %.3f ms hook overhead\n",
+                         profiledMs, (unsigned long long) _events, GetOverheadMs());
+            std::fprintf(out, "%10s %7s %10s %10s %9s  %s\n", "self ms", "self %", "total ms", "calls", "samples", "function");
+
+            auto stats = GetFunctionStats();
+            for (size_t i = 0; i < stats.size() && i < maxRows; i++) {
+                const FunctionStats &s = stats[i];
+                std::fprintf(out, "%10.3f %6.2f%% %10.3f %10llu %9llu  %s\n",
+                             s.selfMs, profiledMs > 0.0 ? 100.0 * s.selfMs / profiledMs : 0.0, s.totalMs,
+                             (unsigned long long) s.calls, (unsigned long long) s.samples, s.name.c_str());
+            }
+        }
+
+    private:
+        struct Node {
+            int parent;
+            int frame;
+            Clock::duration self;
+            uint64_t samples;
+        };
+
+        struct Frame {
+            std::string name;
+            uint64_t calls;
+        };
+
+        // Lua functions are told apart by their prototype (source, first line),
+        // C functions by their address
+        struct FrameKey {
+            const void *ptr;
+            int line;
+
+            bool operator==(const FrameKey &other) const { return ptr == other.ptr && line == other.line; }
+        };
+
+        struct FrameKeyHash {
+            size_t operator()(const FrameKey &key) const {
+                return std::hash<const void *>()(key.ptr) ^ (size_t(key.line) * 0x9E3779B97F4A7C15ull);
+            }
+        };
+
+        static inline double ToMs(Clock::duration d) {
+            return std::chrono::duration<double, std::milli>(d).count();
+        }
+
+        static void Hook(lua_State *L, lua_Debug *ar) {
+            auto self = *(LuaProfiler **) lua_getextraspace(L);
+            if (self == nullptr || !self->_running) {
+                // a coroutine that inherited the hook before Stop
+                lua_sethook(L, nullptr, 0, 0);
+                return;
+            }
+            self->OnEvent(L, ar);
+        }
+
+        void OnEvent(lua_State *L, lua_Debug *ar) {
+            auto now = Clock::now();
+            if (!_active) {
+                // Lua was entered without Resume (e.g. a callback from C++)
+                _active = true;
+                _last = now;
+            }
+
+            int level = 0;
+            bool sample = ar->event == LUA_HOOKCOUNT;
+
+            if (!sample) {
+                // only C functions matter here, the count hook covers Lua code
+                if (!lua_getinfo(L, "Sf", ar)) {
+                    _overhead += Clock::now() - now;
+                    return;
+                }
+                if (lua_tocfunction(L, -1) == nullptr) {
+                    lua_pop(L, 1);
+                    _overhead += Clock::now() - now;
+                    return;
+                }
+
+                // on call the time so far belongs to the caller, on return to the C function
+                if (ar->event == LUA_HOOKCALL || ar->event == LUA_HOOKTAILCALL) {
+                    level = 1;
+                    _frames[InternFrame(L, ar, -1)].calls++;
+                }
+                lua_pop(L, 1);
+            }
+
+            int node = InternStack(L, level);
+            Charge(node, now - _last);
+            if (sample && node >= 0)
+                _nodes[node].samples++;
+            _lastNode = node;
+            _events++;
+
+            // hook time is left out of every stack
+            _last = Clock::now();
+            _overhead += _last - now;
+        }
+
+        inline void Charge(int node, Clock::duration d) {
+            if (node >= 0)
+                _nodes[node].self += d;
+        }
+
+        // Returns the tree node for the stack from `level` outwards, -1 for an empty stack
+        int InternStack(lua_State *L, int level) {
+            int frames[MaxDepth];
+            int depth = 0;
+
+            lua_Debug ar;
+            while (depth < MaxDepth && lua_getstack(L, level, &ar)) {
+                if (!lua_getinfo(L, "Sf", &ar))
+                    break;
+                frames[depth++] = InternFrame(L, &ar, -1);
+                lua_pop(L, 1);
+                level++;
+            }
+
+            int node = -1;
+            for (int i = depth - 1; i >= 0; i--) {
+                uint64_t key = (uint64_t(uint32_t(node)) << 32) | uint32_t(frames[i]);
+                auto it = _children.find(key);
+                if (it != _children.end()) {
+                    node = it->second;
+                } else {
+                    _nodes.push_back({node, frames[i], Clock::duration::zero(), 0});
+                    node = int(_nodes.size()) - 1;
+                    _children.emplace(key, node);
+                }
+            }
+            return node;
+        }
+
+        // `ar` was filled with "Sf", the function is at funcIdx
+        int InternFrame(lua_State *L, lua_Debug *ar, int funcIdx) {
+            lua_CFunction cfunc = ar->what[0] == 'C' ? lua_tocfunction(L, funcIdx) : nullptr;
+            FrameKey key = cfunc ? FrameKey{(const void *) cfunc, -1} : FrameKey{ar->source, ar->linedefined};
+
+            auto it = _frameIds.find(key);
+            if (it != _frameIds.end())
+                return it->second;
+
+            std::string name;
+            auto known = _functionNames.find(key);
+            if (known != _functionNames.end())
+                name = known->second;
+
+            if (name.empty()) {
+                // the call site name is only worked out once per function
+                lua_getinfo(L, "n", ar);
+                if (cfunc) {
+                    name = std::string("[C] ") + (ar->name ? ar->name : "?");
+                } else if (ar->what[0] == 'm') {
+                    name = std::string("main chunk (") + ar->short_src + ")";
+                } else {
+                    name = std::string(ar->name ? ar->name : "<anonymous>") + " (" + ar->short_src + ":" + std::to_string(ar->linedefined) + ")";
+                }
+            }
+            // ';' separates frames in folded stacks
+            std::replace(name.begin(), name.end(), ';', ':');
+
+            int id = int(_frames.size());
+            _frames.push_back({std::move(name), 0});
+            _frameIds.emplace(key, id);
+            return id;
+        }
+
+        void AppendPath(std::string &line, int node) const {
+            if (_nodes[node].parent >= 0) {
+                AppendPath(line, _nodes[node].parent);
+                line += ';';
+            }
+            line += _frames[_nodes[node].frame].name;
+        }
+
+        // Names functions after where the scripts can reach them: globals,
+        // library/module tables (PGE.graphics.draw) and metatables (PGE.Sprite:width)
+        void IndexFunctionNames(lua_State *L) {
+            _functionNames.clear();
+            std::unordered_set<const void *> visited;
+
+            lua_pushglobaltable(L);
+            IndexTable(L, "", '.', 2, visited);
+            lua_pop(L, 1);
+
+            lua_pushnil(L);
+            while (lua_next(L, LUA_REGISTRYINDEX)) {
+                // luaL_newmetatable tables are registered under their __name
+                if (lua_type(L, -2) == LUA_TSTRING && lua_type(L, -1) == LUA_TTABLE) {
+                    std::string name = lua_tostring(L, -2);
+                    if (lua_getfield(L, -1, "__name") == LUA_TSTRING && name == lua_tostring(L, -1)) {
+                        lua_pop(L, 1);
+                        IndexTable(L, name, ':', 0, visited);
+                    } else {
+                        lua_pop(L, 1);
+                    }
+                }
+                lua_pop(L, 1);
+            }
+        }
+
+        // Walks the table on top of the stack, `depth` more levels of subtables
+        void IndexTable(lua_State *L, const std::string &prefix, char separator, int depth, std::unordered_set<const void *> &visited) {
+            if (!visited.insert(lua_topointer(L, -1)).second)
+                return;
+
+            lua_pushnil(L);
+            while (lua_next(L, -2)) {
+                if (lua_type(L, -2) == LUA_TSTRING) {
+                    std::string name = prefix.empty() ? lua_tostring(L, -2) : prefix + separator + lua_tostring(L, -2);
+
+                    if (lua_iscfunction(L, -1)) {
+                        _functionNames.emplace(FrameKey{(const void *) lua_tocfunction(L, -1), -1}, name);
+                    } else if (lua_isfunction(L, -1)) {
+                        lua_Debug ar;
+                        lua_pushvalue(L, -1);
+                        lua_getinfo(L, ">S", &ar);
+                        _functionNames.emplace(FrameKey{ar.source, ar.linedefined},
+                                               name + " (" + ar.short_src + ":" + std::to_string(ar.linedefined) + ")");
+                    } else if (lua_type(L, -1) == LUA_TTABLE && depth > 0) {
+                        IndexTable(L, name, '.', depth - 1, visited);
+                    }
+                }
+                lua_pop(L, 1);
+            }
+        }
+
+    private:
+        Options _options;
+        bool _running = false;
+        // false while the host runs between Lua calls
+        bool _active = false;
+
+        Clock::time_point _last;
+        int _lastNode = -1;
+        uint64_t _events = 0;
+        Clock::duration _overhead = Clock::duration::zero();
+
+        std::vector<Node> _nodes;
+        // (parent node, frame) -> child node
+        std::unordered_map<uint64_t, int> _children;
+        std::vector<Frame> _frames;
+        std::unordered_map<FrameKey, int, FrameKeyHash> _frameIds;
+        std::unordered_map<FrameKey, std::string, FrameKeyHash> _functionNames;
+    };
+}
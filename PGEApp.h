@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <iostream>
 
@@ -25,6 +28,17 @@ extern "C"
 
 #include "LuaBridge.h"
 
+#include "Buffer.h"
+#include "CommandBuffer.h"
+#include "FlightRecorder.h"
+#include "JobKernels.h"
+#include "LuaAllocator.h"
+#include "LuaBind.h"
+#include "LuaChannel.h"
+#include "LuaProfiler.h"
+#include "ParticleSystem.h"
+#include "TileMap.h"
+
 namespace PGEApp {
     static int MajorVersion = 0;
     static int MinorVersion = 1;
@@ -34,20 +48,37 @@ namespace PGEApp {
         ///////////////////////////////////////////
         // Common Lua Utils
         ///////////////////////////////////////////
+        static int Panic(lua_State *L) {
+            const char *msg = lua_tostring(L, -1);
+            std::cout << "[Lua Panic] " << (msg ? msg : "error object is not a string") << std::endl;
+            return 0;
+        }
+
         static int Traceback(lua_State *L) {
-            lua_getglobal(L, "debug");
-            lua_getfield(L, -1, "traceback");
-            lua_pushvalue(L, 1);
-            lua_pushinteger(L, 2);
-            lua_call(L, 2, 1);
+            const char *msg = lua_tostring(L, 1);
+            if (msg == nullptr)
+                msg = luaL_tolstring(L, 1, nullptr);
+
+            luaL_traceback(L, L, msg, 1);
             return 1;
         }
 
-        static int CallLuaFunc(lua_State *L, const char *name) {
-            lua_pushcfunction(L, Traceback);
+        // Stores the global `name` in the registry, LUA_REFNIL if it is missing
+        static int RefLuaGlobal(lua_State *L, const char *name) {
             lua_getglobal(L, name);
+            return luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+
+        // Calls the function behind `funcRef` with the `nargs` values on top of the stack,
+        // errors are reported through the message handler behind `handlerRef`
+        static int CallLuaRef(lua_State *L, int handlerRef, int funcRef, int nargs = 0) {
+            int base = lua_gettop(L) - nargs;
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, handlerRef);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, funcRef);
+            lua_rotate(L, base + 1, 2);
 
-            int ret = lua_pcall(L, 0, 0, lua_gettop(L) - 1);
+            int ret = lua_pcall(L, nargs, 0, base + 1);
             if (ret != 0) {
                 const char *error = lua_tostring(L, -1);
 
@@ -58,6 +89,7 @@ namespace PGEApp {
                 lua_pcall(L, 1, 0, 0);
             }
 
+            lua_settop(L, base);
             return ret;
         }
 
@@ -144,40 +176,351 @@ namespace PGEApp {
 
         static int InputRegisterFunctions(lua_State *L);
 
+        static int ParticlesRegisterFunctions(lua_State *L);
+
+        static int MemoryRegisterFunctions(lua_State *L);
+
+        static int GcRegisterFunctions(lua_State *L);
+
+        static int BufferRegisterFunctions(lua_State *L);
+
+        static int ProfilerRegisterFunctions(lua_State *L);
+
+        static int FlightRegisterFunctions(lua_State *L);
+
+        static int JobsRegisterFunctions(lua_State *L);
+
+        static int WorkerRegisterFunctions(lua_State *L);
+
+        // Collector knobs, read from the `gc` table of the config
+        struct GcSettings {
+            // "incremental" or "generational" run under the frame budget,
+            // "auto" leaves collection to Lua's allocation debt
+            std::string mode = "incremental";
+            // GC steps run after update until this much of the frame has passed
+            double frameBudgetMs = 1000.0 / 60.0;
+            // LUA_GCSTEP argument, 0 is one basic step
+            int stepKB = 0;
+            // steps run even when the frame is already over budget
+            int minSteps = 1;
+            // safety cap, a full collection runs once the heap grows past it
+            int maxHeapKB = 256 * 1024;
+
+            int pause = 200;
+            int stepMul = 100;
+            int stepSize = 13;
+            int minorMul = 20;
+            int majorMul = 100;
+        };
+
+        // Read from the `profiler` table of the config
+        struct ProfilerSettings {
+            LuaProfiler::Options options;
+            // toggles the profiler, 0 for no key (e.g. PGE.input.Key.F9)
+            int key = olc::Key::NONE;
+            // stopping from the key writes <output>.folded and <output>.txt
+            std::string output = "profile";
+            // start before load() runs
+            bool start = false;
+        };
+
+        // Read from the `fixed_timestep` table of the config, fixed_update(dt) then
+        // runs at tickRate and draw(alpha) interpolates between the last two ticks
+        struct TimestepSettings {
+            bool fixed = false;
+            double tickRate = 60.0;
+            // at most this many ticks per frame, a longer backlog is dropped
+            int maxSteps = 5;
+        };
+
+        // Read from the `frame_stats` table of the config
+        struct FrameStatsSettings {
+            // frames slower than this count as over budget
+            double budgetMs = 1000.0 / 60.0;
+            // the report printed on destroy is also written here when set
+            std::string report;
+        };
+
+        // Read from the `frame_limit` table of the config, 0 runs unlimited
+        struct FrameLimitSettings {
+            double fps = 0.0;
+            // used while the window is not focused, 0 keeps fps
+            double unfocusedFps = 10.0;
+        };
+
+        // Read from the `flight_recorder` table of the config
+        struct FlightRecorderSettings {
+            bool enabled = true;
+            // frames kept in the ring, all of them are written on a spike
+            int frames = 240;
+            // a frame longer than this triggers a dump
+            double budgetMs = 50.0;
+            // dumps go to <output>_<frame>.pgefr
+            std::string output = "flight";
+            // spikes after this many dumps are only counted
+            int maxDumps = 8;
+        };
+
+        struct GcFrameStats {
+            double timeMs = 0.0;
+            int steps = 0;
+            int heapKB = 0;
+            int cycles = 0;
+            int externalKB = 0;
+            bool fullCollect = false;
+        };
+
+        class App;
+
+        class LuaWorker;
+
+        /////////////////////////////////////////////////
+        // LuaContext
+        //   What the bindings need to know about the engine that owns
+        //   a Lua state. It lives in the second pointer of the state's
+        //   extra space (the profiler has the first), threads created
+        //   from the state copy it, so several engines can run side by
+        //   side without sharing any globals.
+        /////////////////////////////////////////////////
+        struct LuaContext {
+            // the engine of the main state, nullptr in worker states
+            App *app = nullptr;
+            // the worker running a worker state
+            LuaWorker *worker = nullptr;
+            // handle metatables, compared by address
+            const void *spriteMeta = nullptr;
+            const void *decalMeta = nullptr;
+            const void *indexedSpriteMeta = nullptr;
+        };
+
+        static inline LuaContext *&LuaContextSlot(lua_State *L) {
+            return ((LuaContext **) lua_getextraspace(L))[1];
+        }
+
+        static inline LuaContext &GetContext(lua_State *L) {
+            return *LuaContextSlot(L);
+        }
+
+        static inline App *GetApp(lua_State *L) {
+            return LuaContextSlot(L)->app;
+        }
+
         class App : public olc::PixelGameEngine {
         public:
             App() {
                 sAppName = "App";
 
-                L = luaL_newstate();
+                // small blocks come from size class pools instead of realloc
+                L = lua_newstate(LuaAllocator::Alloc, &Allocator);
+                lua_atpanic(L, Panic);
+                Context.app = this;
+                LuaContextSlot(L) = &Context;
+                Profiler.Attach(L);
                 InitLua();
             }
 
             virtual ~App() {
-                lua_close(L);
+                if (L)
+                    lua_close(L);
                 L = nullptr;
             }
 
         public:
             bool OnUserCreate() override {
-                CallLuaFunc(L, "_pge_load");
+                SetFrameBudget(float(FrameStatsConfig.budgetMs / 1000.0));
+                SetFrameLimit(float(FrameLimitConfig.fps));
+                SetUnfocusedFrameLimit(float(FrameLimitConfig.unfocusedFps));
+
+                if (ProfilerConfig.start)
+                    StartProfiler();
+
+                OLC_PROFILE_ZONE("Lua load");
+                CallLua(LoadRef);
                 return true;
             }
 
             bool OnUserUpdate(float fElapsedTime) override {
+                auto frameStart = std::chrono::steady_clock::now();
+
+                // fElapsedTime is the length of the previous frame, the first one includes load()
+                if (FrameCount++ > 0 && FlightConfig.enabled)
+                    RecordFlightFrame(fElapsedTime);
+
+                if (ProfilerConfig.key != olc::Key::NONE && GetKey(olc::Key(ProfilerConfig.key)).bPressed)
+                    ToggleProfiler();
+
                 DeltaTime = fElapsedTime;
-                CallLuaFunc(L, "_pge_update");
+                auto luaStart = std::chrono::steady_clock::now();
+                {
+                    OLC_PROFILE_ZONE("Lua update");
+                    lua_pushnumber(L, fElapsedTime);
+                    CallLua(UpdateRef, 1);
+
+                    if (Timestep.fixed)
+                        RunFixedSteps(fElapsedTime);
+                    else
+                        Alpha = 1.0f;
+
+                    lua_pushnumber(L, Alpha);
+                    CallLua(DrawRef, 1);
+                }
+                LuaUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - luaStart).count();
+
+                StepGarbageCollector(frameStart);
 
                 return true;
             }
 
             bool OnUserDestroy() override {
-                CallLuaFunc(L, "_pge_on_destroy");
+                CallLua(DestroyRef);
+
+                // a profile still running when the window closes is kept
+                if (Profiler.IsRunning()) {
+                    Profiler.Stop(L);
+                    SaveProfile(ProfilerConfig.output);
+                }
+
+                WriteFrameReport(std::cout);
+                if (!FrameStatsConfig.report.empty()) {
+                    std::ofstream report(FrameStatsConfig.report);
+                    WriteFrameReport(report);
+                }
+
+                // finalizers free textures, run them while the renderer is still up
+                lua_close(L);
+                L = nullptr;
                 return true;
             }
 
             inline lua_State *GetLuaState() { return L; }
 
+            inline const LuaAllocator &GetLuaAllocator() const { return Allocator; }
+
+            inline GcSettings &GetGcSettings() { return Gc; }
+
+            inline const GcFrameStats &GetGcFrameStats() const { return GcStats; }
+
+            // Memory kept alive by Lua handles outside the Lua heap (sprite pixels).
+            // It counts towards maxHeapKB, the collector cannot see it otherwise
+            void AddExternalBytes(int64_t bytes) {
+                ExternalBytes += bytes;
+                if (bytes > 0 && Gc.mode == "auto")
+                    lua_gc(L, LUA_GCSTEP, int(bytes / 1024));
+            }
+
+            inline int GetExternalKB() const { return int(ExternalBytes / 1024); }
+
+            // (Re)applies the collector mode and parameters from the settings
+            void ApplyGcSettings() {
+                if (Gc.mode == "generational")
+                    lua_gc(L, LUA_GCGEN, Gc.minorMul, Gc.majorMul);
+                else
+                    lua_gc(L, LUA_GCINC, Gc.pause, Gc.stepMul, Gc.stepSize);
+
+                // managed modes only collect from StepGarbageCollector
+                if (Gc.mode == "auto")
+                    lua_gc(L, LUA_GCRESTART);
+                else
+                    lua_gc(L, LUA_GCSTOP);
+            }
+
+            inline LuaProfiler &GetProfiler() { return Profiler; }
+
+            // Pool the PGE.worker scripts run on, started by the first spawn
+            olc::JobSystem &GetWorkerPool() {
+                if (!WorkerPool) {
+                    uint32_t threads = WorkerThreads;
+                    if (threads == 0)
+                        threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+                    // nobody waits on this pool, so it needs a thread more than it runs on
+                    WorkerPool = std::make_unique<olc::JobSystem>(threads + 1);
+                }
+                return *WorkerPool;
+            }
+
+            inline const ProfilerSettings &GetProfilerSettings() const { return ProfilerConfig; }
+
+            void StartProfiler() {
+                StartProfiler(ProfilerConfig.options);
+            }
+
+            void StartProfiler(const LuaProfiler::Options &options) {
+                Profiler.Reset();
+                Profiler.Start(L, options);
+                std::cout << "[Profiler] started, every " << Profiler.GetOptions().interval << " instructions" << std::endl;
+            }
+
+            // Returns true when the profiler is running afterwards
+            bool ToggleProfiler() {
+                if (Profiler.IsRunning()) {
+                    Profiler.Stop(L);
+                    SaveProfile(ProfilerConfig.output);
+                    return false;
+                }
+
+                StartProfiler();
+                return true;
+            }
+
+            // Writes <prefix>.folded and <prefix>.txt (and <prefix>.trace.json when the
+            // engine has timing zones) and prints the top of the table
+            bool SaveProfile(const std::string &prefix) {
+                bool saved = Profiler.WriteFolded((prefix + ".folded").c_str()) &&
+                             Profiler.WriteReport((prefix + ".txt").c_str());
+                if (olc::profile::Enabled)
+                    saved = olc::profile::WriteChromeTrace(prefix + ".trace.json") && saved;
+
+                Profiler.WriteReport(stdout, 15);
+                std::cout << "[Profiler] " << (saved ? "saved " : "cannot write ") << prefix << ".*" << std::endl;
+                return saved;
+            }
+
+            inline FlightRecorderSettings &GetFlightRecorderSettings() { return FlightConfig; }
+
+            // Writes the frames in the flight recorder, newest last
+            bool DumpFlightRecorder(const std::string &path) {
+                bool written = Recorder.Write(path.c_str(), float(FlightConfig.budgetMs));
+                std::cout << "[FlightRecorder] " << (written ? "wrote " : "cannot write ") << Recorder.Size()
+                          << " frames to " << path << std::endl;
+                return written;
+            }
+
+            // Frame time percentiles and the frames that blew the budget
+            void WriteFrameReport(std::ostream &out) const {
+                const olc::FrameHistogram &frames = GetFrameHistogram();
+                uint64_t count = frames.Count();
+                char line[256];
+
+                double mean = frames.Mean();
+                snprintf(line, sizeof(line), "Frame times: %llu frames, mean %.2f ms (%.1f fps)\n",
+                         (unsigned long long) count, mean, mean > 0.0 ? 1000.0 / mean : 0.0);
+                out << line;
+                if (count == 0)
+                    return;
+
+                snprintf(line, sizeof(line), "  min %.2f  p50 %.2f  p95 %.2f  p99 %.2f  p99.9 %.2f  max %.2f ms\n",
+                         frames.Min(), frames.Percentile(50.0), frames.Percentile(95.0),
+                         frames.Percentile(99.0), frames.Percentile(99.9), frames.Max());
+                out << line;
+
+                uint64_t over = frames.CountOverBudget();
+                snprintf(line, sizeof(line), "  over the %.2f ms budget: %llu frames (%.2f%%)\n",
+                         frames.Budget(), (unsigned long long) over, 100.0 * double(over) / double(count));
+                out << line;
+
+                const olc::FramePacing &pacing = GetFramePacing();
+                if (pacing.nFrames + pacing.nOverruns == 0)
+                    return;
+
+                snprintf(line, sizeof(line), "Frame pacing: %llu paced, %llu overran, %llu woke over %.1f ms late\n",
+                         (unsigned long long) pacing.nFrames, (unsigned long long) pacing.nOverruns,
+                         (unsigned long long) pacing.nLate, olc::FramePacing::LateUs / 1000.0);
+                out << line;
+                snprintf(line, sizeof(line), "  error mean %+.1f us  mean abs %.1f us  max %.1f us, waited %.0f ms asleep %.0f ms spinning\n",
+                         pacing.MeanErrorUs(), pacing.MeanAbsErrorUs(), pacing.fMaxErrorUs, pacing.fSleepMs, pacing.fSpinMs);
+                out << line;
+            }
+
             inline int GetScreenWidth() const { return ScreenWidth; }
 
             inline int GetScreenHeight() const { return ScreenHeight; }
@@ -188,6 +531,18 @@ namespace PGEApp {
 
             inline float GetDeltaTime() const { return DeltaTime; }
 
+            inline TimestepSettings &GetTimestepSettings() { return Timestep; }
+
+            inline float GetFixedDeltaTime() const { return float(1.0 / Timestep.tickRate); }
+
+            inline float GetAlpha() const { return Alpha; }
+
+            inline uint64_t GetTickCount() const { return TickCount; }
+
+            inline int GetFrameTicks() const { return FrameTicks; }
+
+            inline uint64_t GetDroppedTicks() const { return DroppedTicks; }
+
         private:
             bool InitTimerModule() {
                 TimerRegisterFunctions(L);
@@ -201,165 +556,51 @@ namespace PGEApp {
 
             bool InitGraphicsModule() {
                 GraphicsRegisterFunctions(L);
+                return true;
+            }
 
-                luabridge::getGlobalNamespace(L)
-                        .beginNamespace(PGELuaTableName)
-                        .beginNamespace("graphics")
-                        .endNamespace()
-                        .endNamespace();
-
-                lua_getglobal(L, PGELuaTableName);
-                lua_getfield(L, -1, "graphics");
-
-                lua_pushstring(L, "PixelMode");
-                lua_newtable(L);
-                lua_rawset(L, -3);
-
-                lua_getfield(L, -1, "PixelMode");
-
-                lua_pushinteger(L, olc::Pixel::NORMAL);
-                lua_setfield(L, -2, "Normal");
-
-                lua_pushinteger(L, olc::Pixel::MASK);
-                lua_setfield(L, -2, "Mask");
+            bool InitInputModule() {
+                InputRegisterFunctions(L);
+                return true;
+            }
 
-                lua_pushinteger(L, olc::Pixel::ALPHA);
-                lua_setfield(L, -2, "Alpha");
+            bool InitParticlesModule() {
+                ParticlesRegisterFunctions(L);
+                return true;
+            }
 
-                lua_pushinteger(L, olc::Pixel::CUSTOM);
-                lua_setfield(L, -2, "Custom");
+            bool InitMemoryModule() {
+                MemoryRegisterFunctions(L);
+                return true;
+            }
 
+            bool InitGcModule() {
+                GcRegisterFunctions(L);
                 return true;
             }
 
-            bool InitInputModule() {
-                InputRegisterFunctions(L);
+            bool InitBufferModule() {
+                BufferRegisterFunctions(L);
+                return true;
+            }
 
-                luabridge::getGlobalNamespace(L)
-                        .beginNamespace(PGELuaTableName)
-                        .beginNamespace("input")
-                        .endNamespace()
-                        .endNamespace();
+            bool InitProfilerModule() {
+                ProfilerRegisterFunctions(L);
+                return true;
+            }
 
-                lua_getglobal(L, PGELuaTableName);
-                lua_getfield(L, -1, "input");
+            bool InitFlightModule() {
+                FlightRegisterFunctions(L);
+                return true;
+            }
 
-                lua_pushstring(L, "Key");
-                lua_newtable(L);
-                lua_rawset(L, -3);
-
-                lua_getfield(L, -1, "Key");
-
-                lua_pushinteger(L, olc::Key::A);
-                lua_setfield(L, -2, "A");
-                lua_pushinteger(L, olc::Key::B);
-                lua_setfield(L, -2, "B");
-                lua_pushinteger(L, olc::Key::C);
-                lua_setfield(L, -2, "C");
-                lua_pushinteger(L, olc::Key::D);
-                lua_setfield(L, -2, "D");
-                lua_pushinteger(L, olc::Key::E);
-                lua_setfield(L, -2, "E");
-                lua_pushinteger(L, olc::Key::F);
-                lua_setfield(L, -2, "F");
-                lua_pushinteger(L, olc::Key::G);
-                lua_setfield(L, -2, "G");
-                lua_pushinteger(L, olc::Key::H);
-                lua_setfield(L, -2, "H");
-                lua_pushinteger(L, olc::Key::I);
-                lua_setfield(L, -2, "I");
-                lua_pushinteger(L, olc::Key::J);
-                lua_setfield(L, -2, "J");
-                lua_pushinteger(L, olc::Key::K);
-                lua_setfield(L, -2, "K");
-                lua_pushinteger(L, olc::Key::L);
-                lua_setfield(L, -2, "L");
-                lua_pushinteger(L, olc::Key::M);
-                lua_setfield(L, -2, "M");
-                lua_pushinteger(L, olc::Key::N);
-                lua_setfield(L, -2, "N");
-                lua_pushinteger(L, olc::Key::O);
-                lua_setfield(L, -2, "O");
-                lua_pushinteger(L, olc::Key::P);
-                lua_setfield(L, -2, "P");
-                lua_pushinteger(L, olc::Key::Q);
-                lua_setfield(L, -2, "Q");
-                lua_pushinteger(L, olc::Key::R);
-                lua_setfield(L, -2, "R");
-                lua_pushinteger(L, olc::Key::S);
-                lua_setfield(L, -2, "S");
-                lua_pushinteger(L, olc::Key::T);
-                lua_setfield(L, -2, "T");
-                lua_pushinteger(L, olc::Key::U);
-                lua_setfield(L, -2, "U");
-                lua_pushinteger(L, olc::Key::V);
-                lua_setfield(L, -2, "V");
-                lua_pushinteger(L, olc::Key::W);
-                lua_setfield(L, -2, "W");
-                lua_pushinteger(L, olc::Key::X);
-                lua_setfield(L, -2, "X");
-                lua_pushinteger(L, olc::Key::Y);
-                lua_setfield(L, -2, "Y");
-                lua_pushinteger(L, olc::Key::Z);
-                lua_setfield(L, -2, "Z");
-
-                lua_pushinteger(L, olc::Key::K0);
-                lua_setfield(L, -2, "K0");
-                lua_pushinteger(L, olc::Key::K1);
-                lua_setfield(L, -2, "K1");
-                lua_pushinteger(L, olc::Key::K2);
-                lua_setfield(L, -2, "K2");
-                lua_pushinteger(L, olc::Key::K3);
-                lua_setfield(L, -2, "K3");
-                lua_pushinteger(L, olc::Key::K4);
-                lua_setfield(L, -2, "K4");
-                lua_pushinteger(L, olc::Key::K5);
-                lua_setfield(L, -2, "K5");
-                lua_pushinteger(L, olc::Key::K6);
-                lua_setfield(L, -2, "K6");
-                lua_pushinteger(L, olc::Key::K7);
-                lua_setfield(L, -2, "K7");
-                lua_pushinteger(L, olc::Key::K8);
-                lua_setfield(L, -2, "K8");
-                lua_pushinteger(L, olc::Key::K9);
-                lua_setfield(L, -2, "K9");
-
-                lua_pushinteger(L, olc::Key::F1);
-                lua_setfield(L, -2, "F1");
-                lua_pushinteger(L, olc::Key::F2);
-                lua_setfield(L, -2, "F2");
-                lua_pushinteger(L, olc::Key::F3);
-                lua_setfield(L, -2, "F3");
-                lua_pushinteger(L, olc::Key::F4);
-                lua_setfield(L, -2, "F4");
-                lua_pushinteger(L, olc::Key::F5);
-                lua_setfield(L, -2, "F5");
-                lua_pushinteger(L, olc::Key::F6);
-                lua_setfield(L, -2, "F6");
-                lua_pushinteger(L, olc::Key::F7);
-                lua_setfield(L, -2, "F7");
-                lua_pushinteger(L, olc::Key::F8);
-                lua_setfield(L, -2, "F8");
-                lua_pushinteger(L, olc::Key::F9);
-                lua_setfield(L, -2, "F9");
-                lua_pushinteger(L, olc::Key::F10);
-                lua_setfield(L, -2, "F10");
-                lua_pushinteger(L, olc::Key::F11);
-                lua_setfield(L, -2, "F11");
-                lua_pushinteger(L, olc::Key::F12);
-                lua_setfield(L, -2, "F12");
-
-                lua_pushinteger(L, olc::Key::UP);
-                lua_setfield(L, -2, "UP");
-                lua_pushinteger(L, olc::Key::DOWN);
-                lua_setfield(L, -2, "DOWN");
-                lua_pushinteger(L, olc::Key::LEFT);
-                lua_setfield(L, -2, "LEFT");
-                lua_pushinteger(L, olc::Key::RIGHT);
-                lua_setfield(L, -2, "RIGHT");
-
-                lua_pop(L, 3);
+            bool InitJobsModule() {
+                JobsRegisterFunctions(L);
+                return true;
+            }
 
+            bool InitWorkerModule() {
+                WorkerRegisterFunctions(L);
                 return true;
             }
 
@@ -368,9 +609,233 @@ namespace PGEApp {
                 InitWindowModule();
                 InitGraphicsModule();
                 InitInputModule();
+                InitParticlesModule();
+                InitMemoryModule();
+                InitGcModule();
+                InitBufferModule();
+                InitProfilerModule();
+                InitFlightModule();
+                InitJobsModule();
+                InitWorkerModule();
                 return true;
             }
 
+            // Runs fixed_update for every whole tick in the accumulator, capped at maxSteps
+            void RunFixedSteps(float elapsed) {
+                double tick = 1.0 / Timestep.tickRate;
+                Accumulator += elapsed;
+
+                FrameTicks = 0;
+                while (Accumulator >= tick && FrameTicks < Timestep.maxSteps) {
+                    lua_pushnumber(L, tick);
+                    CallLua(FixedUpdateRef, 1);
+                    Accumulator -= tick;
+                    FrameTicks++;
+                    TickCount++;
+                }
+
+                // still behind, drop the backlog instead of spiralling into ever longer frames
+                if (Accumulator >= tick) {
+                    auto dropped = uint64_t(Accumulator / tick);
+                    DroppedTicks += dropped;
+                    Accumulator -= double(dropped) * tick;
+                }
+
+                Alpha = float(Accumulator / tick);
+            }
+
+            // Records the frame before this one, its timings and GC stats are complete now
+            void RecordFlightFrame(float frameSeconds) {
+                const olc::FrameInfo &info = GetLastFrameInfo();
+
+                FlightRecord &record = Recorder.Next();
+                record.frame = FrameCount - 2;
+                record.frameMs = frameSeconds * 1000.0f;
+                record.inputMs = info.fInputMs;
+                record.updateMs = info.fUpdateMs;
+                record.layersMs = info.fLayersMs;
+                record.displayMs = info.fDisplayMs;
+                record.luaMs = LuaUpdateMs;
+                record.gcMs = float(GcStats.timeMs);
+                record.gcSteps = uint32_t(GcStats.steps);
+                record.gcCycles = uint32_t(GcStats.cycles);
+                record.gcFullCollect = GcStats.fullCollect;
+                record.heapKB = uint32_t(GcStats.heapKB);
+                record.externalKB = uint32_t(GcStats.externalKB);
+                record.decals = info.nDecals;
+                record.drawCalls = info.nDrawCalls;
+                record.uploadBytes = uint32_t(std::min<uint64_t>(info.nUploadBytes, UINT32_MAX));
+
+                // the next dump waits for half a ring of new frames
+                if (record.frameMs > FlightConfig.budgetMs && FlightDumps < FlightConfig.maxDumps && FrameCount >= NextFlightDump) {
+                    std::cout << "[FlightRecorder] frame " << record.frame << " took " << record.frameMs << " ms" << std::endl;
+                    DumpFlightRecorder(FlightConfig.output + "_" + std::to_string(record.frame) + ".pgefr");
+                    FlightDumps++;
+                    NextFlightDump = FrameCount + uint32_t(Recorder.Capacity() / 2);
+                }
+            }
+
+            // Only time spent inside Lua is profiled
+            int CallLua(int funcRef, int nargs = 0) {
+                Profiler.Resume();
+                int ret = CallLuaRef(L, TracebackRef, funcRef, nargs);
+                Profiler.Suspend();
+                return ret;
+            }
+
+            void StepGarbageCollector(std::chrono::steady_clock::time_point frameStart) {
+                using namespace std::chrono;
+                OLC_PROFILE_ZONE("Lua GC");
+
+                GcStats = GcFrameStats();
+                if (Gc.mode == "auto") {
+                    GcStats.heapKB = lua_gc(L, LUA_GCCOUNT);
+                    GcStats.externalKB = GetExternalKB();
+                    return;
+                }
+
+                auto gcStart = steady_clock::now();
+                auto deadline = frameStart + duration_cast<steady_clock::duration>(duration<double, std::milli>(Gc.frameBudgetMs));
+
+                if (lua_gc(L, LUA_GCCOUNT) + GetExternalKB() > Gc.maxHeapKB) {
+                    lua_gc(L, LUA_GCCOLLECT);
+                    GcStats.fullCollect = true;
+                    GcStats.cycles++;
+                } else {
+                    // stop at the end of a cycle, a new one can start next frame.
+                    // A generational step is a whole young collection, one is enough
+                    bool generational = Gc.mode == "generational";
+                    while (GcStats.steps < Gc.minSteps || steady_clock::now() < deadline) {
+                        GcStats.steps++;
+                        if (lua_gc(L, LUA_GCSTEP, Gc.stepKB) || generational) {
+                            GcStats.cycles++;
+                            break;
+                        }
+                    }
+                }
+
+                GcStats.timeMs = duration<double, std::milli>(steady_clock::now() - gcStart).count();
+                GcStats.heapKB = lua_gc(L, LUA_GCCOUNT);
+                GcStats.externalKB = GetExternalKB();
+            }
+
+            void InitGcConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef gc = config["gc"];
+                if (gc.isTable()) {
+                    auto readInt = [&gc](const char *key, int &value) {
+                        if (gc[key].isNumber())
+                            value = (int) gc[key];
+                    };
+
+                    if (gc["mode"].isString())
+                        Gc.mode = std::string((const char *) gc["mode"]);
+                    if (gc["frame_budget_ms"].isNumber())
+                        Gc.frameBudgetMs = (double) gc["frame_budget_ms"];
+
+                    readInt("step_kb", Gc.stepKB);
+                    readInt("min_steps", Gc.minSteps);
+                    readInt("max_heap_kb", Gc.maxHeapKB);
+                    readInt("pause", Gc.pause);
+                    readInt("step_mul", Gc.stepMul);
+                    readInt("step_size", Gc.stepSize);
+                    readInt("minor_mul", Gc.minorMul);
+                    readInt("major_mul", Gc.majorMul);
+                }
+
+                ApplyGcSettings();
+            }
+
+            void InitProfilerConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef profiler = config["profiler"];
+                if (!profiler.isTable())
+                    return;
+
+                if (profiler["interval"].isNumber())
+                    ProfilerConfig.options.interval = (int) profiler["interval"];
+                if (profiler["bindings"].isBool())
+                    ProfilerConfig.options.bindings = (bool) profiler["bindings"];
+                if (profiler["key"].isNumber())
+                    ProfilerConfig.key = (int) profiler["key"];
+                if (profiler["output"].isString())
+                    ProfilerConfig.output = std::string((const char *) profiler["output"]);
+                if (profiler["start"].isBool())
+                    ProfilerConfig.start = (bool) profiler["start"];
+            }
+
+            void InitFrameStatsConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef frameStats = config["frame_stats"];
+                if (!frameStats.isTable())
+                    return;
+
+                if (frameStats["budget_ms"].isNumber())
+                    FrameStatsConfig.budgetMs = (double) frameStats["budget_ms"];
+                if (frameStats["report"].isString())
+                    FrameStatsConfig.report = std::string((const char *) frameStats["report"]);
+            }
+
+            void InitFlightRecorderConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef flight = config["flight_recorder"];
+                if (flight.isTable()) {
+                    if (flight["enabled"].isBool())
+                        FlightConfig.enabled = (bool) flight["enabled"];
+                    if (flight["frames"].isNumber())
+                        FlightConfig.frames = (int) flight["frames"];
+                    if (flight["budget_ms"].isNumber())
+                        FlightConfig.budgetMs = (double) flight["budget_ms"];
+                    if (flight["output"].isString())
+                        FlightConfig.output = std::string((const char *) flight["output"]);
+                    if (flight["max_dumps"].isNumber())
+                        FlightConfig.maxDumps = (int) flight["max_dumps"];
+                }
+
+                Recorder.SetCapacity(size_t(std::max(1, FlightConfig.frames)));
+            }
+
+            void InitFrameLimitConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef frameLimit = config["frame_limit"];
+                if (!frameLimit.isTable())
+                    return;
+
+                if (frameLimit["fps"].isNumber())
+                    FrameLimitConfig.fps = std::max(0.0, (double) frameLimit["fps"]);
+                if (frameLimit["unfocused_fps"].isNumber())
+                    FrameLimitConfig.unfocusedFps = std::max(0.0, (double) frameLimit["unfocused_fps"]);
+            }
+
+            void InitJobsConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef jobs = config["jobs"];
+                if (!jobs.isTable())
+                    return;
+
+                // threads including the engine thread, 0 uses every hardware thread
+                if (jobs["threads"].isNumber())
+                    SetJobThreads(uint32_t(std::max(0, (int) jobs["threads"])));
+            }
+
+            void InitWorkersConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef workers = config["workers"];
+                if (!workers.isTable())
+                    return;
+
+                // pool threads for PGE.worker scripts, 0 uses every core but the engine's
+                if (workers["threads"].isNumber())
+                    WorkerThreads = uint32_t(std::max(0, (int) workers["threads"]));
+            }
+
+            void InitTimestepConfig(const luabridge::LuaRef &config) {
+                luabridge::LuaRef timestep = config["fixed_timestep"];
+                if (!timestep.isTable())
+                    return;
+
+                Timestep.fixed = true;
+                if (timestep["enabled"].isBool())
+                    Timestep.fixed = (bool) timestep["enabled"];
+                if (timestep["tick_rate"].isNumber())
+                    Timestep.tickRate = std::max(1.0, (double) timestep["tick_rate"]);
+                if (timestep["max_steps"].isNumber())
+                    Timestep.maxSteps = std::max(1, (int) timestep["max_steps"]);
+            }
+
             bool InitConfig() {
                 auto luaConfigFunc = luabridge::getGlobal(L, "_pge_config");
                 auto config = luaConfigFunc()[0];
@@ -387,6 +852,22 @@ namespace PGEApp {
                 ScreenXScale = (int) config["screen_x_scale"];
                 ScreenYScale = (int) config["screen_y_scale"];
 
+                // only draw after input or PGE.window.request_redraw()
+                if (config["reactive"].isBool())
+                    SetReactive((bool) config["reactive"]);
+                // run update() on its own thread while the last frame is presented
+                if (config["pipelined"].isBool())
+                    SetPipelined((bool) config["pipelined"]);
+
+                InitGcConfig(config);
+                InitProfilerConfig(config);
+                InitTimestepConfig(config);
+                InitFrameStatsConfig(config);
+                InitFrameLimitConfig(config);
+                InitFlightRecorderConfig(config);
+                InitJobsConfig(config);
+                InitWorkersConfig(config);
+
                 return true;
             }
 
@@ -410,13 +891,61 @@ namespace PGEApp {
 
                 InitConfig();
 
+                // resolve the callbacks once, frames call them without name lookups
+                lua_pushcfunction(L, Traceback);
+                TracebackRef = luaL_ref(L, LUA_REGISTRYINDEX);
+                LoadRef = RefLuaGlobal(L, "_pge_load");
+                UpdateRef = RefLuaGlobal(L, "_pge_update");
+                FixedUpdateRef = RefLuaGlobal(L, "_pge_fixed_update");
+                DrawRef = RefLuaGlobal(L, "_pge_draw");
+                DestroyRef = RefLuaGlobal(L, "_pge_on_destroy");
+
                 return true;
             }
 
         private:
+            LuaAllocator Allocator;
+
+            GcSettings Gc;
+            GcFrameStats GcStats;
+            int64_t ExternalBytes = 0;
+
+            LuaProfiler Profiler;
+            ProfilerSettings ProfilerConfig;
+
+            FrameStatsSettings FrameStatsConfig;
+            FrameLimitSettings FrameLimitConfig;
+
+            FlightRecorder Recorder;
+            FlightRecorderSettings FlightConfig;
+
+            // separate from GetJobs(), the engine thread never helps out here,
+            // so a long running script cannot stall a frame that waits on jobs
+            std::unique_ptr<olc::JobSystem> WorkerPool;
+            uint32_t WorkerThreads = 0;
+            int FlightDumps = 0;
+            uint32_t NextFlightDump = 0;
+            uint32_t FrameCount = 0;
+            float LuaUpdateMs = 0.0f;
+
             lua_State *L;
+            LuaContext Context;
+
+            int TracebackRef = LUA_NOREF;
+            int LoadRef = LUA_NOREF;
+            int UpdateRef = LUA_NOREF;
+            int FixedUpdateRef = LUA_NOREF;
+            int DrawRef = LUA_NOREF;
+            int DestroyRef = LUA_NOREF;
 
-            float DeltaTime;
+            float DeltaTime = 0.0f;
+
+            TimestepSettings Timestep;
+            double Accumulator = 0.0;
+            float Alpha = 1.0f;
+            uint64_t TickCount = 0;
+            int FrameTicks = 0;
+            uint64_t DroppedTicks = 0;
 
             int ScreenWidth = 200;
             int ScreenHeight = 200;
@@ -424,8 +953,17 @@ namespace PGEApp {
             int ScreenYScale = 2;
         };
 
-        static App *instance = nullptr;
+    }
+
+    // The engine owning the calling state, it takes no stack slot
+    template<>
+    struct LuaArg<_::App *> {
+        static constexpr int Slots = 0;
+
+        static inline _::App *Get(lua_State *L, int) { return _::GetApp(L); }
+    };
 
+    namespace _ {
         ///////////////////////////////////////////////
         // Lua Modules
         ///////////////////////////////////////////////
@@ -433,521 +971,2661 @@ namespace PGEApp {
 #define DEFINE_LUA_FUNC(name) \
     static int name(lua_State *L)
 
-        static int RegisterLuaModule(lua_State *L, const char *moduleName, const luaL_Reg functions[]) {
-            auto ns = luabridge::getGlobalNamespace(L)
-                    .beginNamespace(PGELuaTableName)
-                    .beginNamespace(moduleName);
-
-            for (const luaL_Reg *reg = functions; reg->func; reg++)
-                ns.addFunction(reg->name, reg->func);
+        // Pushes PGE.<moduleName>, creating it if needed. PGE is a LuaBridge
+        // namespace with access metamethods, so it is only touched raw
+        static void PushLuaModule(lua_State *L, const char *moduleName) {
+            if (lua_getglobal(L, PGELuaTableName) != LUA_TTABLE) {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_setglobal(L, PGELuaTableName);
+            }
 
-            ns.endNamespace()
-                    .endNamespace();
+            lua_pushstring(L, moduleName);
+            if (lua_rawget(L, -2) != LUA_TTABLE) {
+                lua_pop(L, 1);
+                lua_createtable(L, 0, 0);
+                lua_pushstring(L, moduleName);
+                lua_pushvalue(L, -2);
+                lua_rawset(L, -4);
+            }
+            lua_remove(L, -2);
+        }
 
+        static int RegisterLuaModule(lua_State *L, const char *moduleName, const luaL_Reg functions[]) {
+            PushLuaModule(L, moduleName);
+            luaL_setfuncs(L, functions, 0);
+            lua_pop(L, 1);
             return 0;
         }
 
+        // Sets PGE.<moduleName>.<name> to a table of the constants
+        template<size_t N>
+        static void RegisterLuaConstants(lua_State *L, const char *moduleName, const char *name, const LuaConstant (&constants)[N]) {
+            PushLuaModule(L, moduleName);
+            PushLuaConstants(L, constants);
+            lua_setfield(L, -2, name);
+            lua_pop(L, 1);
+        }
+
         ///////////////////////////////////////////////
         // Timer
         ///////////////////////////////////////////////
 
-        DEFINE_LUA_FUNC(Timer_GetDeltaTime) {
-            lua_pushnumber(L, instance->GetDeltaTime());
+        static float Timer_GetDeltaTime(App *app) {
+            return app->GetDeltaTime();
+        }
+
+        // Returns {count, over_budget, budget_ms, mean_ms, min_ms, p50_ms, p95_ms, p99_ms, max_ms}
+        DEFINE_LUA_FUNC(Timer_FrameStats) {
+            const olc::FrameHistogram &frames = GetApp(L)->GetFrameHistogram();
+
+            lua_createtable(L, 0, 9);
+            lua_pushinteger(L, (lua_Integer) frames.Count());
+            lua_setfield(L, -2, "count");
+            lua_pushinteger(L, (lua_Integer) frames.CountOverBudget());
+            lua_setfield(L, -2, "over_budget");
+            lua_pushnumber(L, frames.Budget());
+            lua_setfield(L, -2, "budget_ms");
+            lua_pushnumber(L, frames.Mean());
+            lua_setfield(L, -2, "mean_ms");
+            lua_pushnumber(L, frames.Min());
+            lua_setfield(L, -2, "min_ms");
+            lua_pushnumber(L, frames.Percentile(50.0));
+            lua_setfield(L, -2, "p50_ms");
+            lua_pushnumber(L, frames.Percentile(95.0));
+            lua_setfield(L, -2, "p95_ms");
+            lua_pushnumber(L, frames.Percentile(99.0));
+            lua_setfield(L, -2, "p99_ms");
+            lua_pushnumber(L, frames.Max());
+            lua_setfield(L, -2, "max_ms");
+
             return 1;
         }
 
-        static const luaL_Reg TimerFunctions[] = {
-                {"get_delta_time", Timer_GetDeltaTime},
-                {NULL, NULL}};
+        static double Timer_FramePercentile(App *app, double p) {
+            return app->GetFrameHistogram().Percentile(p);
+        }
 
-        static int TimerRegisterFunctions(lua_State *L) {
-            return RegisterLuaModule(L, "timer", TimerFunctions);
+        static void Timer_SetFrameBudget(App *app, float ms) {
+            app->SetFrameBudget(ms / 1000.0f);
         }
 
-        ///////////////////////////////////////////////
-        // Window
-        ///////////////////////////////////////////////
+        static void Timer_ResetFrameStats(App *app) {
+            app->ResetFrameStats();
+        }
 
-        DEFINE_LUA_FUNC(Window_ScreenWidth) {
-            lua_pushinteger(L, instance->GetScreenWidth());
-            return 1;
+        // PGE.timer.set_frame_limit(fps [, unfocused_fps]), 0 runs unlimited
+        DEFINE_LUA_FUNC(Timer_SetFrameLimit) {
+            App *app = GetApp(L);
+            app->SetFrameLimit(float(luaL_checknumber(L, 1)));
+            if (!lua_isnoneornil(L, 2))
+                app->SetUnfocusedFrameLimit(float(luaL_checknumber(L, 2)));
+            return 0;
         }
 
-        DEFINE_LUA_FUNC(Window_ScreenHeight) {
-            lua_pushinteger(L, instance->GetScreenHeight());
-            return 1;
+        static float Timer_GetFrameLimit(App *app) {
+            return app->GetFrameLimit();
         }
 
-        DEFINE_LUA_FUNC(Window_IsFocused) {
-            lua_pushboolean(L, instance->IsFocused());
+        // Returns {frames, overruns, late, mean_error_us, mean_abs_error_us, max_error_us, sleep_ms, spin_ms}
+        DEFINE_LUA_FUNC(Timer_FramePacing) {
+            const olc::FramePacing &pacing = GetApp(L)->GetFramePacing();
+
+            lua_createtable(L, 0, 8);
+            lua_pushinteger(L, (lua_Integer) pacing.nFrames);
+            lua_setfield(L, -2, "frames");
+            lua_pushinteger(L, (lua_Integer) pacing.nOverruns);
+            lua_setfield(L, -2, "overruns");
+            lua_pushinteger(L, (lua_Integer) pacing.nLate);
+            lua_setfield(L, -2, "late");
+            lua_pushnumber(L, pacing.MeanErrorUs());
+            lua_setfield(L, -2, "mean_error_us");
+            lua_pushnumber(L, pacing.MeanAbsErrorUs());
+            lua_setfield(L, -2, "mean_abs_error_us");
+            lua_pushnumber(L, pacing.fMaxErrorUs);
+            lua_setfield(L, -2, "max_error_us");
+            lua_pushnumber(L, pacing.fSleepMs);
+            lua_setfield(L, -2, "sleep_ms");
+            lua_pushnumber(L, pacing.fSpinMs);
+            lua_setfield(L, -2, "spin_ms");
+
             return 1;
         }
 
-        static const luaL_Reg WindowFunctions[] = {
-                {"screen_width",  Window_ScreenWidth},
-                {"screen_height", Window_ScreenHeight},
-                {"is_focus",      Window_IsFocused},
-                {nullptr,         nullptr}};
+        static float Timer_GetFixedDeltaTime(App *app) {
+            return app->GetFixedDeltaTime();
+        }
 
-        static int WindowRegisterFunctions(lua_State *L) {
-            return RegisterLuaModule(L, "window", WindowFunctions);
+        static float Timer_GetAlpha(App *app) {
+            return app->GetAlpha();
         }
 
-        ///////////////////////////////////////////////
-        // Graphics
-        ///////////////////////////////////////////////
+        static uint64_t Timer_GetTickCount(App *app) {
+            return app->GetTickCount();
+        }
 
-        static olc::Pixel GetPixelFromLuaStack(lua_State *L, int top) {
-            auto r = (uint8_t) lua_tointeger(L, top + 0);
-            auto g = (uint8_t) lua_tointeger(L, top + 1);
-            auto b = (uint8_t) lua_tointeger(L, top + 2);
+        static int Timer_GetFrameTicks(App *app) {
+            return app->GetFrameTicks();
+        }
 
-            uint8_t a = 255;
-            if (lua_gettop(L) >= top + 3)
-                a = (uint8_t) lua_tointeger(L, top + 3);
+        static uint64_t Timer_GetDroppedTicks(App *app) {
+            return app->GetDroppedTicks();
+        }
 
-            return {r, g, b, a};
+        static bool Timer_IsFixed(App *app) {
+            return app->GetTimestepSettings().fixed;
         }
 
-        DEFINE_LUA_FUNC(Graphics_SetDrawTarget) {
-            auto sprite = (olc::Sprite *) lua_topointer(L, 1);
-            assert(sprite);
+        // PGE.timer.set_fixed_timestep(tick_rate [, max_steps]), a rate of 0 goes back to variable steps
+        static void Timer_SetFixedTimestep(App *app, double tickRate, LuaOpt<int, 0> maxSteps) {
+            auto &timestep = app->GetTimestepSettings();
+            timestep.fixed = tickRate > 0.0;
+            if (timestep.fixed)
+                timestep.tickRate = tickRate;
+            if (maxSteps > 0)
+                timestep.maxSteps = maxSteps;
+        }
 
-            instance->SetDrawTarget(sprite);
+        static const luaL_Reg TimerFunctions[] = {
+                {"get_delta_time",       LuaBind<Timer_GetDeltaTime>},
+                {"get_fixed_delta_time", LuaBind<Timer_GetFixedDeltaTime>},
+                {"get_alpha",            LuaBind<Timer_GetAlpha>},
+                {"get_tick_count",       LuaBind<Timer_GetTickCount>},
+                {"get_frame_ticks",      LuaBind<Timer_GetFrameTicks>},
+                {"get_dropped_ticks",    LuaBind<Timer_GetDroppedTicks>},
+                {"is_fixed",             LuaBind<Timer_IsFixed>},
+                {"set_fixed_timestep",   LuaBind<Timer_SetFixedTimestep>},
+                {"frame_stats",          Timer_FrameStats},
+                {"frame_percentile",     LuaBind<Timer_FramePercentile>},
+                {"set_frame_budget",     LuaBind<Timer_SetFrameBudget>},
+                {"reset_frame_stats",    LuaBind<Timer_ResetFrameStats>},
+                {"set_frame_limit",      Timer_SetFrameLimit},
+                {"get_frame_limit",      LuaBind<Timer_GetFrameLimit>},
+                {"frame_pacing",         Timer_FramePacing},
+                {NULL, NULL}};
 
-            return 0;
+        static int TimerRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "timer", TimerFunctions);
         }
 
-        DEFINE_LUA_FUNC(Graphics_GetDrawTargetWidth) {
-            auto width = instance->GetDrawTargetWidth();
-            lua_pushinteger(L, (lua_Integer) width);
-            return 1;
+        ///////////////////////////////////////////////
+        // Window
+        ///////////////////////////////////////////////
+
+        static int Window_ScreenWidth(App *app) {
+            return app->GetScreenWidth();
         }
 
-        DEFINE_LUA_FUNC(Graphics_GetDrawTargetHeight) {
-            auto height = instance->GetDrawTargetHeight();
-            lua_pushinteger(L, (lua_Integer) height);
-            return 1;
+        static int Window_ScreenHeight(App *app) {
+            return app->GetScreenHeight();
         }
 
-        DEFINE_LUA_FUNC(Graphics_GetDrawTarget) {
-            auto sprite = instance->GetDrawTarget();
-            lua_pushlightuserdata(L, sprite);
-            return 1;
+        static bool Window_IsFocused(App *app) {
+            return app->IsFocused();
         }
 
-        DEFINE_LUA_FUNC(Graphics_Clear) {
-            // TODO: Check arguments count
+        // PGE.window.request_redraw([delay]), the frame runs after delay seconds
+        static void Window_RequestRedraw(App *app, float delay) {
+            app->RequestRedraw(delay);
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 1);
-            instance->Clear(pixel);
-            return 0;
+        static void Window_SetReactive(App *app, bool reactive) {
+            app->SetReactive(reactive);
         }
 
-        DEFINE_LUA_FUNC(Graphics_Draw) {
-            // TODO: Check arguments count
+        static bool Window_IsReactive(App *app) {
+            return app->IsReactive();
+        }
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+        static uint64_t Window_SkippedFrames(App *app) {
+            return app->GetSkippedFrames();
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 3);
+        static bool Window_IsPipelined(App *app) {
+            return app->IsPipelined();
+        }
 
-            instance->Draw(x, y, pixel);
+        static const luaL_Reg WindowFunctions[] = {
+                {"screen_width",   LuaBind<Window_ScreenWidth>},
+                {"screen_height",  LuaBind<Window_ScreenHeight>},
+                {"is_focus",       LuaBind<Window_IsFocused>},
+                {"request_redraw", LuaBind<Window_RequestRedraw>},
+                {"set_reactive",   LuaBind<Window_SetReactive>},
+                {"is_reactive",    LuaBind<Window_IsReactive>},
+                {"skipped_frames", LuaBind<Window_SkippedFrames>},
+                {"is_pipelined",   LuaBind<Window_IsPipelined>},
+                {nullptr,          nullptr}};
 
-            return 0;
+        static int WindowRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "window", WindowFunctions);
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawLine) {
-            // TODO: Check arguments count
+        ///////////////////////////////////////////////
+        // Sprite / Decal handles
+        //   Engine objects are boxed in full userdata, owned ones are
+        //   released by __gc. A decal keeps its sprite reachable through
+        //   its user value, so the sprite cannot be collected first.
+        ///////////////////////////////////////////////
 
-            int32_t x1 = (int32_t) lua_tonumber(L, 1);
-            int32_t y1 = (int32_t) lua_tonumber(L, 2);
+        template<typename T>
+        struct Handle {
+            T *ptr;
+            // reported to App::AddExternalBytes while the handle owns ptr
+            size_t bytes;
+            bool owned;
+            // unload/destroy was called, the object itself goes with __gc
+            bool released;
+        };
 
-            int32_t x2 = (int32_t) lua_tonumber(L, 3);
-            int32_t y2 = (int32_t) lua_tonumber(L, 4);
+        using SpriteHandle = Handle<olc::Sprite>;
+        using DecalHandle = Handle<olc::Decal>;
+        using IndexedSpriteHandle = Handle<olc::IndexedSprite>;
 
-            auto pixel = GetPixelFromLuaStack(L, 5);
+        static const char *SpriteMetaName = "PGE.Sprite";
+        static const char *DecalMetaName = "PGE.Decal";
+        static const char *IndexedSpriteMetaName = "PGE.IndexedSprite";
 
-            instance->DrawLine(x1, y1, x2, y2, pixel);
+        // registry field holding the sprite set by set_draw_target
+        static const char *DrawTargetKey = "PGE.DrawTarget";
 
-            return 0;
-        }
+        static olc::Pixel GetPixelFromLuaStack(lua_State *L, int top);
 
-        DEFINE_LUA_FUNC(Graphics_DrawCircle) {
-            // TODO: Check arguments count
+        template<typename T>
+        static Handle<T> *TestHandle(lua_State *L, int idx, const void *meta) {
+            if (lua_type(L, idx) != LUA_TUSERDATA || !lua_getmetatable(L, idx))
+                return nullptr;
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+            bool match = lua_topointer(L, -1) == meta;
+            lua_pop(L, 1);
+            return match ? (Handle<T> *) lua_touserdata(L, idx) : nullptr;
+        }
 
-            int32_t r = (int32_t) lua_tonumber(L, 3);
+        template<typename T>
+        static T *CheckHandle(lua_State *L, int idx, const void *meta, const char *name) {
+            auto handle = TestHandle<T>(L, idx, meta);
+            if (handle == nullptr)
+                luaL_typeerror(L, idx, name);
+            if (handle->released)
+                luaL_argerror(L, idx, "object was released");
+            return handle->ptr;
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 4);
+        static olc::Sprite *CheckSprite(lua_State *L, int idx) {
+            return CheckHandle<olc::Sprite>(L, idx, GetContext(L).spriteMeta, SpriteMetaName);
+        }
 
-            instance->DrawCircle(x, y, r, pixel);
+        static olc::Decal *CheckDecal(lua_State *L, int idx) {
+            return CheckHandle<olc::Decal>(L, idx, GetContext(L).decalMeta, DecalMetaName);
+        }
 
-            return 0;
+        static olc::IndexedSprite *CheckIndexedSprite(lua_State *L, int idx) {
+            return CheckHandle<olc::IndexedSprite>(L, idx, GetContext(L).indexedSpriteMeta, IndexedSpriteMetaName);
         }
 
-        DEFINE_LUA_FUNC(Graphics_FillCircle) {
-            // TODO: Check arguments count
+    }
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+    template<>
+    struct LuaArg<olc::Sprite *> {
+        static constexpr int Slots = 1;
 
-            int32_t r = (int32_t) lua_tonumber(L, 3);
+        static inline olc::Sprite *Get(lua_State *L, int idx) { return _::CheckSprite(L, idx); }
+    };
 
-            auto pixel = GetPixelFromLuaStack(L, 4);
+    template<>
+    struct LuaArg<olc::Decal *> {
+        static constexpr int Slots = 1;
 
-            instance->FillCircle(x, y, r, pixel);
+        static inline olc::Decal *Get(lua_State *L, int idx) { return _::CheckDecal(L, idx); }
+    };
 
-            return 0;
-        }
+    template<>
+    struct LuaArg<olc::IndexedSprite *> {
+        static constexpr int Slots = 1;
 
-        DEFINE_LUA_FUNC(Graphics_DrawRect) {
-            // TODO: Check arguments count
+        static inline olc::IndexedSprite *Get(lua_State *L, int idx) { return _::CheckIndexedSprite(L, idx); }
+    };
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+    namespace _ {
+        template<typename T>
+        static void PushHandle(lua_State *L, T *ptr, bool owned, const char *name, size_t bytes, int userValues = 0) {
+            auto handle = (Handle<T> *) lua_newuserdatauv(L, sizeof(Handle<T>), userValues);
+            handle->ptr = ptr;
+            handle->bytes = owned ? bytes : 0;
+            handle->owned = owned;
+            handle->released = false;
+
+            luaL_setmetatable(L, name);
+            GetApp(L)->AddExternalBytes(int64_t(handle->bytes));
+        }
 
-            int32_t w = (int32_t) lua_tonumber(L, 3);
-            int32_t h = (int32_t) lua_tonumber(L, 4);
+        template<typename T>
+        static void FreeHandleObject(lua_State *, T *ptr) {
+            delete ptr;
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 5);
+        // Draws of the decal may be queued for the frame, the engine deletes it after present
+        static void FreeHandleObject(lua_State *L, olc::Decal *decal) {
+            GetApp(L)->RetireDecal(decal);
+        }
 
-            instance->DrawRect(x, y, w, h, pixel);
+        template<typename T>
+        static void ReleaseHandle(lua_State *L, int idx) {
+            auto handle = (Handle<T> *) lua_touserdata(L, idx);
+            if (handle->owned)
+                FreeHandleObject(L, handle->ptr);
+            GetApp(L)->AddExternalBytes(-int64_t(handle->bytes));
 
-            return 0;
+            handle->ptr = nullptr;
+            handle->bytes = 0;
+            handle->released = true;
         }
 
-        DEFINE_LUA_FUNC(Graphics_FillRect) {
-            // TODO: Check arguments count
+        static void PushSprite(lua_State *L, olc::Sprite *sprite, bool owned) {
+            PushHandle(L, sprite, owned, SpriteMetaName, sprite->pColData.size() * sizeof(olc::Pixel));
+        }
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+        // The sprite handle at spriteIdx is stored as the decal's user value
+        static void PushDecal(lua_State *L, olc::Decal *decal, int spriteIdx) {
+            spriteIdx = lua_absindex(L, spriteIdx);
+            PushHandle(L, decal, true, DecalMetaName, 0, 1);
+            lua_pushvalue(L, spriteIdx);
+            lua_setiuservalue(L, -2, 1);
+        }
 
-            int32_t w = (int32_t) lua_tonumber(L, 3);
-            int32_t h = (int32_t) lua_tonumber(L, 4);
+        static void PushIndexedSprite(lua_State *L, olc::IndexedSprite *sprite) {
+            PushHandle(L, sprite, true, IndexedSpriteMetaName, size_t(sprite->width) * size_t(sprite->height));
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 5);
+        // Keeps the value at idx reachable from the userdata at ownerIdx (its first user value)
+        static void RetainInUserValue(lua_State *L, int ownerIdx, int idx) {
+            ownerIdx = lua_absindex(L, ownerIdx);
+            idx = lua_absindex(L, idx);
+            lua_pushvalue(L, idx);
+            lua_setiuservalue(L, ownerIdx, 1);
+        }
 
-            instance->FillRect(x, y, w, h, pixel);
+        DEFINE_LUA_FUNC(Sprite_GC) {
+            App *app = GetApp(L);
+            auto handle = (SpriteHandle *) lua_touserdata(L, 1);
+            // never leave the engine drawing into freed pixels
+            if (handle->owned && handle->ptr && app->GetDrawTarget() == handle->ptr)
+                app->SetDrawTarget(nullptr);
 
+            ReleaseHandle<olc::Sprite>(L, 1);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawTriangle) {
-            // TODO: Check arguments count
+        static int32_t Sprite_Width(olc::Sprite *sprite) {
+            return sprite->width;
+        }
 
-            int32_t x1 = (int32_t) lua_tonumber(L, 1);
-            int32_t y1 = (int32_t) lua_tonumber(L, 2);
+        static int32_t Sprite_Height(olc::Sprite *sprite) {
+            return sprite->height;
+        }
+
+        // spr:draw(x, y [, scale])
+        static void Sprite_Draw(App *app, olc::Sprite *sprite, int32_t x, int32_t y, LuaOpt<uint32_t, 1> scale) {
+            app->DrawSprite(x, y, sprite, scale);
+        }
+
+        // spr:draw_partial(x, y, ox, oy, w, h [, scale])
+        static void Sprite_DrawPartial(App *app, olc::Sprite *sprite, int32_t x, int32_t y, int32_t xOffset, int32_t yOffset,
+                                       int32_t width, int32_t height, LuaOpt<uint32_t, 1> scale) {
+            app->DrawPartialSprite(x, y, sprite, xOffset, yOffset, width, height, scale);
+        }
+
+        static olc::Pixel Sprite_GetPixel(olc::Sprite *sprite, int32_t x, int32_t y) {
+            return sprite->GetPixel(x, y);
+        }
+
+        static bool Sprite_SetPixel(olc::Sprite *sprite, int32_t x, int32_t y, olc::Pixel p) {
+            return sprite->SetPixel(x, y, p);
+        }
+
+        static void Sprite_EnableSpanCache(olc::Sprite *sprite, LuaOpt<bool, true> enable) {
+            sprite->EnableSpanCache(enable);
+        }
+
+        static const luaL_Reg SpriteMethods[] = {
+                {"width",             LuaBind<Sprite_Width>},
+                {"height",            LuaBind<Sprite_Height>},
+                {"draw",              LuaBind<Sprite_Draw>},
+                {"draw_partial",      LuaBind<Sprite_DrawPartial>},
+                {"get_pixel",         LuaBind<Sprite_GetPixel>},
+                {"set_pixel",         LuaBind<Sprite_SetPixel>},
+                {"enable_span_cache", LuaBind<Sprite_EnableSpanCache>},
+                {"__gc",              Sprite_GC},
+                {nullptr,             nullptr}};
+
+        DEFINE_LUA_FUNC(Decal_GC) {
+            // retires the texture, the sprite user value is collected on its own
+            ReleaseHandle<olc::Decal>(L, 1);
+            return 0;
+        }
+
+        static int32_t Decal_Width(olc::Decal *decal) {
+            return decal->sprite->width;
+        }
+
+        static int32_t Decal_Height(olc::Decal *decal) {
+            return decal->sprite->height;
+        }
+
+        DEFINE_LUA_FUNC(Decal_Sprite) {
+            CheckDecal(L, 1);
+            lua_getiuservalue(L, 1, 1);
+            return 1;
+        }
+
+        // dec:draw(x, y [, scale_x, scale_y])
+        DEFINE_LUA_FUNC(Decal_Draw) {
+            auto decal = CheckDecal(L, 1);
+
+            auto x = (float) lua_tonumber(L, 2);
+            auto y = (float) lua_tonumber(L, 3);
+            auto xScale = (float) luaL_optnumber(L, 4, 1.0);
+            auto yScale = (float) luaL_optnumber(L, 5, xScale);
+
+            GetApp(L)->DrawDecal({x, y}, decal, {xScale, yScale});
+            return 0;
+        }
+
+        // dec:draw_rotated(x, y, angle [, cx, cy, scale_x, scale_y, r, g, b, a])
+        DEFINE_LUA_FUNC(Decal_DrawRotated) {
+            auto decal = CheckDecal(L, 1);
+
+            auto x = (float) lua_tonumber(L, 2);
+            auto y = (float) lua_tonumber(L, 3);
+            auto angle = (float) lua_tonumber(L, 4);
+            auto xCenter = (float) luaL_optnumber(L, 5, 0.0);
+            auto yCenter = (float) luaL_optnumber(L, 6, 0.0);
+            auto xScale = (float) luaL_optnumber(L, 7, 1.0);
+            auto yScale = (float) luaL_optnumber(L, 8, 1.0);
+            auto tint = lua_gettop(L) >= 11 ? GetPixelFromLuaStack(L, 9) : olc::WHITE;
+
+            GetApp(L)->DrawRotatedDecal({x, y}, decal, angle, {xCenter, yCenter}, {xScale, yScale}, tint);
+            return 0;
+        }
+
+        // re-uploads the sprite, e.g. after writing it through a buffer view
+        static void Decal_Update(olc::Decal *decal) {
+            decal->Update();
+        }
+
+        static const luaL_Reg DecalMethods[] = {
+                {"width",        LuaBind<Decal_Width>},
+                {"height",       LuaBind<Decal_Height>},
+                {"sprite",       Decal_Sprite},
+                {"draw",         Decal_Draw},
+                {"draw_rotated", Decal_DrawRotated},
+                {"update",       LuaBind<Decal_Update>},
+                {"__gc",         Decal_GC},
+                {nullptr,        nullptr}};
+
+        DEFINE_LUA_FUNC(IndexedSprite_GC) {
+            ReleaseHandle<olc::IndexedSprite>(L, 1);
+            return 0;
+        }
+
+        static int32_t IndexedSprite_Width(olc::IndexedSprite *sprite) {
+            return sprite->width;
+        }
+
+        static int32_t IndexedSprite_Height(olc::IndexedSprite *sprite) {
+            return sprite->height;
+        }
+
+        // spr:draw(x, y [, scale])
+        static void IndexedSprite_Draw(App *app, olc::IndexedSprite *sprite, int32_t x, int32_t y, LuaOpt<uint32_t, 1> scale) {
+            app->DrawIndexedSprite(x, y, sprite, scale);
+        }
+
+        // spr:draw_partial(x, y, ox, oy, w, h [, scale])
+        static void IndexedSprite_DrawPartial(App *app, olc::IndexedSprite *sprite, int32_t x, int32_t y, int32_t xOffset, int32_t yOffset,
+                                              int32_t width, int32_t height, LuaOpt<uint32_t, 1> scale) {
+            app->DrawPartialIndexedSprite(x, y, sprite, xOffset, yOffset, width, height, scale);
+        }
+
+        static void IndexedSprite_SetPaletteColor(olc::IndexedSprite *sprite, uint8_t index, olc::Pixel p) {
+            sprite->SetPaletteEntry(index, p);
+        }
+
+        static olc::Pixel IndexedSprite_GetPaletteColor(olc::IndexedSprite *sprite, uint8_t index) {
+            return sprite->GetPaletteEntry(index);
+        }
+
+        static int IndexedSprite_GetPaletteSize(olc::IndexedSprite *sprite) {
+            return sprite->nPaletteSize;
+        }
+
+        static const luaL_Reg IndexedSpriteMethods[] = {
+                {"width",             LuaBind<IndexedSprite_Width>},
+                {"height",            LuaBind<IndexedSprite_Height>},
+                {"draw",              LuaBind<IndexedSprite_Draw>},
+                {"draw_partial",      LuaBind<IndexedSprite_DrawPartial>},
+                {"set_palette_color", LuaBind<IndexedSprite_SetPaletteColor>},
+                {"get_palette_color", LuaBind<IndexedSprite_GetPaletteColor>},
+                {"palette_size",      LuaBind<IndexedSprite_GetPaletteSize>},
+                {"__gc",              IndexedSprite_GC},
+                {nullptr,             nullptr}};
+
+        static const void *NewHandleMetatable(lua_State *L, const char *name, const luaL_Reg *methods) {
+            luaL_newmetatable(L, name);
+            luaL_setfuncs(L, methods, 0);
+            lua_pushvalue(L, -1);
+            lua_setfield(L, -2, "__index");
+
+            const void *meta = lua_topointer(L, -1);
+            lua_pop(L, 1);
+            return meta;
+        }
+
+        // Called once per state before any handle is pushed
+        static void RegisterHandleMetatables(lua_State *L) {
+            LuaContext &context = GetContext(L);
+            context.spriteMeta = NewHandleMetatable(L, SpriteMetaName, SpriteMethods);
+            context.decalMeta = NewHandleMetatable(L, DecalMetaName, DecalMethods);
+            context.indexedSpriteMeta = NewHandleMetatable(L, IndexedSpriteMetaName, IndexedSpriteMethods);
+        }
+
+        ///////////////////////////////////////////////
+        // Buffer
+        ///////////////////////////////////////////////
+
+        static const char *BufferMetaName = "PGE.Buffer";
+
+        static const char *const BufferTypeNames[] = {"f32", "i32", "u8", "rgba", nullptr};
+
+        static Buffer *CheckBuffer(lua_State *L, int idx) {
+            return (Buffer *) luaL_checkudata(L, idx, BufferMetaName);
+        }
+
+        static Buffer *CheckBuffer(lua_State *L, int idx, Buffer::Type type) {
+            auto buffer = CheckBuffer(L, idx);
+            if (buffer->type != type) {
+                lua_pushfstring(L, "%s buffer expected", BufferTypeNames[type]);
+                luaL_argerror(L, idx, lua_tostring(L, -1));
+            }
+            return buffer;
+        }
+
+        // 1 based index argument, raises an error when out of range
+        static size_t CheckBufferIndex(lua_State *L, const Buffer *buffer, int idx) {
+            lua_Integer i = luaL_checkinteger(L, idx);
+            luaL_argcheck(L, i >= 1 && (size_t) i <= buffer->length, idx, "index out of range");
+            return size_t(i - 1);
+        }
+
+        static void PushBufferMetatable(lua_State *L);
+
+        static Buffer *NewBuffer(lua_State *L, Buffer::Type type, size_t length, uint8_t *view = nullptr) {
+            size_t bytes = view ? 0 : length * Buffer::ElementSize(type);
+
+            auto buffer = (Buffer *) lua_newuserdatauv(L, sizeof(Buffer) + bytes, 1);
+            buffer->type = type;
+            buffer->length = length;
+            buffer->data = view ? view : (uint8_t *) (buffer + 1);
+            buffer->sprite = nullptr;
+            buffer->heap = nullptr;
+
+            if (!view)
+                std::memset(buffer->data, 0, bytes);
+
+            PushBufferMetatable(L);
+            lua_setmetatable(L, -2);
+
+            return buffer;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_Index) {
+            // only called for buffers, the metatable guarantees the type
+            auto buffer = (Buffer *) lua_touserdata(L, 1);
+
+            int isInteger = 0;
+            lua_Integer i = lua_tointegerx(L, 2, &isInteger);
+            if (!isInteger) {
+                lua_pushvalue(L, 2);
+                lua_rawget(L, lua_upvalueindex(1));
+                return 1;
+            }
+
+            if (i < 1 || (size_t) i > buffer->length) {
+                lua_pushnil(L);
+                return 1;
+            }
+
+            switch (buffer->type) {
+                case Buffer::F32:
+                    lua_pushnumber(L, buffer->As<float>()[i - 1]);
+                    break;
+                case Buffer::I32:
+                    lua_pushinteger(L, buffer->As<int32_t>()[i - 1]);
+                    break;
+                case Buffer::U8:
+                    lua_pushinteger(L, buffer->data[i - 1]);
+                    break;
+                case Buffer::RGBA:
+                    lua_pushinteger(L, buffer->As<uint32_t>()[i - 1]);
+                    break;
+            }
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_NewIndex) {
+            auto buffer = (Buffer *) lua_touserdata(L, 1);
+            size_t i = CheckBufferIndex(L, buffer, 2);
+
+            switch (buffer->type) {
+                case Buffer::F32:
+                    buffer->As<float>()[i] = (float) lua_tonumber(L, 3);
+                    break;
+                case Buffer::I32:
+                    buffer->As<int32_t>()[i] = (int32_t) lua_tointeger(L, 3);
+                    break;
+                case Buffer::U8:
+                    buffer->data[i] = (uint8_t) lua_tointeger(L, 3);
+                    break;
+                case Buffer::RGBA:
+                    buffer->As<uint32_t>()[i] = (uint32_t) lua_tointeger(L, 3);
+                    break;
+            }
+            buffer->Touch();
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_Len) {
+            lua_pushinteger(L, (lua_Integer) ((Buffer *) lua_touserdata(L, 1))->length);
+            return 1;
+        }
+
+        // only buffers received from another state own a heap block
+        DEFINE_LUA_FUNC(Buffer_GC) {
+            auto buffer = (Buffer *) lua_touserdata(L, 1);
+            delete[] buffer->heap;
+            buffer->heap = nullptr;
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_Type) {
+            lua_pushstring(L, BufferTypeNames[CheckBuffer(L, 1)->type]);
+            return 1;
+        }
+
+        // buffer:fill(value [, first = 1, count = #buffer])
+        DEFINE_LUA_FUNC(Buffer_Fill) {
+            auto buffer = CheckBuffer(L, 1);
+
+            auto value = luaL_checknumber(L, 2);
+            auto first = (size_t) luaL_optinteger(L, 3, 1);
+            auto count = (size_t) luaL_optinteger(L, 4, (lua_Integer) buffer->length);
+            luaL_argcheck(L, first >= 1, 3, "index out of range");
+
+            buffer->Fill(value, first - 1, count);
+            return 0;
+        }
+
+        // buffer:copy(src [, first = 1, src_first = 1, count = #src])
+        DEFINE_LUA_FUNC(Buffer_Copy) {
+            auto buffer = CheckBuffer(L, 1);
+            auto src = CheckBuffer(L, 2);
+
+            auto first = (size_t) luaL_optinteger(L, 3, 1);
+            auto srcFirst = (size_t) luaL_optinteger(L, 4, 1);
+            auto count = (size_t) luaL_optinteger(L, 5, (lua_Integer) src->length);
+            luaL_argcheck(L, first >= 1, 3, "index out of range");
+            luaL_argcheck(L, srcFirst >= 1, 4, "index out of range");
+
+            if (!buffer->Copy(*src, first - 1, srcFirst - 1, count))
+                return luaL_argerror(L, 2, "buffer of the same type expected");
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_GetRGBA) {
+            auto buffer = CheckBuffer(L, 1, Buffer::RGBA);
+            olc::Pixel p = buffer->As<olc::Pixel>()[CheckBufferIndex(L, buffer, 2)];
+
+            lua_pushinteger(L, p.r);
+            lua_pushinteger(L, p.g);
+            lua_pushinteger(L, p.b);
+            lua_pushinteger(L, p.a);
+            return 4;
+        }
+
+        DEFINE_LUA_FUNC(Buffer_SetRGBA) {
+            auto buffer = CheckBuffer(L, 1, Buffer::RGBA);
+            size_t i = CheckBufferIndex(L, buffer, 2);
+
+            buffer->As<olc::Pixel>()[i] = GetPixelFromLuaStack(L, 3);
+            buffer->Touch();
+            return 0;
+        }
+
+        static const luaL_Reg BufferMethods[] = {
+                {"type",     Buffer_Type},
+                {"fill",     Buffer_Fill},
+                {"copy",     Buffer_Copy},
+                {"get_rgba", Buffer_GetRGBA},
+                {"set_rgba", Buffer_SetRGBA},
+                {nullptr,    nullptr}};
+
+        static void PushBufferMetatable(lua_State *L) {
+            if (luaL_newmetatable(L, BufferMetaName)) {
+                lua_newtable(L);
+                luaL_setfuncs(L, BufferMethods, 0);
+                lua_pushcclosure(L, Buffer_Index, 1);
+                lua_setfield(L, -2, "__index");
+
+                lua_pushcfunction(L, Buffer_NewIndex);
+                lua_setfield(L, -2, "__newindex");
+
+                lua_pushcfunction(L, Buffer_Len);
+                lua_setfield(L, -2, "__len");
+
+                lua_pushcfunction(L, Buffer_GC);
+                lua_setfield(L, -2, "__gc");
+            }
+        }
+
+        // PGE.buffer.new(type, length), type is "f32", "i32", "u8" or "rgba"
+        DEFINE_LUA_FUNC(Buffer_New) {
+            auto type = (Buffer::Type) luaL_checkoption(L, 1, nullptr, BufferTypeNames);
+            auto length = luaL_checkinteger(L, 2);
+            luaL_argcheck(L, length >= 0, 2, "negative length");
+            luaL_argcheck(L, (uint64_t) length <= (SIZE_MAX - sizeof(Buffer)) / Buffer::ElementSize(type), 2, "length too large");
+
+            NewBuffer(L, type, (size_t) length);
+            return 1;
+        }
+
+        // rgba view of a sprite's pixels, writes go straight to the sprite
+        DEFINE_LUA_FUNC(Buffer_FromSprite) {
+            auto sprite = CheckSprite(L, 1);
+
+            auto buffer = NewBuffer(L, Buffer::RGBA, sprite->pColData.size(), (uint8_t *) sprite->GetData());
+            buffer->sprite = sprite;
+
+            // keep the sprite value reachable for as long as the view
+            RetainInUserValue(L, -1, 1);
+
+            return 1;
+        }
+
+        static const luaL_Reg BufferFunctions[] = {
+                {"new",         Buffer_New},
+                {"from_sprite", Buffer_FromSprite},
+                {nullptr,       nullptr}};
+
+        static int BufferRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "buffer", BufferFunctions);
+        }
+
+        ///////////////////////////////////////////////
+        // Graphics
+        ///////////////////////////////////////////////
+
+        static olc::Pixel GetPixelFromLuaStack(lua_State *L, int top) {
+            auto r = (uint8_t) lua_tointeger(L, top + 0);
+            auto g = (uint8_t) lua_tointeger(L, top + 1);
+            auto b = (uint8_t) lua_tointeger(L, top + 2);
+
+            uint8_t a = 255;
+            if (lua_gettop(L) >= top + 3)
+                a = (uint8_t) lua_tointeger(L, top + 3);
+
+            return {r, g, b, a};
+        }
+
+        DEFINE_LUA_FUNC(Graphics_SetDrawTarget) {
+            // nil goes back to the screen
+            olc::Sprite *sprite = lua_isnoneornil(L, 1) ? nullptr : CheckSprite(L, 1);
+
+            GetApp(L)->SetDrawTarget(sprite);
+
+            // the target stays referenced until another one is set
+            lua_settop(L, 1);
+            lua_setfield(L, LUA_REGISTRYINDEX, DrawTargetKey);
+
+            return 0;
+        }
+
+        static int32_t Graphics_GetDrawTargetWidth(App *app) {
+            return app->GetDrawTargetWidth();
+        }
+
+        static int32_t Graphics_GetDrawTargetHeight(App *app) {
+            return app->GetDrawTargetHeight();
+        }
+
+        DEFINE_LUA_FUNC(Graphics_GetDrawTarget) {
+            auto sprite = GetApp(L)->GetDrawTarget();
+
+            lua_getfield(L, LUA_REGISTRYINDEX, DrawTargetKey);
+            auto handle = TestHandle<olc::Sprite>(L, -1, GetContext(L).spriteMeta);
+            if (handle == nullptr || handle->ptr != sprite) {
+                // an engine layer, owned by the engine
+                lua_pop(L, 1);
+                PushSprite(L, sprite, false);
+            }
+            return 1;
+        }
+
+        static void Graphics_Clear(App *app, olc::Pixel p) {
+            OLC_PROFILE_ZONE("Clear");
+            app->Clear(p);
+        }
+
+        static void Graphics_Draw(App *app, int32_t x, int32_t y, olc::Pixel p) {
+            app->Draw(x, y, p);
+        }
+
+        static void Graphics_DrawLine(App *app, int32_t x1, int32_t y1, int32_t x2, int32_t y2, olc::Pixel p) {
+            app->DrawLine(x1, y1, x2, y2, p);
+        }
+
+        static void Graphics_DrawCircle(App *app, int32_t x, int32_t y, int32_t radius, olc::Pixel p) {
+            app->DrawCircle(x, y, radius, p);
+        }
+
+        static void Graphics_FillCircle(App *app, int32_t x, int32_t y, int32_t radius, olc::Pixel p) {
+            app->FillCircle(x, y, radius, p);
+        }
+
+        static void Graphics_DrawRect(App *app, int32_t x, int32_t y, int32_t w, int32_t h, olc::Pixel p) {
+            app->DrawRect(x, y, w, h, p);
+        }
+
+        static void Graphics_FillRect(App *app, int32_t x, int32_t y, int32_t w, int32_t h, olc::Pixel p) {
+            app->FillRect(x, y, w, h, p);
+        }
+
+        static void Graphics_DrawTriangle(App *app, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, olc::Pixel p) {
+            app->DrawTriangle(x1, y1, x2, y2, x3, y3, p);
+        }
+
+        static void Graphics_FillTriangle(App *app, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, olc::Pixel p) {
+            app->FillTriangle(x1, y1, x2, y2, x3, y3, p);
+        }
+
+        DEFINE_LUA_FUNC(Graphics_LoadSprite) {
+            OLC_PROFILE_ZONE("Load Sprite");
+            auto path = luaL_checkstring(L, 1);
+
+            auto sprite = new olc::Sprite(std::string(path));
+            assert(sprite);
+
+            // convert once at load time so blits can use PixelMode.Premultiplied
+            if (lua_toboolean(L, 2))
+                sprite->Premultiply();
+
+            PushSprite(L, sprite, true);
+            return 1;
+        }
+
+        // load_sprites({paths}, premultiply) -> {sprites}, decodes the files on the job system
+        DEFINE_LUA_FUNC(Graphics_LoadSprites) {
+            OLC_PROFILE_ZONE("Load Sprites");
+            luaL_checktype(L, 1, LUA_TTABLE);
+            bool premultiply = lua_toboolean(L, 2);
+
+            // the paths stay on the stack, nothing to free if one is not a string
+            auto count = size_t(luaL_len(L, 1));
+            luaL_checkstack(L, int(count), "too many sprites");
+            for (size_t i = 0; i < count; i++) {
+                lua_rawgeti(L, 1, lua_Integer(i + 1));
+                if (!lua_isstring(L, -1))
+                    return luaL_error(L, "sprite path %d is not a string", int(i + 1));
+            }
+
+            std::vector<std::string> paths(count);
+            for (size_t i = 0; i < count; i++)
+                paths[i] = lua_tostring(L, int(i) + 3);
+
+            std::vector<olc::Sprite *> sprites(paths.size());
+            GetApp(L)->GetJobs().ParallelFor(0, paths.size(), 1, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++) {
+                    sprites[i] = new olc::Sprite(paths[i]);
+                    if (premultiply)
+                        sprites[i]->Premultiply();
+                }
+            });
+
+            lua_createtable(L, int(sprites.size()), 0);
+            for (size_t i = 0; i < sprites.size(); i++) {
+                PushSprite(L, sprites[i], true);
+                lua_rawseti(L, -2, lua_Integer(i + 1));
+            }
+            return 1;
+        }
+
+        // largest width or height create_sprite accepts, a 16k x 16k sprite is 1 GiB
+        static constexpr lua_Integer MaxSpriteSize = 16384;
+
+        DEFINE_LUA_FUNC(Graphics_CreateSprite) {
+            lua_Integer width = luaL_checkinteger(L, 1);
+            lua_Integer height = luaL_checkinteger(L, 2);
+            luaL_argcheck(L, width > 0 && width <= MaxSpriteSize, 1, "width must be between 1 and 16384");
+            luaL_argcheck(L, height > 0 && height <= MaxSpriteSize, 2, "height must be between 1 and 16384");
+
+            // offscreen target, render static content into it once and blit it each frame
+            auto sprite = new olc::Sprite(int32_t(width), int32_t(height));
+            assert(sprite);
+
+            PushSprite(L, sprite, true);
+            return 1;
+        }
+
+        // Kept for old scripts: the handle stops working right away, the pixels are
+        // freed once nothing (decals, views, tile maps...) references the sprite
+        DEFINE_LUA_FUNC(Graphics_UnloadSprite) {
+            CheckSprite(L, 1);
+            ((SpriteHandle *) lua_touserdata(L, 1))->released = true;
+            return 0;
+        }
+
+
+        DEFINE_LUA_FUNC(Graphics_LoadIndexedSprite) {
+            auto path = luaL_checkstring(L, 1);
+
+            auto sprite = new olc::IndexedSprite();
+            if (sprite->LoadFromFile(std::string(path)) != olc::rcode::OK) {
+                // missing file or more than 256 colours
+                delete sprite;
+                lua_pushnil(L);
+                return 1;
+            }
+
+            PushIndexedSprite(L, sprite);
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(Graphics_UnloadIndexedSprite) {
+            CheckIndexedSprite(L, 1);
+            ((IndexedSpriteHandle *) lua_touserdata(L, 1))->released = true;
+            return 0;
+        }
+
+
+        ///////////////////////////////////////////////
+        // TileMap
+        ///////////////////////////////////////////////
+
+        static const char *TileMapMetaName = "PGE.TileMap";
+
+        static TileMap *CheckTileMap(lua_State *L, int idx) {
+            return (TileMap *) luaL_checkudata(L, idx, TileMapMetaName);
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Set) {
+            auto map = CheckTileMap(L, 1);
+
+            auto x = (int32_t) lua_tointeger(L, 2);
+            auto y = (int32_t) lua_tointeger(L, 3);
+            auto tile = (uint16_t) lua_tointeger(L, 4);
+
+            lua_pushboolean(L, map->Set(x, y, tile));
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Get) {
+            auto map = CheckTileMap(L, 1);
+
+            auto x = (int32_t) lua_tointeger(L, 2);
+            auto y = (int32_t) lua_tointeger(L, 3);
+
+            lua_pushinteger(L, map->Get(x, y));
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Draw) {
+            OLC_PROFILE_ZONE("TileMap Draw");
+            auto map = CheckTileMap(L, 1);
+
+            auto x = (int32_t) lua_tonumber(L, 2);
+            auto y = (int32_t) lua_tonumber(L, 3);
+
+            map->Draw(GetApp(L), x, y);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_EnableCache) {
+            auto map = CheckTileMap(L, 1);
+
+            bool enable = true;
+            if (lua_gettop(L) >= 2)
+                enable = lua_toboolean(L, 2);
+
+            map->EnableCache(enable);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Invalidate) {
+            auto map = CheckTileMap(L, 1);
+
+            auto x = (int32_t) lua_tointeger(L, 2);
+            auto y = (int32_t) lua_tointeger(L, 3);
+
+            map->Invalidate(x, y);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_InvalidateAll) {
+            CheckTileMap(L, 1)->InvalidateAll();
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Width) {
+            lua_pushinteger(L, CheckTileMap(L, 1)->GetWidth());
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_Height) {
+            lua_pushinteger(L, CheckTileMap(L, 1)->GetHeight());
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(TileMap_GC) {
+            CheckTileMap(L, 1)->~TileMap();
+            return 0;
+        }
+
+        static const luaL_Reg TileMapMethods[] = {
+                {"set",            TileMap_Set},
+                {"get",            TileMap_Get},
+                {"draw",           TileMap_Draw},
+                {"enable_cache",   TileMap_EnableCache},
+                {"invalidate",     TileMap_Invalidate},
+                {"invalidate_all", TileMap_InvalidateAll},
+                {"width",          TileMap_Width},
+                {"height",         TileMap_Height},
+                {"__gc",           TileMap_GC},
+                {nullptr,          nullptr}};
+
+        DEFINE_LUA_FUNC(Graphics_CreateTileMap) {
+            auto width = (int32_t) lua_tointeger(L, 1);
+            auto height = (int32_t) lua_tointeger(L, 2);
+
+            auto atlas = CheckSprite(L, 3);
+
+            auto tileWidth = (int32_t) lua_tointeger(L, 4);
+            auto tileHeight = (int32_t) lua_tointeger(L, 5);
+
+            auto map = (TileMap *) lua_newuserdatauv(L, sizeof(TileMap), 1);
+            new(map) TileMap(width, height, atlas, tileWidth, tileHeight);
+
+            // the atlas is borrowed, the map keeps it alive
+            RetainInUserValue(L, -1, 3);
+
+            if (luaL_newmetatable(L, TileMapMetaName)) {
+                luaL_setfuncs(L, TileMapMethods, 0);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, -2, "__index");
+            }
+            lua_setmetatable(L, -2);
+
+            return 1;
+        }
+
+        ///////////////////////////////////////////////
+        // CommandBuffer
+        //   Arguments match the PGE.graphics function of the same name.
+        //   Everything that can raise a Lua error runs before Begin, a
+        //   half written command would throw off Submit's decoding.
+        ///////////////////////////////////////////////
+
+        static const char *CommandBufferMetaName = "PGE.CommandBuffer";
+
+        static CommandBuffer *CheckCommandBuffer(lua_State *L, int idx) {
+            return (CommandBuffer *) luaL_checkudata(L, idx, CommandBufferMetaName);
+        }
+
+        // Recorded sprites/decals are stored in the buffer's user value table
+        // so they stay alive until the buffer is reset or collected
+        static void RetainCommandResource(lua_State *L, int idx) {
+            lua_getiuservalue(L, 1, 1);
+            lua_pushvalue(L, idx);
+            lua_pushboolean(L, 1);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+        }
+
+        static void PushIntArgs(lua_State *L, CommandBuffer *cb, int first, int count) {
+            for (int i = 0; i < count; i++)
+                cb->PushInt((int32_t) lua_tonumber(L, first + i));
+        }
+
+        static void PushFloatArgs(lua_State *L, CommandBuffer *cb, int first, int count) {
+            for (int i = 0; i < count; i++)
+                cb->PushFloat((float) lua_tonumber(L, first + i));
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_Clear) {
+            auto cb = CheckCommandBuffer(L, 1);
+            cb->Begin(CommandBuffer::CLEAR);
+            cb->PushPixel(GetPixelFromLuaStack(L, 2));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_Draw) {
+            auto cb = CheckCommandBuffer(L, 1);
+            cb->Begin(CommandBuffer::DRAW);
+            PushIntArgs(L, cb, 2, 2);
+            cb->PushPixel(GetPixelFromLuaStack(L, 4));
+            return 0;
+        }
+
+        static int PushShapeCommand(lua_State *L, CommandBuffer::Op op, int coords) {
+            auto cb = CheckCommandBuffer(L, 1);
+            cb->Begin(op);
+            PushIntArgs(L, cb, 2, coords);
+            cb->PushPixel(GetPixelFromLuaStack(L, 2 + coords));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawLine) {
+            return PushShapeCommand(L, CommandBuffer::DRAW_LINE, 4);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawRect) {
+            return PushShapeCommand(L, CommandBuffer::DRAW_RECT, 4);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_FillRect) {
+            return PushShapeCommand(L, CommandBuffer::FILL_RECT, 4);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawCircle) {
+            return PushShapeCommand(L, CommandBuffer::DRAW_CIRCLE, 3);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_FillCircle) {
+            return PushShapeCommand(L, CommandBuffer::FILL_CIRCLE, 3);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawTriangle) {
+            return PushShapeCommand(L, CommandBuffer::DRAW_TRIANGLE, 6);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_FillTriangle) {
+            return PushShapeCommand(L, CommandBuffer::FILL_TRIANGLE, 6);
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawSprite) {
+            auto cb = CheckCommandBuffer(L, 1);
+            auto sprite = CheckSprite(L, 4);
+            RetainCommandResource(L, 4);
+
+            cb->Begin(CommandBuffer::DRAW_SPRITE);
+            PushIntArgs(L, cb, 2, 2);
+            cb->PushPointer(sprite);
+            cb->PushInt(lua_gettop(L) >= 5 ? (int32_t) lua_tointeger(L, 5) : 1);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawPartialSprite) {
+            auto cb = CheckCommandBuffer(L, 1);
+            auto sprite = CheckSprite(L, 4);
+            RetainCommandResource(L, 4);
+
+            cb->Begin(CommandBuffer::DRAW_PARTIAL_SPRITE);
+            PushIntArgs(L, cb, 2, 2);
+            cb->PushPointer(sprite);
+            PushIntArgs(L, cb, 5, 4);
+            cb->PushInt(lua_gettop(L) >= 9 ? (int32_t) lua_tointeger(L, 9) : 1);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawString) {
+            auto cb = CheckCommandBuffer(L, 1);
+            size_t length;
+            const char *text = luaL_checklstring(L, 4, &length);
+
+            cb->Begin(CommandBuffer::DRAW_STRING);
+            PushIntArgs(L, cb, 2, 2);
+            cb->PushString(std::string(text, length));
+            cb->PushPixel(GetPixelFromLuaStack(L, 5));
+            cb->PushInt(lua_gettop(L) >= 9 ? (int32_t) lua_tointeger(L, 9) : 1);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawDecal) {
+            auto cb = CheckCommandBuffer(L, 1);
+            auto decal = CheckDecal(L, 4);
+            RetainCommandResource(L, 4);
+
+            cb->Begin(CommandBuffer::DRAW_DECAL);
+            PushFloatArgs(L, cb, 2, 2);
+            cb->PushPointer(decal);
+            cb->PushFloat(1.0f);
+            cb->PushFloat(1.0f);
+            cb->PushPixel(olc::WHITE);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_DrawRotatedDecal) {
+            auto cb = CheckCommandBuffer(L, 1);
+            auto decal = CheckDecal(L, 4);
+            RetainCommandResource(L, 4);
+
+            cb->Begin(CommandBuffer::DRAW_ROTATED_DECAL);
+            PushFloatArgs(L, cb, 2, 2);
+            cb->PushPointer(decal);
+            PushFloatArgs(L, cb, 5, 5);
+            cb->PushPixel(GetPixelFromLuaStack(L, 10));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_SetPixelMode) {
+            auto cb = CheckCommandBuffer(L, 1);
+            cb->Begin(CommandBuffer::SET_PIXEL_MODE);
+            cb->PushInt((int32_t) lua_tointeger(L, 2));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_SetPixelBlend) {
+            auto cb = CheckCommandBuffer(L, 1);
+            cb->Begin(CommandBuffer::SET_PIXEL_BLEND);
+            cb->PushFloat((float) lua_tonumber(L, 2));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_Submit) {
+            OLC_PROFILE_ZONE("CommandBuffer Submit");
+            CheckCommandBuffer(L, 1)->Submit(GetApp(L));
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_Reset) {
+            CheckCommandBuffer(L, 1)->Reset();
+
+            lua_newtable(L);
+            lua_setiuservalue(L, 1, 1);
+            return 0;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_Count) {
+            lua_pushinteger(L, (lua_Integer) CheckCommandBuffer(L, 1)->Count());
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(CommandBuffer_GC) {
+            CheckCommandBuffer(L, 1)->~CommandBuffer();
+            return 0;
+        }
+
+        static const luaL_Reg CommandBufferMethods[] = {
+                {"clear",               CommandBuffer_Clear},
+                {"draw",                CommandBuffer_Draw},
+                {"draw_line",           CommandBuffer_DrawLine},
+                {"draw_rect",           CommandBuffer_DrawRect},
+                {"fill_rect",           CommandBuffer_FillRect},
+                {"draw_circle",         CommandBuffer_DrawCircle},
+                {"fill_circle",         CommandBuffer_FillCircle},
+                {"draw_triangle",       CommandBuffer_DrawTriangle},
+                {"fill_triangle",       CommandBuffer_FillTriangle},
+                {"draw_sprite",         CommandBuffer_DrawSprite},
+                {"draw_partial_sprite", CommandBuffer_DrawPartialSprite},
+                {"draw_string",         CommandBuffer_DrawString},
+                {"draw_decal",          CommandBuffer_DrawDecal},
+                {"draw_rotated_decal",  CommandBuffer_DrawRotatedDecal},
+                {"set_pixel_mode",      CommandBuffer_SetPixelMode},
+                {"set_pixel_blend",     CommandBuffer_SetPixelBlend},
+                {"submit",              CommandBuffer_Submit},
+                {"reset",               CommandBuffer_Reset},
+                {"count",               CommandBuffer_Count},
+                {"__gc",                CommandBuffer_GC},
+                {nullptr,               nullptr}};
+
+        DEFINE_LUA_FUNC(Graphics_CreateCommandBuffer) {
+            auto cb = (CommandBuffer *) lua_newuserdatauv(L, sizeof(CommandBuffer), 1);
+            new(cb) CommandBuffer();
+
+            lua_newtable(L);
+            lua_setiuservalue(L, -2, 1);
+
+            if (luaL_newmetatable(L, CommandBufferMetaName)) {
+                luaL_setfuncs(L, CommandBufferMethods, 0);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, -2, "__index");
+            }
+            lua_setmetatable(L, -2);
+
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(Graphics_CreateDecal) {
+            auto sprite = CheckSprite(L, 1);
+
+            auto decal = new olc::Decal(sprite);
+            assert(decal);
+
+            PushDecal(L, decal, 1);
+
+            return 1;
+        }
+
+        // Like unload_sprite, the texture goes once particle systems and command
+        // buffers recorded with the decal are gone as well
+        DEFINE_LUA_FUNC(Graphics_DestroyDecal) {
+            CheckDecal(L, 1);
+            ((DecalHandle *) lua_touserdata(L, 1))->released = true;
+            return 0;
+        }
+
+        static void Graphics_DrawSprite(App *app, int32_t x, int32_t y, olc::Sprite *sprite, LuaOpt<uint32_t, 1> scale) {
+            app->DrawSprite(x, y, sprite, scale);
+        }
 
-            int32_t x2 = (int32_t) lua_tonumber(L, 3);
-            int32_t y2 = (int32_t) lua_tonumber(L, 4);
+        static void Graphics_DrawPartialSprite(App *app, int32_t x, int32_t y, olc::Sprite *sprite, int32_t xOffset, int32_t yOffset,
+                                               int32_t width, int32_t height, LuaOpt<uint32_t, 1> scale) {
+            app->DrawPartialSprite(x, y, sprite, xOffset, yOffset, width, height, scale);
+        }
+
+        static void Graphics_DrawIndexedSprite(App *app, int32_t x, int32_t y, olc::IndexedSprite *sprite, LuaOpt<uint32_t, 1> scale) {
+            app->DrawIndexedSprite(x, y, sprite, scale);
+        }
 
-            int32_t x3 = (int32_t) lua_tonumber(L, 5);
-            int32_t y3 = (int32_t) lua_tonumber(L, 6);
+        static void Graphics_DrawPartialIndexedSprite(App *app, int32_t x, int32_t y, olc::IndexedSprite *sprite, int32_t xOffset, int32_t yOffset,
+                                                      int32_t width, int32_t height, LuaOpt<uint32_t, 1> scale) {
+            app->DrawPartialIndexedSprite(x, y, sprite, xOffset, yOffset, width, height, scale);
+        }
 
-            auto pixel = GetPixelFromLuaStack(L, 7);
+        // g.draw_string(x, y, text, r, g, b [, a, scale]), pass nil as alpha to only set the scale
+        static void Graphics_DrawString(App *app, int32_t x, int32_t y, const char *text, olc::Pixel p, LuaOpt<uint32_t, 1> scale) {
+            app->DrawString(x, y, text, p, scale);
+        }
 
-            instance->DrawTriangle(x1, y1, x2, y2, x3, y3, pixel);
+        static void Graphics_DrawDecal(App *app, float x, float y, olc::Decal *decal) {
+            app->DrawDecal({x, y}, decal);
+        }
 
-            return 0;
+        static void Graphics_DrawRotatedDecal(App *app, float x, float y, olc::Decal *decal, float angle,
+                                              float xCenter, float yCenter, float xScale, float yScale, olc::Pixel tint) {
+            app->DrawRotatedDecal({x, y}, decal, angle, {xCenter, yCenter}, {xScale, yScale}, tint);
+        }
+
+
+        static void Graphics_SetDecalStructure(App *app, olc::DecalStructure structure) {
+            app->SetDecalStructure(structure);
         }
 
-        DEFINE_LUA_FUNC(Graphics_FillTriangle) {
-            // TODO: Check arguments count
+        // Reads either an rgba buffer (one tint per element) or r, g, b [, a] at idx
+        static const olc::Pixel *GetTintFromLuaStack(lua_State *L, int idx, size_t count, olc::Pixel &single, uint32_t &stride) {
+            if (lua_isuserdata(L, idx)) {
+                auto tint = CheckBuffer(L, idx, Buffer::RGBA);
+                luaL_argcheck(L, tint->length >= count, idx, "tint buffer too short");
+                stride = 1;
+                return tint->As<olc::Pixel>();
+            }
 
-            int32_t x1 = (int32_t) lua_tonumber(L, 1);
-            int32_t y1 = (int32_t) lua_tonumber(L, 2);
+            single = lua_gettop(L) >= idx ? GetPixelFromLuaStack(L, idx) : olc::WHITE;
+            stride = 0;
+            return &single;
+        }
 
-            int32_t x2 = (int32_t) lua_tonumber(L, 3);
-            int32_t y2 = (int32_t) lua_tonumber(L, 4);
+        // g.draw_polygon_decal(decal, pos, uv [, tint]), pos and uv are f32 buffers of x, y pairs
+        DEFINE_LUA_FUNC(Graphics_DrawPolygonDecal) {
+            App *app = GetApp(L);
+            auto decal = CheckDecal(L, 1);
 
-            int32_t x3 = (int32_t) lua_tonumber(L, 5);
-            int32_t y3 = (int32_t) lua_tonumber(L, 6);
+            auto pos = CheckBuffer(L, 2, Buffer::F32);
+            auto uv = CheckBuffer(L, 3, Buffer::F32);
 
-            auto pixel = GetPixelFromLuaStack(L, 7);
+            size_t points = pos->length / 2;
+            luaL_argcheck(L, uv->length >= points * 2, 3, "uv buffer too short");
 
-            instance->FillTriangle(x1, y1, x2, y2, x3, y3, pixel);
+            olc::Pixel single;
+            uint32_t stride;
+            const olc::Pixel *tint = GetTintFromLuaStack(L, 4, points, single, stride);
 
+            app->DrawPolygonDecal(decal, pos->As<olc::vf2d>(), uv->As<olc::vf2d>(), tint, uint32_t(points), stride);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_LoadSprite) {
-            auto path = lua_tostring(L, 1);
+        // g.draw_decal_instances(decal, transforms [, tint]), transforms is an f32 buffer
+        // of x, y, angle, scale per instance, all instances go out as one triangle list
+        DEFINE_LUA_FUNC(Graphics_DrawDecalInstances) {
+            App *app = GetApp(L);
+            OLC_PROFILE_ZONE("Decal Instances");
+            auto decal = CheckDecal(L, 1);
+
+            auto transforms = CheckBuffer(L, 2, Buffer::F32);
+            size_t count = transforms->length / 4;
+
+            olc::Pixel single;
+            uint32_t stride;
+            const olc::Pixel *tint = GetTintFromLuaStack(L, 3, count, single, stride);
+
+            // scratch per thread, engines on other threads draw at the same time
+            static thread_local std::vector<olc::vf2d> pos, uv;
+            static thread_local std::vector<olc::Pixel> tints;
+            pos.resize(count * 6);
+            uv.resize(count * 6);
+            tints.resize(count * 6);
+
+            const float hw = float(decal->sprite->width) * 0.5f;
+            const float hh = float(decal->sprite->height) * 0.5f;
+            static const olc::vf2d corners[6] = {{-1, -1}, {-1, 1}, {1, 1}, {-1, -1}, {1, 1}, {1, -1}};
+            static const olc::vf2d uvs[6] = {{0, 0}, {0, 1}, {1, 1}, {0, 0}, {1, 1}, {1, 0}};
+
+            const float *t = transforms->As<float>();
+            for (size_t i = 0; i < count; i++, t += 4) {
+                const float c = std::cos(t[2]) * t[3], s = std::sin(t[2]) * t[3];
+                for (int k = 0; k < 6; k++) {
+                    const float x = corners[k].x * hw, y = corners[k].y * hh;
+                    pos[i * 6 + k] = {t[0] + x * c - y * s, t[1] + x * s + y * c};
+                    uv[i * 6 + k] = uvs[k];
+                    tints[i * 6 + k] = tint[i * stride];
+                }
+            }
 
-            auto sprite = new olc::Sprite(std::string(path));
-            assert(sprite);
+            olc::DecalStructure structure = app->GetDecalStructure();
+            app->SetDecalStructure(olc::DecalStructure::LIST);
+            app->DrawPolygonDecal(decal, pos.data(), uv.data(), tints.data(), uint32_t(count * 6));
+            app->SetDecalStructure(structure);
+            return 0;
+        }
 
-            lua_pushlightuserdata(L, sprite);
-            return 1;
+        static void Graphics_SetPixelBlend(App *app, float blend) {
+            app->SetPixelBlend(blend);
         }
 
-        DEFINE_LUA_FUNC(Graphics_UnloadSprite) {
-            auto sprite = (olc::Sprite *) lua_topointer(L, 1);
-            assert(sprite);
-            delete sprite;
+        static void Graphics_SetPixelMode(App *app, olc::Pixel::Mode mode) {
+            app->SetPixelMode(mode);
+        }
+
+        static olc::Pixel::Mode Graphics_GetPixelMode(App *app) {
+            return app->GetPixelMode();
+        }
+
+        static const luaL_Reg GraphicsFunctions[] = {
+                {"set_draw_target",        Graphics_SetDrawTarget},
+                {"get_draw_target_width",  LuaBind<Graphics_GetDrawTargetWidth>},
+                {"get_draw_target_height", LuaBind<Graphics_GetDrawTargetHeight>},
+                {"get_draw_target",        Graphics_GetDrawTarget},
+
+                {"set_pixel_blend",        LuaBind<Graphics_SetPixelBlend>},
+                {"set_pixel_mode",         LuaBind<Graphics_SetPixelMode>},
+                {"get_pixel_mode",         LuaBind<Graphics_GetPixelMode>},
+
+                {"clear",                  LuaBind<Graphics_Clear>},
+
+                {"draw",                   LuaBind<Graphics_Draw>},
+                {"draw_line",              LuaBind<Graphics_DrawLine>},
+                {"draw_circle",            LuaBind<Graphics_DrawCircle>},
+                {"fill_circle",            LuaBind<Graphics_FillCircle>},
+                {"draw_rect",              LuaBind<Graphics_DrawRect>},
+                {"fill_rect",              LuaBind<Graphics_FillRect>},
+                {"draw_triangle",          LuaBind<Graphics_DrawTriangle>},
+                {"fill_triangle",          LuaBind<Graphics_FillTriangle>},
+
+                {"load_sprite",            Graphics_LoadSprite},
+                {"load_sprites",           Graphics_LoadSprites},
+                {"create_sprite",          Graphics_CreateSprite},
+                {"unload_sprite",          Graphics_UnloadSprite},
+                {"enable_span_cache",      LuaBind<Sprite_EnableSpanCache>},
+                {"load_indexed_sprite",    Graphics_LoadIndexedSprite},
+                {"unload_indexed_sprite",  Graphics_UnloadIndexedSprite},
+                {"set_palette_color",      LuaBind<IndexedSprite_SetPaletteColor>},
+                {"get_palette_color",      LuaBind<IndexedSprite_GetPaletteColor>},
+                {"get_palette_size",       LuaBind<IndexedSprite_GetPaletteSize>},
+                {"create_tilemap",         Graphics_CreateTileMap},
+                {"create_command_buffer",  Graphics_CreateCommandBuffer},
+                {"create_decal",           Graphics_CreateDecal},
+                {"destroy_decal",          Graphics_DestroyDecal},
+
+                {"draw_sprite",            LuaBind<Graphics_DrawSprite>},
+                {"draw_partial_sprite",    LuaBind<Graphics_DrawPartialSprite>},
+                {"draw_indexed_sprite",    LuaBind<Graphics_DrawIndexedSprite>},
+                {"draw_partial_indexed_sprite", LuaBind<Graphics_DrawPartialIndexedSprite>},
+                {"draw_decal",             LuaBind<Graphics_DrawDecal>},
+                {"draw_rotated_decal",     LuaBind<Graphics_DrawRotatedDecal>},
+                {"draw_polygon_decal",     Graphics_DrawPolygonDecal},
+                {"draw_decal_instances",   Graphics_DrawDecalInstances},
+                {"update_decal",           LuaBind<Decal_Update>},
+                {"set_decal_structure",    LuaBind<Graphics_SetDecalStructure>},
+
+                {"draw_string",            LuaBind<Graphics_DrawString>},
+
+                {NULL, NULL}};
+
+        static const LuaConstant PixelModeConstants[] = {
+                {"Normal",        olc::Pixel::NORMAL},
+                {"Mask",          olc::Pixel::MASK},
+                {"Alpha",         olc::Pixel::ALPHA},
+                {"Custom",        olc::Pixel::CUSTOM},
+                {"Premultiplied", olc::Pixel::PREMULTIPLIED}};
+
+        static const LuaConstant DecalStructureConstants[] = {
+                {"Line",  (lua_Integer) olc::DecalStructure::LINE},
+                {"Fan",   (lua_Integer) olc::DecalStructure::FAN},
+                {"Strip", (lua_Integer) olc::DecalStructure::STRIP},
+                {"List",  (lua_Integer) olc::DecalStructure::LIST}};
+
+        static int GraphicsRegisterFunctions(lua_State *L) {
+            RegisterHandleMetatables(L);
+            RegisterLuaModule(L, "graphics", GraphicsFunctions);
+            RegisterLuaConstants(L, "graphics", "PixelMode", PixelModeConstants);
+            RegisterLuaConstants(L, "graphics", "DecalStructure", DecalStructureConstants);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_CreateDecal) {
-            auto sprite = (olc::Sprite *) lua_topointer(L, 1);
-            assert(sprite);
+        ///////////////////////////////////////////////
+        // Input
+        ///////////////////////////////////////////////
 
-            auto decal = new olc::Decal(sprite);
-            assert(decal);
+        static bool Input_IsKeyPressed(App *app, olc::Key key) {
+            return app->GetKey(key).bPressed;
+        }
 
-            lua_pushlightuserdata(L, decal);
+        static bool Input_IsKeyHeld(App *app, olc::Key key) {
+            return app->GetKey(key).bHeld;
+        }
 
-            return 1;
+        static bool Input_IsKeyReleased(App *app, olc::Key key) {
+            return app->GetKey(key).bReleased;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DestroyDecal) {
-            auto decal = (olc::Decal *) lua_topointer(L, 1);
-            assert(decal);
-            delete decal;
-            return 0;
+        static bool Input_IsMousePressed(App *app, uint32_t button) {
+            return app->GetMouse(button).bPressed;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawSprite) {
-            // TODO: Check arguments count
+        static bool Input_IsMouseHeld(App *app, uint32_t button) {
+            return app->GetMouse(button).bHeld;
+        }
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+        static bool Input_IsMouseReleased(App *app, uint32_t button) {
+            return app->GetMouse(button).bReleased;
+        }
 
-            auto sprite = (olc::Sprite *) lua_topointer(L, 3);
-            assert(sprite);
+        static int32_t Input_GetMouseX(App *app) {
+            return app->GetMouseX();
+        }
 
-            uint32_t scale = 1;
-            if (lua_gettop(L) >= 4)
-                scale = (uint32_t) lua_tointeger(L, 4);
+        static int32_t Input_GetMouseY(App *app) {
+            return app->GetMouseY();
+        }
+
+        static int32_t Input_GetMouseWheel(App *app) {
+            return app->GetMouseWheel();
+        }
+
+        static const luaL_Reg InputFunctions[] = {
+                {"is_key_pressed",    LuaBind<Input_IsKeyPressed>},
+                {"is_key_held",       LuaBind<Input_IsKeyHeld>},
+                {"is_key_released",   LuaBind<Input_IsKeyReleased>},
+                {"is_mouse_pressed",  LuaBind<Input_IsMousePressed>},
+                {"is_mouse_held",     LuaBind<Input_IsMouseHeld>},
+                {"is_mouse_released", LuaBind<Input_IsMouseReleased>},
+                {"mouse_x",           LuaBind<Input_GetMouseX>},
+                {"mouse_y",           LuaBind<Input_GetMouseY>},
+                {"mouse_wheel",       LuaBind<Input_GetMouseWheel>},
+                {NULL, NULL}};
 
-            instance->DrawSprite(x, y, sprite, scale);
+        static const LuaConstant KeyConstants[] = {
+                {"A", olc::Key::A},
+                {"B", olc::Key::B},
+                {"C", olc::Key::C},
+                {"D", olc::Key::D},
+                {"E", olc::Key::E},
+                {"F", olc::Key::F},
+                {"G", olc::Key::G},
+                {"H", olc::Key::H},
+                {"I", olc::Key::I},
+                {"J", olc::Key::J},
+                {"K", olc::Key::K},
+                {"L", olc::Key::L},
+                {"M", olc::Key::M},
+                {"N", olc::Key::N},
+                {"O", olc::Key::O},
+                {"P", olc::Key::P},
+                {"Q", olc::Key::Q},
+                {"R", olc::Key::R},
+                {"S", olc::Key::S},
+                {"T", olc::Key::T},
+                {"U", olc::Key::U},
+                {"V", olc::Key::V},
+                {"W", olc::Key::W},
+                {"X", olc::Key::X},
+                {"Y", olc::Key::Y},
+                {"Z", olc::Key::Z},
+
+                {"K0", olc::Key::K0},
+                {"K1", olc::Key::K1},
+                {"K2", olc::Key::K2},
+                {"K3", olc::Key::K3},
+                {"K4", olc::Key::K4},
+                {"K5", olc::Key::K5},
+                {"K6", olc::Key::K6},
+                {"K7", olc::Key::K7},
+                {"K8", olc::Key::K8},
+                {"K9", olc::Key::K9},
+
+                {"F1", olc::Key::F1},
+                {"F2", olc::Key::F2},
+                {"F3", olc::Key::F3},
+                {"F4", olc::Key::F4},
+                {"F5", olc::Key::F5},
+                {"F6", olc::Key::F6},
+                {"F7", olc::Key::F7},
+                {"F8", olc::Key::F8},
+                {"F9", olc::Key::F9},
+                {"F10", olc::Key::F10},
+                {"F11", olc::Key::F11},
+                {"F12", olc::Key::F12},
+
+                {"UP", olc::Key::UP},
+                {"DOWN", olc::Key::DOWN},
+                {"LEFT", olc::Key::LEFT},
+                {"RIGHT", olc::Key::RIGHT}};
 
+        static int InputRegisterFunctions(lua_State *L) {
+            RegisterLuaModule(L, "input", InputFunctions);
+            RegisterLuaConstants(L, "input", "Key", KeyConstants);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawPartialSprite) {
-            // TODO: Check arguments count
+        ///////////////////////////////////////////////
+        // Particles
+        ///////////////////////////////////////////////
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+        static const char *ParticleSystemMetaName = "PGE.ParticleSystem";
+        static const char *ParticleEmitterMetaName = "PGE.ParticleEmitter";
 
-            auto sprite = (olc::Sprite *) lua_topointer(L, 3);
-            assert(sprite);
+        static ParticleSystem *CheckParticleSystem(lua_State *L, int idx) {
+            return (ParticleSystem *) luaL_checkudata(L, idx, ParticleSystemMetaName);
+        }
+
+        static ParticleEmitter *CheckParticleEmitter(lua_State *L, int idx) {
+            return (ParticleEmitter *) luaL_checkudata(L, idx, ParticleEmitterMetaName);
+        }
+
+        // Reads field `name` of the table at idx as either a number or a {min, max} pair
+        static void GetRangeField(lua_State *L, int idx, const char *name, float &min, float &max) {
+            int type = lua_getfield(L, idx, name);
+            if (type == LUA_TNUMBER) {
+                min = max = (float) lua_tonumber(L, -1);
+            } else if (type == LUA_TTABLE) {
+                lua_rawgeti(L, -1, 1);
+                lua_rawgeti(L, -2, 2);
+                min = (float) lua_tonumber(L, -2);
+                max = (float) lua_tonumber(L, -1);
+                lua_pop(L, 2);
+            }
+            lua_pop(L, 1);
+        }
+
+        DEFINE_LUA_FUNC(Particles_CreateEmitter) {
+            luaL_checktype(L, 1, LUA_TTABLE);
+
+            ParticleEmitter emitter;
 
-            int32_t xOffset = (int32_t) lua_tonumber(L, 4);
-            int32_t yOffset = (int32_t) lua_tonumber(L, 5);
+            if (lua_getfield(L, 1, "count") == LUA_TNUMBER) {
+                lua_Integer count = lua_tointeger(L, -1);
+                luaL_argcheck(L, count >= 0 && count <= INT32_MAX, 1, "count must be between 0 and 2^31 - 1");
+                emitter.count = (int32_t) count;
+            }
+            lua_pop(L, 1);
+
+            if (lua_getfield(L, 1, "scale") == LUA_TNUMBER)
+                emitter.scale = (float) lua_tonumber(L, -1);
+            lua_pop(L, 1);
+
+            if (lua_getfield(L, 1, "align") != LUA_TNIL)
+                emitter.alignToDirection = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+
+            GetRangeField(L, 1, "speed", emitter.speedMin, emitter.speedMax);
+            GetRangeField(L, 1, "direction", emitter.directionMin, emitter.directionMax);
+            GetRangeField(L, 1, "spin", emitter.spinMin, emitter.spinMax);
+            GetRangeField(L, 1, "life", emitter.lifeMin, emitter.lifeMax);
+
+            if (lua_getfield(L, 1, "color") == LUA_TTABLE) {
+                int top = lua_gettop(L);
+                for (int i = 1; i <= 4; i++)
+                    lua_rawgeti(L, top, i);
+                if (lua_isnil(L, -1))
+                    lua_pop(L, 1);
+                emitter.color = GetPixelFromLuaStack(L, top + 1);
+                lua_settop(L, top);
+            }
+            lua_pop(L, 1);
+
+            auto ud = (ParticleEmitter *) lua_newuserdatauv(L, sizeof(ParticleEmitter), 0);
+            *ud = emitter;
+
+            luaL_newmetatable(L, ParticleEmitterMetaName);
+            lua_setmetatable(L, -2);
+
+            return 1;
+        }
+
+        DEFINE_LUA_FUNC(ParticleSystem_Emit) {
+            auto system = CheckParticleSystem(L, 1);
+            auto emitter = CheckParticleEmitter(L, 2);
 
-            int32_t width = (int32_t) lua_tonumber(L, 6);
-            int32_t height = (int32_t) lua_tonumber(L, 7);
+            auto x = (float) lua_tonumber(L, 3);
+            auto y = (float) lua_tonumber(L, 4);
 
-            uint32_t scale = 1;
-            if (lua_gettop(L) >= 8)
-                scale = (uint32_t) lua_tointeger(L, 8);
+            int32_t count = -1;
+            if (lua_gettop(L) >= 5) {
+                lua_Integer n = lua_tointeger(L, 5);
+                luaL_argcheck(L, n >= 0 && n <= INT32_MAX, 5, "count must be between 0 and 2^31 - 1");
+                count = (int32_t) n;
+            }
 
-            instance->DrawPartialSprite(x, y, sprite, xOffset, yOffset, width, height, scale);
+            system->Emit(*emitter, x, y, count);
+            return 0;
+        }
 
+        DEFINE_LUA_FUNC(ParticleSystem_Update) {
+            OLC_PROFILE_ZONE("Particles Update");
+            CheckParticleSystem(L, 1)->Update((float) lua_tonumber(L, 2), &GetApp(L)->GetJobs());
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawString) {
-            // TODO: Check arguments count
+        DEFINE_LUA_FUNC(ParticleSystem_Draw) {
+            OLC_PROFILE_ZONE("Particles Draw");
+            auto system = CheckParticleSystem(L, 1);
+
+            float x = 0.0f, y = 0.0f, scale = 1.0f;
+            if (lua_gettop(L) >= 3) {
+                x = (float) lua_tonumber(L, 2);
+                y = (float) lua_tonumber(L, 3);
+            }
+            if (lua_gettop(L) >= 4)
+                scale = (float) lua_tonumber(L, 4);
 
-            int32_t x = (int32_t) lua_tonumber(L, 1);
-            int32_t y = (int32_t) lua_tonumber(L, 2);
+            system->Draw(GetApp(L), x, y, scale, &GetApp(L)->GetJobs());
+            return 0;
+        }
 
-            auto text = std::string(lua_tostring(L, 3));
-            auto pixel = GetPixelFromLuaStack(L, 4);
+        DEFINE_LUA_FUNC(ParticleSystem_SetGravity) {
+            auto system = CheckParticleSystem(L, 1);
+            system->SetGravity((float) lua_tonumber(L, 2), (float) lua_tonumber(L, 3));
+            return 0;
+        }
 
-            uint32_t scale = 1;
-            if (lua_gettop(L) >= 5)
-                scale = (uint32_t) lua_tointeger(L, 5);
+        DEFINE_LUA_FUNC(ParticleSystem_Count) {
+            lua_pushinteger(L, (lua_Integer) CheckParticleSystem(L, 1)->Count());
+            return 1;
+        }
 
-            instance->DrawString(x, y, text, pixel, scale);
+        DEFINE_LUA_FUNC(ParticleSystem_Clear) {
+            CheckParticleSystem(L, 1)->Clear();
+            return 0;
+        }
 
+        DEFINE_LUA_FUNC(ParticleSystem_GC) {
+            CheckParticleSystem(L, 1)->~ParticleSystem();
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawDecal) {
-            // TODO: Check arguments count
+        static const luaL_Reg ParticleSystemMethods[] = {
+                {"emit",        ParticleSystem_Emit},
+                {"update",      ParticleSystem_Update},
+                {"draw",        ParticleSystem_Draw},
+                {"set_gravity", ParticleSystem_SetGravity},
+                {"count",       ParticleSystem_Count},
+                {"clear",       ParticleSystem_Clear},
+                {"__gc",        ParticleSystem_GC},
+                {nullptr,       nullptr}};
 
-            float x = (float) lua_tonumber(L, 1);
-            float y = (float) lua_tonumber(L, 2);
+        // largest particle count one system may hold, about 700 MB of particle state
+        static constexpr lua_Integer MaxParticleCapacity = 1 << 24;
 
-            auto decal = (olc::Decal *) lua_topointer(L, 3);
-            assert(decal);
+        DEFINE_LUA_FUNC(Particles_Create) {
+            auto decal = CheckDecal(L, 1);
 
-            instance->DrawDecal({x, y}, decal);
+            lua_Integer capacity = luaL_optinteger(L, 2, 100000);
+            luaL_argcheck(L, capacity >= 0 && capacity <= MaxParticleCapacity, 2, "capacity must be between 0 and 2^24");
 
-            return 0;
+            auto system = (ParticleSystem *) lua_newuserdatauv(L, sizeof(ParticleSystem), 1);
+            new(system) ParticleSystem(decal, size_t(capacity));
+
+            // the decal is borrowed, the system keeps it alive
+            RetainInUserValue(L, -1, 1);
+
+            if (luaL_newmetatable(L, ParticleSystemMetaName)) {
+                luaL_setfuncs(L, ParticleSystemMethods, 0);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, -2, "__index");
+            }
+            lua_setmetatable(L, -2);
+
+            return 1;
+        }
+
+        static const luaL_Reg ParticlesFunctions[] = {
+                {"create",  Particles_Create},
+                {"emitter", Particles_CreateEmitter},
+                {nullptr,   nullptr}};
+
+        static int ParticlesRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "particles", ParticlesFunctions);
         }
 
-        DEFINE_LUA_FUNC(Graphics_DrawRotatedDecal) {
-            // TODO: Check arguments count
+        ///////////////////////////////////////////////
+        // Memory
+        ///////////////////////////////////////////////
+
+        DEFINE_LUA_FUNC(Memory_BytesInUse) {
+            lua_pushinteger(L, (lua_Integer) GetApp(L)->GetLuaAllocator().GetBytesInUse());
+            return 1;
+        }
+
+        // Returns {bytes, chunk_bytes, large = {...}, classes = {{size, in_use, peak, allocs, frees, chunks}, ...}}
+        DEFINE_LUA_FUNC(Memory_Stats) {
+            const LuaAllocator &allocator = GetApp(L)->GetLuaAllocator();
+
+            lua_createtable(L, 0, 4);
+
+            lua_pushinteger(L, (lua_Integer) allocator.GetBytesInUse());
+            lua_setfield(L, -2, "bytes");
+
+            lua_pushinteger(L, (lua_Integer) allocator.GetChunkBytes());
+            lua_setfield(L, -2, "chunk_bytes");
+
+            const auto &large = allocator.GetLargeStats();
+            lua_createtable(L, 0, 4);
+            lua_pushinteger(L, (lua_Integer) large.bytes);
+            lua_setfield(L, -2, "bytes");
+            lua_pushinteger(L, (lua_Integer) large.peakBytes);
+            lua_setfield(L, -2, "peak_bytes");
+            lua_pushinteger(L, (lua_Integer) large.allocs);
+            lua_setfield(L, -2, "allocs");
+            lua_pushinteger(L, (lua_Integer) large.frees);
+            lua_setfield(L, -2, "frees");
+            lua_setfield(L, -2, "large");
+
+            lua_createtable(L, LuaAllocator::ClassCount, 0);
+            for (size_t i = 0; i < LuaAllocator::ClassCount; i++) {
+                const auto &c = allocator.GetClassStats(i);
+                lua_createtable(L, 0, 6);
+                lua_pushinteger(L, (lua_Integer) c.size);
+                lua_setfield(L, -2, "size");
+                lua_pushinteger(L, (lua_Integer) c.inUse);
+                lua_setfield(L, -2, "in_use");
+                lua_pushinteger(L, (lua_Integer) c.peak);
+                lua_setfield(L, -2, "peak");
+                lua_pushinteger(L, (lua_Integer) c.allocs);
+                lua_setfield(L, -2, "allocs");
+                lua_pushinteger(L, (lua_Integer) c.frees);
+                lua_setfield(L, -2, "frees");
+                lua_pushinteger(L, (lua_Integer) c.chunks);
+                lua_setfield(L, -2, "chunks");
+                lua_rawseti(L, -2, (lua_Integer) i + 1);
+            }
+            lua_setfield(L, -2, "classes");
 
-            float x = (float) lua_tonumber(L, 1);
-            float y = (float) lua_tonumber(L, 2);
+            return 1;
+        }
 
-            auto decal = (olc::Decal *) lua_topointer(L, 3);
-            // assert(decal);
+        static const luaL_Reg MemoryFunctions[] = {
+                {"bytes_in_use", Memory_BytesInUse},
+                {"stats",        Memory_Stats},
+                {nullptr,        nullptr}};
 
-            float angle = (float) lua_tonumber(L, 4);
+        static int MemoryRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "memory", MemoryFunctions);
+        }
 
-            float xCenter = (float) lua_tonumber(L, 5);
-            float yCenter = (float) lua_tonumber(L, 6);
+        ///////////////////////////////////////////////
+        // GC
+        ///////////////////////////////////////////////
 
-            float xScale = (float) lua_tonumber(L, 7);
-            float yScale = (float) lua_tonumber(L, 8);
+        // Returns the collector work done after the last update
+        DEFINE_LUA_FUNC(Gc_Stats) {
+            const GcFrameStats &stats = GetApp(L)->GetGcFrameStats();
+
+            lua_createtable(L, 0, 6);
+            lua_pushnumber(L, stats.timeMs);
+            lua_setfield(L, -2, "time_ms");
+            lua_pushinteger(L, stats.steps);
+            lua_setfield(L, -2, "steps");
+            lua_pushinteger(L, stats.heapKB);
+            lua_setfield(L, -2, "heap_kb");
+            lua_pushinteger(L, stats.externalKB);
+            lua_setfield(L, -2, "external_kb");
+            lua_pushinteger(L, stats.cycles);
+            lua_setfield(L, -2, "cycles");
+            lua_pushboolean(L, stats.fullCollect);
+            lua_setfield(L, -2, "full_collect");
 
-            auto tint = GetPixelFromLuaStack(L, 9);
+            return 1;
+        }
 
-            instance->DrawRotatedDecal({x, y}, decal, angle, {xCenter, yCenter}, {xScale, yScale}, tint);
+        DEFINE_LUA_FUNC(Gc_SetMode) {
+            App *app = GetApp(L);
+            auto mode = luaL_checkstring(L, 1);
+            if (strcmp(mode, "incremental") != 0 && strcmp(mode, "generational") != 0 && strcmp(mode, "auto") != 0)
+                return luaL_argerror(L, 1, "expected 'incremental', 'generational' or 'auto'");
 
+            app->GetGcSettings().mode = mode;
+            app->ApplyGcSettings();
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_SetPixelBlend) {
-            float blend = (float) lua_tonumber(L, 1);
-            instance->SetPixelBlend(blend);
-
+        DEFINE_LUA_FUNC(Gc_SetFrameBudget) {
+            GetApp(L)->GetGcSettings().frameBudgetMs = luaL_checknumber(L, 1);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_SetPixelMode) {
-            olc::Pixel::Mode mode = (olc::Pixel::Mode) lua_tointeger(L, 1);
-            instance->SetPixelMode(mode);
+        static const luaL_Reg GcFunctions[] = {
+                {"stats",            Gc_Stats},
+                {"set_mode",         Gc_SetMode},
+                {"set_frame_budget", Gc_SetFrameBudget},
+                {nullptr,            nullptr}};
+
+        static int GcRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "gc", GcFunctions);
+        }
+
+        ///////////////////////////////////////////////
+        // Profiler
+        ///////////////////////////////////////////////
+
+        // PGE.profiler.start([{interval = n, bindings = bool}]), missing fields come from the config
+        DEFINE_LUA_FUNC(Profiler_Start) {
+            App *app = GetApp(L);
+            LuaProfiler::Options options = app->GetProfilerSettings().options;
+            if (lua_istable(L, 1)) {
+                if (lua_getfield(L, 1, "interval") == LUA_TNUMBER)
+                    options.interval = (int) lua_tointeger(L, -1);
+                if (lua_getfield(L, 1, "bindings") == LUA_TBOOLEAN)
+                    options.bindings = lua_toboolean(L, -1);
+                lua_pop(L, 2);
+            }
 
+            app->StartProfiler(options);
             return 0;
         }
 
-        DEFINE_LUA_FUNC(Graphics_GetPixelMode) {
-            auto mode = instance->GetPixelMode();
+        static void Profiler_Stop(App *app) {
+            app->GetProfiler().Stop(app->GetLuaState());
+        }
 
-            lua_pushinteger(L, (lua_Integer) mode);
+        // Stopping through toggle saves the profile like the config key does
+        static bool Profiler_Toggle(App *app) {
+            return app->ToggleProfiler();
+        }
 
-            return 1;
+        static bool Profiler_IsRunning(App *app) {
+            return app->GetProfiler().IsRunning();
         }
 
-        static const luaL_Reg GraphicsFunctions[] = {
-                {"set_draw_target",        Graphics_SetDrawTarget},
-                {"get_draw_target_width",  Graphics_GetDrawTargetWidth},
-                {"get_draw_target_height", Graphics_GetDrawTargetHeight},
-                {"get_draw_target",        Graphics_GetDrawTarget},
+        static void Profiler_Reset(App *app) {
+            app->GetProfiler().Reset();
+        }
 
-                {"set_pixel_blend",        Graphics_SetPixelBlend},
-                {"set_pixel_mode",         Graphics_SetPixelMode},
-                {"get_pixel_mode",         Graphics_GetPixelMode},
+        // PGE.profiler.save([prefix]) writes <prefix>.folded and <prefix>.txt
+        DEFINE_LUA_FUNC(Profiler_Save) {
+            App *app = GetApp(L);
+            std::string prefix = luaL_optstring(L, 1, app->GetProfilerSettings().output.c_str());
+            lua_pushboolean(L, app->SaveProfile(prefix));
+            return 1;
+        }
 
-                {"clear",                  Graphics_Clear},
+        // Returns {profiled_ms, overhead_ms, events, {name, calls, samples, self_ms, total_ms}, ...}
+        // sorted by self time, at most `max` rows
+        DEFINE_LUA_FUNC(Profiler_Report) {
+            const LuaProfiler &profiler = GetApp(L)->GetProfiler();
+            auto stats = profiler.GetFunctionStats();
+            size_t rows = std::min(stats.size(), (size_t) luaL_optinteger(L, 1, (lua_Integer) stats.size()));
+
+            lua_createtable(L, (int) rows, 3);
+            lua_pushnumber(L, profiler.GetProfiledMs());
+            lua_setfield(L, -2, "profiled_ms");
+            lua_pushnumber(L, profiler.GetOverheadMs());
+            lua_setfield(L, -2, "overhead_ms");
+            lua_pushinteger(L, (lua_Integer) profiler.GetEvents());
+            lua_setfield(L, -2, "events");
+
+            for (size_t i = 0; i < rows; i++) {
+                const auto &s = stats[i];
+                lua_createtable(L, 0, 5);
+                lua_pushstring(L, s.name.c_str());
+                lua_setfield(L, -2, "name");
+                lua_pushinteger(L, (lua_Integer) s.calls);
+                lua_setfield(L, -2, "calls");
+                lua_pushinteger(L, (lua_Integer) s.samples);
+                lua_setfield(L, -2, "samples");
+                lua_pushnumber(L, s.selfMs);
+                lua_setfield(L, -2, "self_ms");
+                lua_pushnumber(L, s.totalMs);
+                lua_setfield(L, -2, "total_ms");
+                lua_rawseti(L, -2, (lua_Integer) i + 1);
+            }
 
-                {"draw",                   Graphics_Draw},
-                {"draw_line",              Graphics_DrawLine},
-                {"draw_circle",            Graphics_DrawCircle},
-                {"fill_circle",            Graphics_FillCircle},
-                {"draw_rect",              Graphics_DrawRect},
-                {"fill_rect",              Graphics_FillRect},
-                {"draw_triangle",          Graphics_DrawTriangle},
-                {"fill_triangle",          Graphics_FillTriangle},
+            return 1;
+        }
 
-                {"load_sprite",            Graphics_LoadSprite},
-                {"unload_sprite",          Graphics_UnloadSprite},
-                {"create_decal",           Graphics_CreateDecal},
-                {"destroy_decal",          Graphics_DestroyDecal},
+        // Engine timing zones, averaged over the last olc::profile::WindowFrames frames.
+        // Returns {{name, avg_ms, max_ms, calls}, ...} slowest first, empty unless
+        // built with PGE_PROFILE_ZONES
+        DEFINE_LUA_FUNC(Profiler_Zones) {
+            auto zones = olc::profile::GetZoneStats();
+
+            lua_createtable(L, (int) zones.size(), 0);
+            for (size_t i = 0; i < zones.size(); i++) {
+                const auto &z = zones[i];
+                lua_createtable(L, 0, 4);
+                lua_pushstring(L, z.name);
+                lua_setfield(L, -2, "name");
+                lua_pushnumber(L, z.avgMs);
+                lua_setfield(L, -2, "avg_ms");
+                lua_pushnumber(L, z.maxMs);
+                lua_setfield(L, -2, "max_ms");
+                lua_pushnumber(L, z.callsPerFrame);
+                lua_setfield(L, -2, "calls");
+                lua_rawseti(L, -2, (lua_Integer) i + 1);
+            }
 
-                {"draw_sprite",            Graphics_DrawSprite},
-                {"draw_partial_sprite",    Graphics_DrawPartialSprite},
-                {"draw_decal",             Graphics_DrawDecal},
-                {"draw_rotated_decal",     Graphics_DrawRotatedDecal},
+            return 1;
+        }
 
-                {"draw_string",            Graphics_DrawString},
+        static bool Profiler_ZonesEnabled() {
+            return olc::profile::Enabled;
+        }
 
-                {NULL, NULL}};
+        static bool Profiler_SaveTrace(std::string path) {
+            return olc::profile::Enabled && olc::profile::WriteChromeTrace(path);
+        }
 
-        static int GraphicsRegisterFunctions(lua_State *L) {
-            return RegisterLuaModule(L, "graphics", GraphicsFunctions);
+        static const luaL_Reg ProfilerFunctions[] = {
+                {"start",         Profiler_Start},
+                {"stop",          LuaBind<Profiler_Stop>},
+                {"toggle",        LuaBind<Profiler_Toggle>},
+                {"is_running",    LuaBind<Profiler_IsRunning>},
+                {"reset",         LuaBind<Profiler_Reset>},
+                {"save",          Profiler_Save},
+                {"report",        Profiler_Report},
+                {"zones",         Profiler_Zones},
+                {"zones_enabled", LuaBind<Profiler_ZonesEnabled>},
+                {"save_trace",    LuaBind<Profiler_SaveTrace>},
+                {nullptr,          nullptr}};
+
+        static int ProfilerRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "profiler", ProfilerFunctions);
         }
 
         ///////////////////////////////////////////////
-        // Input
+        // Flight recorder
         ///////////////////////////////////////////////
 
-        DEFINE_LUA_FUNC(Input_IsKeyPressed) {
-            olc::Key keycode = (olc::Key) lua_tointeger(L, 1);
-            bool pressed = instance->GetKey(keycode).bPressed;
-            lua_pushboolean(L, pressed);
+        // PGE.flight.dump([path]) writes the recorded frames now, returns the path or nil
+        DEFINE_LUA_FUNC(Flight_Dump) {
+            App *app = GetApp(L);
+            auto &settings = app->GetFlightRecorderSettings();
+            std::string path = luaL_optstring(L, 1, (settings.output + "_manual.pgefr").c_str());
+
+            if (!app->DumpFlightRecorder(path))
+                return 0;
+            lua_pushstring(L, path.c_str());
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_IsKeyHeld) {
-            olc::Key keycode = (olc::Key) lua_tointeger(L, 1);
-            bool held = instance->GetKey(keycode).bHeld;
-            lua_pushboolean(L, held);
-            return 1;
+        static void Flight_SetBudget(App *app, double ms) {
+            app->GetFlightRecorderSettings().budgetMs = ms;
         }
 
-        DEFINE_LUA_FUNC(Input_IsKeyReleased) {
-            olc::Key keycode = (olc::Key) lua_tointeger(L, 1);
-            bool released = instance->GetKey(keycode).bReleased;
-            lua_pushboolean(L, released);
-            return 1;
+        static void Flight_SetEnabled(App *app, bool enabled) {
+            app->GetFlightRecorderSettings().enabled = enabled;
+        }
+
+        static const luaL_Reg FlightFunctions[] = {
+                {"dump",        Flight_Dump},
+                {"set_budget",  LuaBind<Flight_SetBudget>},
+                {"set_enabled", LuaBind<Flight_SetEnabled>},
+                {nullptr,       nullptr}};
+
+        static int FlightRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "flight", FlightFunctions);
+        }
+
+        ///////////////////////////////////////////////
+        // Jobs
+        ///////////////////////////////////////////////
+
+        static uint32_t Jobs_Threads(App *app) {
+            return app->GetJobs().ThreadCount();
         }
 
-        DEFINE_LUA_FUNC(Input_IsMousePressed) {
-            auto mouseId = (uint32_t) lua_tointeger(L, 1);
-            lua_pushboolean(L, instance->GetMouse(mouseId).bPressed);
+        DEFINE_LUA_FUNC(Jobs_Kernels) {
+            auto &kernels = JobKernels::Get().All();
+            lua_createtable(L, int(kernels.size()), 0);
+            for (size_t i = 0; i < kernels.size(); i++) {
+                lua_pushstring(L, kernels[i].name.c_str());
+                lua_rawseti(L, -2, lua_Integer(i + 1));
+            }
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_IsMouseHeld) {
-            auto mouseId = (uint32_t) lua_tointeger(L, 1);
-            lua_pushboolean(L, instance->GetMouse(mouseId).bHeld);
+        // PGE.jobs.run(kernel, buffers..., numbers...) runs a native kernel over
+        // every element of the first buffer, split over the job system
+        DEFINE_LUA_FUNC(Jobs_Run) {
+            OLC_PROFILE_ZONE("Jobs Run");
+            const char *name = luaL_checkstring(L, 1);
+            const JobKernel *kernel = JobKernels::Get().Find(name);
+            if (kernel == nullptr)
+                return luaL_error(L, "unknown kernel '%s'", name);
+
+            // fixed arrays, argument errors longjmp past destructors
+            Buffer *buffers[JobKernel::MaxArgs];
+            double numbers[JobKernel::MaxArgs];
+            size_t bufferCount = kernel->buffers.size();
+            int arg = 2;
+            for (size_t i = 0; i < bufferCount; i++, arg++) {
+                buffers[i] = CheckBuffer(L, arg, kernel->buffers[i]);
+                luaL_argcheck(L, buffers[i]->length >= buffers[0]->length, arg, "buffer shorter than the first");
+            }
+            for (int i = 0; i < kernel->numbers; i++)
+                numbers[i] = luaL_checknumber(L, arg++);
+
+            size_t length = bufferCount > 0 ? buffers[0]->length : 0;
+            GetApp(L)->GetJobs().ParallelFor(0, length, kernel->grain, [&](size_t first, size_t last) {
+                kernel->fn(buffers, numbers, first, last);
+            });
+
+            for (size_t i = 0; i < bufferCount; i++)
+                buffers[i]->Touch();
+            return 0;
+        }
+
+        static const luaL_Reg JobsFunctions[] = {
+                {"threads", LuaBind<Jobs_Threads>},
+                {"kernels", Jobs_Kernels},
+                {"run",     Jobs_Run},
+                {nullptr,   nullptr}};
+
+        static int JobsRegisterFunctions(lua_State *L) {
+            return RegisterLuaModule(L, "jobs", JobsFunctions);
+        }
+
+        ///////////////////////////////////////////////
+        // Worker
+        //   PGE.worker.spawn(path, ...) runs a script in its own Lua
+        //   state on the worker pool. The chunk gets the spawn
+        //   arguments, every later w:send(...) calls the script's
+        //   global on_message(...), and PGE.worker.send(...) inside the
+        //   script queues a result for w:receive(). Nothing here waits,
+        //   receive() returns nothing while no result is queued.
+        //
+        //   Messages are copied between the states and lose their
+        //   metatables. Buffers are moved instead: the sender's buffer
+        //   is left empty and the receiver adopts its block, so a
+        //   buffer passed back and forth is only copied once.
+        ///////////////////////////////////////////////
+
+        class LuaWorker {
+        public:
+            enum Phase {
+                Running,
+                Failed,
+                Closed,
+            };
+
+            LuaWorker() {
+                W = lua_newstate(LuaAllocator::Alloc, &Allocator);
+                lua_atpanic(W, Panic);
+                Context.worker = this;
+                LuaContextSlot(W) = &Context;
+            }
+
+            LuaWorker(const LuaWorker &) = delete;
+
+            ~LuaWorker() {
+                lua_close(W);
+            }
+
+            // Only the owner calls this, a running script stops at its next hook
+            void Close() {
+                int running = Running;
+                State.compare_exchange_strong(running, Closed);
+            }
+
+            // Only the running job calls this
+            void Fail(const char *error) {
+                Error = error;
+                int running = Running;
+                if (State.compare_exchange_strong(running, Failed, std::memory_order_acq_rel))
+                    std::cout << "[Worker Error] " << error << std::endl;
+            }
+
+            inline bool IsRunning() const { return State.load(std::memory_order_acquire) == Running; }
+
+            // Error of a failed worker, nullptr otherwise
+            inline const char *GetError() const {
+                return State.load(std::memory_order_acquire) == Failed ? Error.c_str() : nullptr;
+            }
+
+        public:
+            lua_State *W;
+            LuaAllocator Allocator;
+            LuaContext Context;
+
+            // owner -> script and script -> owner
+            LuaChannel<WorkerMessage> Inbox;
+            LuaChannel<WorkerMessage> Outbox;
+
+            // a pool job for this worker is queued or running
+            std::atomic<bool> Scheduled{false};
+            // the chunk ran, later messages go to on_message
+            bool Started = false;
+
+        private:
+            std::atomic<int> State{Running};
+            std::string Error;
+        };
+
+        using WorkerHandle = std::shared_ptr<LuaWorker>;
+
+        static const char *WorkerMetaName = "PGE.Worker";
+
+        // deepest table nesting a message may carry
+        static constexpr int WorkerMaxDepth = 32;
+        // messages one pool job delivers before making room for other workers
+        static constexpr int WorkerBatch = 64;
+        // VM instructions between two checks for a closed worker
+        static constexpr int WorkerHookCount = 10000;
+
+        // Raises an error for anything a message cannot carry, before anything is encoded.
+        // `seen` is a table of the tables met so far, a table reached twice is either
+        // cyclic or shared and would be copied once per path.
+        static void CheckMessageValue(lua_State *L, int idx, int seen, int depth) {
+            switch (lua_type(L, idx)) {
+                case LUA_TNIL:
+                case LUA_TBOOLEAN:
+                case LUA_TNUMBER:
+                case LUA_TSTRING:
+                    return;
+                case LUA_TTABLE:
+                    if (depth >= WorkerMaxDepth)
+                        luaL_error(L, "message tables nested too deep");
+                    luaL_checkstack(L, 3, "message tables nested too deep");
+                    idx = lua_absindex(L, idx);
+                    if (lua_rawgetp(L, seen, lua_topointer(L, idx)) != LUA_TNIL)
+                        luaL_error(L, "cannot send a table twice in one message (cyclic or shared)");
+                    lua_pop(L, 1);
+                    lua_pushboolean(L, 1);
+                    lua_rawsetp(L, seen, lua_topointer(L, idx));
+
+                    lua_pushnil(L);
+                    while (lua_next(L, idx)) {
+                        CheckMessageValue(L, -2, seen, depth + 1);
+                        CheckMessageValue(L, -1, seen, depth + 1);
+                        lua_pop(L, 1);
+                    }
+                    return;
+                case LUA_TUSERDATA:
+                    if (luaL_testudata(L, idx, BufferMetaName))
+                        return;
+                    break;
+            }
+            luaL_error(L, "cannot send a %s", luaL_typename(L, idx));
+        }
+
+        // Checks the values from first to last, the stack is left as it was
+        static void CheckMessageValues(lua_State *L, int first, int last) {
+            lua_newtable(L);
+            int seen = lua_gettop(L);
+            for (int i = first; i <= last; i++)
+                CheckMessageValue(L, i, seen, 0);
+            lua_pop(L, 1);
+        }
+
+        // Appends a value CheckMessageValue accepted, nothing in here raises a Lua error
+        static void EncodeMessageValue(lua_State *L, int idx, WorkerMessage &message, std::vector<Buffer *> &buffers) {
+            switch (lua_type(L, idx)) {
+                case LUA_TBOOLEAN:
+                    message.Put(WorkerMessage::Boolean);
+                    message.Put(uint8_t(lua_toboolean(L, idx)));
+                    return;
+                case LUA_TNUMBER:
+                    if (lua_isinteger(L, idx)) {
+                        message.Put(WorkerMessage::Integer);
+                        message.Put(int64_t(lua_tointeger(L, idx)));
+                    } else {
+                        message.Put(WorkerMessage::Number);
+                        message.Put(double(lua_tonumber(L, idx)));
+                    }
+                    return;
+                case LUA_TSTRING: {
+                    size_t length = 0;
+                    const char *s = lua_tolstring(L, idx, &length);
+                    message.Put(WorkerMessage::String);
+                    message.Put(uint64_t(length));
+                    message.bytes.append(s, length);
+                    return;
+                }
+                case LUA_TTABLE:
+                    idx = lua_absindex(L, idx);
+                    message.Put(WorkerMessage::TableBegin);
+                    lua_pushnil(L);
+                    while (lua_next(L, idx)) {
+                        EncodeMessageValue(L, -2, message, buffers);
+                        EncodeMessageValue(L, -1, message, buffers);
+                        lua_pop(L, 1);
+                    }
+                    message.Put(WorkerMessage::TableEnd);
+                    return;
+                case LUA_TUSERDATA: {
+                    // a buffer sent twice in one message arrives as one buffer
+                    auto buffer = (Buffer *) lua_touserdata(L, idx);
+                    auto it = std::find(buffers.begin(), buffers.end(), buffer);
+                    if (it == buffers.end())
+                        it = buffers.insert(buffers.end(), buffer);
+                    message.Put(WorkerMessage::Block);
+                    message.Put(uint32_t(it - buffers.begin()));
+                    return;
+                }
+                default:
+                    message.Put(WorkerMessage::Nil);
+                    return;
+            }
+        }
+
+        // Encodes the values from first to the top, sent buffers are left empty
+        static WorkerMessage EncodeMessage(lua_State *L, int first) {
+            int top = lua_gettop(L);
+            CheckMessageValues(L, first, top);
+
+            WorkerMessage message;
+            std::vector<Buffer *> buffers;
+            for (int i = first; i <= top; i++)
+                EncodeMessageValue(L, i, message, buffers);
+            message.count = top - first + 1;
+
+            for (Buffer *buffer : buffers) {
+                Buffer::Type type = buffer->type;
+                size_t length = buffer->length;
+                message.blobs.push_back({type, length, buffer->Detach()});
+            }
+            return message;
+        }
+
+        static bool DecodeMessageValue(lua_State *L, const WorkerMessage &message, size_t &pos, int blobBase) {
+            WorkerMessage::Tag tag;
+            if (!message.Get(pos, tag))
+                return false;
+
+            switch (tag) {
+                case WorkerMessage::Nil:
+                    lua_pushnil(L);
+                    return true;
+                case WorkerMessage::Boolean: {
+                    uint8_t b = 0;
+                    if (!message.Get(pos, b))
+                        return false;
+                    lua_pushboolean(L, b != 0);
+                    return true;
+                }
+                case WorkerMessage::Integer: {
+                    int64_t i = 0;
+                    if (!message.Get(pos, i))
+                        return false;
+                    lua_pushinteger(L, lua_Integer(i));
+                    return true;
+                }
+                case WorkerMessage::Number: {
+                    double n = 0.0;
+                    if (!message.Get(pos, n))
+                        return false;
+                    lua_pushnumber(L, lua_Number(n));
+                    return true;
+                }
+                case WorkerMessage::String: {
+                    uint64_t length = 0;
+                    if (!message.Get(pos, length) || pos + length > message.bytes.size())
+                        return false;
+                    lua_pushlstring(L, message.bytes.data() + pos, size_t(length));
+                    pos += size_t(length);
+                    return true;
+                }
+                case WorkerMessage::TableBegin:
+                    lua_newtable(L);
+                    while (pos < message.bytes.size() && uint8_t(message.bytes[pos]) != WorkerMessage::TableEnd) {
+                        if (!DecodeMessageValue(L, message, pos, blobBase) ||
+                            !DecodeMessageValue(L, message, pos, blobBase))
+                            return false;
+                        lua_rawset(L, -3);
+                    }
+                    pos++;
+                    return pos <= message.bytes.size();
+                case WorkerMessage::Block: {
+                    uint32_t index = 0;
+                    if (!message.Get(pos, index) || index >= message.blobs.size())
+                        return false;
+                    lua_pushvalue(L, blobBase + int(index));
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        // Pushes the values of the message and returns how many, -1 when it does not
+        // fit on the stack. Its blocks become buffers of L.
+        static int PushMessage(lua_State *L, WorkerMessage &message) {
+            int blobCount = int(message.blobs.size());
+            if (!lua_checkstack(L, blobCount + message.count + 3 * WorkerMaxDepth + 4))
+                return -1;
+
+            int blobBase = lua_gettop(L) + 1;
+            for (WorkerMessage::Blob &blob : message.blobs) {
+                auto buffer = NewBuffer(L, blob.type, blob.length, blob.data);
+                buffer->heap = blob.data;
+                blob.data = nullptr;
+            }
+
+            size_t pos = 0;
+            for (int i = 0; i < message.count; i++) {
+                if (!DecodeMessageValue(L, message, pos, blobBase)) {
+                    lua_settop(L, blobBase - 1);
+                    return -1;
+                }
+            }
+
+            // drop the buffers below the values, the values still reference them
+            lua_rotate(L, blobBase, -blobCount);
+            lua_pop(L, blobCount);
+            return message.count;
+        }
+
+        static void WorkerHook(lua_State *L, lua_Debug *) {
+            if (!GetContext(L).worker->IsRunning())
+                luaL_error(L, "worker closed");
+        }
+
+        static void ScheduleWorker(olc::JobSystem *pool, const WorkerHandle &worker);
+
+        // Delivers queued messages, the Scheduled flag keeps this to one job per worker
+        static void RunWorker(olc::JobSystem *pool, const WorkerHandle &worker) {
+            lua_State *W = worker->W;
+
+            WorkerMessage message;
+            for (int handled = 0; handled < WorkerBatch && worker->IsRunning() && worker->Inbox.Pop(message); handled++) {
+                // stack: [traceback, chunk] until the chunk ran, [traceback] after
+                if (worker->Started) {
+                    if (lua_getglobal(W, "on_message") != LUA_TFUNCTION) {
+                        lua_settop(W, 1);
+                        worker->Fail("message sent to a worker without on_message");
+                        break;
+                    }
+                } else {
+                    worker->Started = true;
+                }
+
+                int count = PushMessage(W, message);
+                if (count < 0) {
+                    lua_settop(W, 1);
+                    worker->Fail("message does not fit on the worker's stack");
+                    break;
+                }
+
+                if (lua_pcall(W, count, 0, 1) != LUA_OK) {
+                    worker->Fail(lua_tostring(W, -1));
+                    lua_settop(W, 1);
+                    break;
+                }
+            }
+
+            // swapping (instead of storing) reads the flag a concurrent send just set,
+            // so its message is seen by the check below or that send schedules a job
+            worker->Scheduled.exchange(false, std::memory_order_acq_rel);
+            if (worker->IsRunning() && !worker->Inbox.Empty())
+                ScheduleWorker(pool, worker);
+        }
+
+        static void ScheduleWorker(olc::JobSystem *pool, const WorkerHandle &worker) {
+            if (!worker->Scheduled.exchange(true, std::memory_order_acq_rel))
+                pool->Submit([pool, worker]() { RunWorker(pool, worker); });
+        }
+
+        static LuaWorker *CheckWorker(lua_State *L, int idx) {
+            return ((WorkerHandle *) luaL_checkudata(L, idx, WorkerMetaName))->get();
+        }
+
+        // PGE.worker.send(...) inside a worker script, queues a result for the owner
+        DEFINE_LUA_FUNC(Worker_Post) {
+            GetContext(L).worker->Outbox.Push(EncodeMessage(L, 1));
+            return 0;
+        }
+
+        static const luaL_Reg WorkerScriptFunctions[] = {
+                {"send",  Worker_Post},
+                {nullptr, nullptr}};
+
+        static const luaL_Reg WorkerBufferFunctions[] = {
+                {"new",   Buffer_New},
+                {nullptr, nullptr}};
+
+        // w:send(...) returns false once the worker failed or was closed
+        DEFINE_LUA_FUNC(Worker_Send) {
+            auto handle = (WorkerHandle *) luaL_checkudata(L, 1, WorkerMetaName);
+            if (!(*handle)->IsRunning()) {
+                lua_pushboolean(L, false);
+                return 1;
+            }
+
+            (*handle)->Inbox.Push(EncodeMessage(L, 2));
+            ScheduleWorker(&GetApp(L)->GetWorkerPool(), *handle);
+            lua_pushboolean(L, true);
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_IsMouseReleased) {
-            auto mouseId = lua_tointeger(L, 1);
-            lua_pushboolean(L, instance->GetMouse(mouseId).bReleased);
+        // w:receive() returns the values of the oldest result, nothing when none is queued
+        DEFINE_LUA_FUNC(Worker_Receive) {
+            LuaWorker *worker = CheckWorker(L, 1);
+            int count;
+            {
+                // gone before the error below skips its destructor
+                WorkerMessage message;
+                if (!worker->Outbox.Pop(message))
+                    return 0;
+                count = PushMessage(L, message);
+            }
+            if (count < 0)
+                return luaL_error(L, "result does not fit on the stack");
+            return count;
+        }
+
+        DEFINE_LUA_FUNC(Worker_Pending) {
+            lua_pushinteger(L, lua_Integer(CheckWorker(L, 1)->Outbox.Size()));
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_GetMouseX) {
-            lua_pushnumber(L, instance->GetMouseX());
+        DEFINE_LUA_FUNC(Worker_Error) {
+            const char *error = CheckWorker(L, 1)->GetError();
+            if (error == nullptr)
+                return 0;
+            lua_pushstring(L, error);
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_GetMouseY) {
-            lua_pushnumber(L, instance->GetMouseY());
+        DEFINE_LUA_FUNC(Worker_IsRunning) {
+            lua_pushboolean(L, CheckWorker(L, 1)->IsRunning());
             return 1;
         }
 
-        DEFINE_LUA_FUNC(Input_GetMouseWheel) {
-            lua_pushnumber(L, instance->GetMouseWheel());
+        DEFINE_LUA_FUNC(Worker_Close) {
+            CheckWorker(L, 1)->Close();
+            return 0;
+        }
+
+        // The pool keeps a running worker alive until its job returns
+        DEFINE_LUA_FUNC(Worker_GC) {
+            auto handle = (WorkerHandle *) lua_touserdata(L, 1);
+            (*handle)->Close();
+            handle->~WorkerHandle();
+            return 0;
+        }
+
+        static const luaL_Reg WorkerMethods[] = {
+                {"send",       Worker_Send},
+                {"receive",    Worker_Receive},
+                {"pending",    Worker_Pending},
+                {"error",      Worker_Error},
+                {"is_running", Worker_IsRunning},
+                {"close",      Worker_Close},
+                {nullptr,      nullptr}};
+
+        // PGE.worker.spawn(path, ...) returns the worker, or nil and a message
+        // when the script does not compile
+        DEFINE_LUA_FUNC(Worker_Spawn) {
+            const char *path = luaL_checkstring(L, 1);
+            CheckMessageValues(L, 2, lua_gettop(L));
+
+            auto handle = (WorkerHandle *) lua_newuserdatauv(L, sizeof(WorkerHandle), 0);
+            new(handle) WorkerHandle(std::make_shared<LuaWorker>());
+            luaL_setmetatable(L, WorkerMetaName);
+            lua_State *W = (*handle)->W;
+
+            luaL_openlibs(W);
+            RegisterLuaModule(W, "worker", WorkerScriptFunctions);
+            RegisterLuaModule(W, "buffer", WorkerBufferFunctions);
+            lua_sethook(W, WorkerHook, LUA_MASKCOUNT, WorkerHookCount);
+
+            lua_pushcfunction(W, Traceback);
+            if (luaL_loadfile(W, path) != LUA_OK) {
+                lua_pushnil(L);
+                lua_pushstring(L, lua_tostring(W, -1));
+                return 2;
+            }
+
+            // the spawn arguments are the first message, the chunk receives them
+            lua_rotate(L, 2, 1);
+            (*handle)->Inbox.Push(EncodeMessage(L, 3));
+            lua_settop(L, 2);
+            ScheduleWorker(&GetApp(L)->GetWorkerPool(), *handle);
             return 1;
         }
 
-        static const luaL_Reg InputFunctions[] = {
-                {"is_key_pressed",    Input_IsKeyPressed},
-                {"is_key_held",       Input_IsKeyHeld},
-                {"is_key_released",   Input_IsKeyReleased},
-                {"is_mouse_pressed",  Input_IsMousePressed},
-                {"is_mouse_held",     Input_IsMouseHeld},
-                {"is_mouse_released", Input_IsMouseReleased},
-                {"mouse_x",           Input_GetMouseX},
-                {"mouse_y",           Input_GetMouseY},
-                {"mouse_wheel",       Input_GetMouseWheel},
-                {NULL, NULL}};
+        static uint32_t Worker_Threads(App *app) {
+            return app->GetWorkerPool().ThreadCount() - 1;
+        }
 
-        static int InputRegisterFunctions(lua_State *L) {
-            return RegisterLuaModule(L, "input", InputFunctions);
+        static const luaL_Reg WorkerFunctions[] = {
+                {"spawn",   Worker_Spawn},
+                {"threads", LuaBind<Worker_Threads>},
+                {nullptr,   nullptr}};
+
+        static int WorkerRegisterFunctions(lua_State *L) {
+            luaL_newmetatable(L, WorkerMetaName);
+            luaL_newlib(L, WorkerMethods);
+            lua_setfield(L, -2, "__index");
+            lua_pushcfunction(L, Worker_GC);
+            lua_setfield(L, -2, "__gc");
+            lua_pop(L, 1);
+
+            return RegisterLuaModule(L, "worker", WorkerFunctions);
         }
 
 #undef DEFINE_LUA_FUNC
     }
 
     bool Run() {
-        _::instance = new _::App();
-        auto app = _::instance;
+        auto app = new _::App();
 
         if (app->Construct(app->GetScreenWidth(),
                            app->GetScreenHeight(),
@@ -955,8 +3633,7 @@ namespace PGEApp {
                            app->GetScreenYScale()))
             app->Start();
 
-        delete _::instance;
-        _::instance = nullptr;
+        delete app;
         return true;
     }
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "olcPixelGameEngine.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // ParticleEmitter
+    //   Spawn parameters, ranges are sampled uniformly per particle.
+    /////////////////////////////////////////////////
+    struct ParticleEmitter {
+        int32_t count = 1;
+        float speedMin = 0.0f, speedMax = 0.0f;
+        float directionMin = 0.0f, directionMax = 6.2831853f;
+        float spinMin = 0.0f, spinMax = 0.0f;
+        float lifeMin = 1.0f, lifeMax = 1.0f;
+        float scale = 1.0f;
+        // start rotated to the direction of travel, otherwise upright
+        bool alignToDirection = true;
+        olc::Pixel color = olc::WHITE;
+    };
+
+    /////////////////////////////////////////////////
+    // ParticleSystem
+    //   Structure of arrays storage, dead particles are swap removed.
+    //   All particles share one decal and are drawn as a single
+    //   triangle list decal instance. Large systems split the update
+    //   and the vertex generation over the job system when given one.
+    /////////////////////////////////////////////////
+    class ParticleSystem {
+    public:
+        // below this many particles a job costs more than it saves
+        static constexpr size_t ParallelMin = 16384;
+
+    public:
+        ParticleSystem(olc::Decal *decal, size_t capacity)
+                : _decal(decal), _capacity(capacity), _rng(std::random_device{}()) {
+        }
+
+    public:
+        inline size_t Count() const { return _count; }
+
+        inline size_t GetCapacity() const { return _capacity; }
+
+        void SetGravity(float x, float y) {
+            _gravityX = x;
+            _gravityY = y;
+        }
+
+        void Clear() { _count = 0; }
+
+        // Spawns particles at (x, y), count < 0 uses the emitter's count.
+        // Particles past the capacity are dropped.
+        void Emit(const ParticleEmitter &emitter, float x, float y, int32_t count = -1) {
+            if (count < 0)
+                count = std::max(emitter.count, 0);
+
+            size_t n = std::min(_count + size_t(count), _capacity);
+            if (n > _px.size())
+                Reserve(std::min(_capacity, std::max(n, _px.size() * 2)));
+
+            for (size_t i = _count; i < n; i++) {
+                float direction = Random(emitter.directionMin, emitter.directionMax);
+                float speed = Random(emitter.speedMin, emitter.speedMax);
+                float life = std::max(Random(emitter.lifeMin, emitter.lifeMax), 1e-4f);
+
+                _px[i] = x;
+                _py[i] = y;
+                _vx[i] = speed * std::cos(direction);
+                _vy[i] = speed * std::sin(direction);
+                _angle[i] = emitter.alignToDirection ? direction : 0.0f;
+                _spin[i] = Random(emitter.spinMin, emitter.spinMax);
+                _life[i] = life;
+                _invLife[i] = 1.0f / life;
+                _fade[i] = 1.0f;
+                _scale[i] = emitter.scale;
+                _color[i] = emitter.color;
+            }
+
+            _count = n;
+        }
+
+        void Update(float dt, olc::JobSystem *jobs = nullptr) {
+            if (jobs != nullptr && _count >= ParallelMin)
+                jobs->ParallelFor(0, _count, ParallelMin / 4, [this, dt](size_t first, size_t last) {
+                    Integrate(first, last, dt);
+                });
+            else
+                Integrate(0, _count, dt);
+
+            // compact, the last live particle fills each hole
+            for (size_t i = 0; i < _count;) {
+                if (_life[i] > 0.0f) {
+                    i++;
+                    continue;
+                }
+
+                size_t last = --_count;
+                _px[i] = _px[last];
+                _py[i] = _py[last];
+                _vx[i] = _vx[last];
+                _vy[i] = _vy[last];
+                _angle[i] = _angle[last];
+                _spin[i] = _spin[last];
+                _life[i] = _life[last];
+                _invLife[i] = _invLife[last];
+                _fade[i] = _fade[last];
+                _scale[i] = _scale[last];
+                _color[i] = _color[last];
+            }
+        }
+
+        // Draws every particle centred on its position, screen position is
+        // offset + position * worldScale so simulations can run in any unit
+        void Draw(olc::PixelGameEngine *pge, float offsetX, float offsetY, float worldScale,
+                  olc::JobSystem *jobs = nullptr) {
+            if (_decal == nullptr || _count == 0)
+                return;
+
+            _pos.resize(_count * 6);
+            _uv.resize(_count * 6);
+            _tint.resize(_count * 6);
+
+            auto build = [this, offsetX, offsetY, worldScale](size_t first, size_t last) {
+                BuildVertices(first, last, offsetX, offsetY, worldScale);
+            };
+            if (jobs != nullptr && _count >= ParallelMin)
+                jobs->ParallelFor(0, _count, ParallelMin / 4, build);
+            else
+                build(0, _count);
+
+            olc::DecalStructure structure = pge->GetDecalStructure();
+            pge->SetDecalStructure(olc::DecalStructure::LIST);
+            pge->DrawPolygonDecal(_decal, _pos, _uv, _tint);
+            pge->SetDecalStructure(structure);
+        }
+
+    private:
+        // Moves particles [first, last), each one only touches its own slots
+        void Integrate(size_t first, size_t last, float dt) {
+            const float gx = _gravityX * dt, gy = _gravityY * dt;
+            size_t i = first;
+
+#if defined(OLC_SIMD_SSE2)
+            const __m128 vdt = _mm_set1_ps(dt), vgx = _mm_set1_ps(gx), vgy = _mm_set1_ps(gy);
+            const __m128 zero = _mm_setzero_ps();
+            for (; i + 4 <= last; i += 4) {
+                __m128 vx = _mm_add_ps(_mm_loadu_ps(&_vx[i]), vgx);
+                __m128 vy = _mm_add_ps(_mm_loadu_ps(&_vy[i]), vgy);
+                _mm_storeu_ps(&_vx[i], vx);
+                _mm_storeu_ps(&_vy[i], vy);
+                _mm_storeu_ps(&_px[i], _mm_add_ps(_mm_loadu_ps(&_px[i]), _mm_mul_ps(vx, vdt)));
+                _mm_storeu_ps(&_py[i], _mm_add_ps(_mm_loadu_ps(&_py[i]), _mm_mul_ps(vy, vdt)));
+                _mm_storeu_ps(&_angle[i], _mm_add_ps(_mm_loadu_ps(&_angle[i]), _mm_mul_ps(_mm_loadu_ps(&_spin[i]), vdt)));
+
+                __m128 life = _mm_sub_ps(_mm_loadu_ps(&_life[i]), vdt);
+                _mm_storeu_ps(&_life[i], life);
+                _mm_storeu_ps(&_fade[i], _mm_max_ps(zero, _mm_mul_ps(life, _mm_loadu_ps(&_invLife[i]))));
+            }
+#endif
+
+            for (; i < last; i++) {
+                _vx[i] += gx;
+                _vy[i] += gy;
+                _px[i] += _vx[i] * dt;
+                _py[i] += _vy[i] * dt;
+                _angle[i] += _spin[i] * dt;
+                _life[i] -= dt;
+                _fade[i] = std::max(0.0f, _life[i] * _invLife[i]);
+            }
+        }
+
+        // Writes the six vertices of particles [first, last)
+        void BuildVertices(size_t first, size_t last, float offsetX, float offsetY, float worldScale) {
+            const float hw = float(_decal->sprite->width) * 0.5f;
+            const float hh = float(_decal->sprite->height) * 0.5f;
+            static const olc::vf2d corners[6] = {{-1, -1}, {-1, 1}, {1, 1}, {-1, -1}, {1, 1}, {1, -1}};
+            static const olc::vf2d uvs[6] = {{0, 0}, {0, 1}, {1, 1}, {0, 0}, {1, 1}, {1, 0}};
+
+            for (size_t i = first; i < last; i++) {
+                const float c = std::cos(_angle[i]) * _scale[i], s = std::sin(_angle[i]) * _scale[i];
+                const olc::vf2d p = {offsetX + _px[i] * worldScale, offsetY + _py[i] * worldScale};
+
+                olc::Pixel tint = _color[i];
+                tint.a = uint8_t(float(tint.a) * _fade[i]);
+
+                for (int k = 0; k < 6; k++) {
+                    const float x = corners[k].x * hw, y = corners[k].y * hh;
+                    _pos[i * 6 + k] = {p.x + x * c - y * s, p.y + x * s + y * c};
+                    _uv[i * 6 + k] = uvs[k];
+                    _tint[i * 6 + k] = tint;
+                }
+            }
+        }
+
+        void Reserve(size_t n) {
+            _px.resize(n);
+            _py.resize(n);
+            _vx.resize(n);
+            _vy.resize(n);
+            _angle.resize(n);
+            _spin.resize(n);
+            _life.resize(n);
+            _invLife.resize(n);
+            _fade.resize(n);
+            _scale.resize(n);
+            _color.resize(n);
+        }
+
+        float Random(float min, float max) {
+            if (min >= max)
+                return min;
+
+            return std::uniform_real_distribution<float>(min, max)(_rng);
+        }
+
+    private:
+        olc::Decal *_decal;
+        size_t _capacity;
+        size_t _count = 0;
+
+        float _gravityX = 0.0f;
+        float _gravityY = 0.0f;
+
+        std::vector<float> _px, _py;
+        std::vector<float> _vx, _vy;
+        std::vector<float> _angle, _spin;
+        std::vector<float> _life, _invLife, _fade;
+        std::vector<float> _scale;
+        std::vector<olc::Pixel> _color;
+
+        // vertex scratch reused between frames
+        std::vector<olc::vf2d> _pos, _uv;
+        std::vector<olc::Pixel> _tint;
+
+        std::mt19937 _rng;
+    };
+}
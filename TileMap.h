@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "olcPixelGameEngine.h"
+
+namespace PGEApp {
+    /////////////////////////////////////////////////
+    // TileMap
+    //   Grid of tile indices drawn from an atlas sprite.
+    //   Cell value 0 is empty, value n draws atlas tile n - 1,
+    //   atlas tiles are numbered row by row.
+    //   With the cache enabled the map is kept rendered in an
+    //   offscreen sprite, only changed cells are redrawn into it
+    //   and each Draw composites it with a single blit. Empty
+    //   cells are blank in the cache, so composite it in MASK or
+    //   ALPHA mode to leave what is underneath them untouched.
+    /////////////////////////////////////////////////
+    class TileMap {
+    public:
+        TileMap(int32_t width, int32_t height, olc::Sprite *atlas, int32_t tileWidth, int32_t tileHeight)
+                : _width(std::max(0, width)), _height(std::max(0, height)),
+                  _tileWidth(std::max(1, tileWidth)), _tileHeight(std::max(1, tileHeight)),
+                  _atlas(atlas), _cells(size_t(_width) * size_t(_height), 0) {
+            _atlasColumns = atlas ? std::max(1, atlas->width / _tileWidth) : 1;
+        }
+
+    public:
+        inline int32_t GetWidth() const { return _width; }
+
+        inline int32_t GetHeight() const { return _height; }
+
+        inline int32_t GetTileWidth() const { return _tileWidth; }
+
+        inline int32_t GetTileHeight() const { return _tileHeight; }
+
+        inline olc::Sprite *GetAtlas() const { return _atlas; }
+
+        uint16_t Get(int32_t x, int32_t y) const {
+            if (x < 0 || x >= _width || y < 0 || y >= _height)
+                return 0;
+
+            return _cells[y * _width + x];
+        }
+
+        bool Set(int32_t x, int32_t y, uint16_t tile) {
+            if (x < 0 || x >= _width || y < 0 || y >= _height)
+                return false;
+
+            uint16_t &cell = _cells[y * _width + x];
+            if (cell != tile) {
+                cell = tile;
+                Invalidate(x, y);
+            }
+            return true;
+        }
+
+        void EnableCache(bool enable) {
+            if (!enable) {
+                _cache.reset();
+                _dirty.clear();
+                _dirtyFlags.clear();
+                return;
+            }
+
+            if (_cache)
+                return;
+
+            _cache = std::make_unique<olc::Sprite>(_width * _tileWidth, _height * _tileHeight);
+            _cache->EnableSpanCache();
+            _dirtyFlags.assign(_cells.size(), 0);
+            InvalidateAll();
+        }
+
+        inline bool HasCache() const { return _cache != nullptr; }
+
+        // Marks one cell to be redrawn into the cache on the next Draw
+        void Invalidate(int32_t x, int32_t y) {
+            if (!_cache || _allDirty || x < 0 || x >= _width || y < 0 || y >= _height)
+                return;
+
+            int32_t idx = y * _width + x;
+            if (!_dirtyFlags[idx]) {
+                _dirtyFlags[idx] = 1;
+                _dirty.push_back(idx);
+            }
+        }
+
+        void InvalidateAll() {
+            _allDirty = _cache != nullptr;
+            _dirty.clear();
+            std::fill(_dirtyFlags.begin(), _dirtyFlags.end(), 0);
+        }
+
+        // Draws the map with its top left corner at (x, y) using the current pixel mode.
+        // Uncached, only cells overlapping the draw target are visited, one row at a time.
+        void Draw(olc::PixelGameEngine *pge, int32_t x, int32_t y) {
+            olc::Sprite *target = pge->GetDrawTarget();
+            if (target == nullptr || _atlas == nullptr)
+                return;
+
+            if (_cache) {
+                UpdateCache(pge);
+                pge->DrawSprite(x, y, _cache.get());
+                return;
+            }
+
+            int32_t cx0 = std::max(0, FloorDiv(-x, _tileWidth));
+            int32_t cy0 = std::max(0, FloorDiv(-y, _tileHeight));
+            int32_t cx1 = std::min(_width, FloorDiv(target->width - x + _tileWidth - 1, _tileWidth));
+            int32_t cy1 = std::min(_height, FloorDiv(target->height - y + _tileHeight - 1, _tileHeight));
+
+            for (int32_t cy = cy0; cy < cy1; cy++) {
+                const uint16_t *row = _cells.data() + cy * _width;
+                int32_t py = y + cy * _tileHeight;
+
+                for (int32_t cx = cx0; cx < cx1; cx++) {
+                    if (row[cx] == 0)
+                        continue;
+
+                    int32_t tile = row[cx] - 1;
+                    pge->DrawPartialSprite(x + cx * _tileWidth, py, _atlas,
+                                           (tile % _atlasColumns) * _tileWidth,
+                                           (tile / _atlasColumns) * _tileHeight,
+                                           _tileWidth, _tileHeight);
+                }
+            }
+        }
+
+    private:
+        // Redraws invalidated cells into the cache, cells are copied as is
+        // (transparent texels included) so the cache matches a direct draw
+        void UpdateCache(olc::PixelGameEngine *pge) {
+            if (!_allDirty && _dirty.empty())
+                return;
+
+            olc::Sprite *target = pge->GetDrawTarget();
+            olc::Pixel::Mode mode = pge->GetPixelMode();
+            pge->SetDrawTarget(_cache.get());
+            pge->SetPixelMode(olc::Pixel::NORMAL);
+
+            if (_allDirty) {
+                for (int32_t idx = 0; idx < int32_t(_cells.size()); idx++)
+                    DrawCell(pge, idx);
+            } else {
+                for (int32_t idx : _dirty) {
+                    DrawCell(pge, idx);
+                    _dirtyFlags[idx] = 0;
+                }
+            }
+
+            _allDirty = false;
+            _dirty.clear();
+
+            pge->SetPixelMode(mode);
+            pge->SetDrawTarget(target);
+        }
+
+        void DrawCell(olc::PixelGameEngine *pge, int32_t idx) {
+            int32_t px = (idx % _width) * _tileWidth;
+            int32_t py = (idx / _width) * _tileHeight;
+
+            if (_cells[idx] == 0) {
+                pge->FillRect(px, py, _tileWidth, _tileHeight, olc::BLANK);
+                return;
+            }
+
+            int32_t tile = _cells[idx] - 1;
+            pge->DrawPartialSprite(px, py, _atlas,
+                                   (tile % _atlasColumns) * _tileWidth,
+                                   (tile / _atlasColumns) * _tileHeight,
+                                   _tileWidth, _tileHeight);
+        }
+
+        static int32_t FloorDiv(int32_t a, int32_t b) {
+            return a >= 0 ? a / b : -((-a + b - 1) / b);
+        }
+
+    private:
+        int32_t _width;
+        int32_t _height;
+        int32_t _tileWidth;
+        int32_t _tileHeight;
+        int32_t _atlasColumns;
+
+        olc::Sprite *_atlas;
+        std::vector<uint16_t> _cells;
+
+        std::unique_ptr<olc::Sprite> _cache;
+        std::vector<int32_t> _dirty;
+        std::vector<uint8_t> _dirtyFlags;
+        bool _allDirty = false;
+    };
+}
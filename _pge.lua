@@ -20,8 +20,24 @@ function _pge_load()
     load()
 end
 
-function _pge_update()
-    update(PGE.timer.get_delta_time())
+function _pge_update(dt)
+    if update then
+        update(dt)
+    end
+end
+
+-- only called with a `fixed_timestep` in the config, dt is always 1 / tick_rate
+function _pge_fixed_update(dt)
+    if fixed_update then
+        fixed_update(dt)
+    end
+end
+
+-- alpha is how far the frame is between the last two fixed ticks, 1 without fixed steps
+function _pge_draw(alpha)
+    if draw then
+        draw(alpha)
+    end
 end
 
 function _pge_on_destroy()
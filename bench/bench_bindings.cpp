@@ -0,0 +1,223 @@
+// Lua binding call overhead benchmark
+//
+// Builds the Lua state the same way the demo does (PGEApp::_::App runs
+// InitLua, so _pge.lua and game.lua must be in the working directory),
+// attaches a headless draw target and times tight Lua loops calling
+// each PGE.* binding. Results are ns per call, "overhead" subtracts a
+// no-op C function called the same way: through a local, with the same
+// number of arguments.
+//
+//   PGE_Bench [--iterations N] [--repeat R] [--filter text] [--json file|-]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "PGEApp.h"
+
+namespace {
+    struct BenchCase {
+        const char *name;
+        const char *category;
+        // Lua statements run once before timing, locals are visible to `call`
+        const char *setup;
+        // expression evaluated in the timed loop
+        const char *call;
+        // name of the no-op baseline with the same argument shape
+        const char *baseline;
+    };
+
+    const BenchCase Cases[] = {
+            {"noop_0",                 "baseline", "local noop = noop",
+                    "noop()",                                                   nullptr},
+            {"noop_1",                 "baseline", "local noop = noop",
+                    "noop(1)",                                                  nullptr},
+            {"noop_3",                 "baseline", "local noop = noop",
+                    "noop(1, 2, 3)",                                            nullptr},
+            {"noop_5",                 "baseline", "local noop = noop",
+                    "noop(1, 2, 3, 4, 5)",                                      nullptr},
+            {"noop_6",                 "baseline", "local noop = noop",
+                    "noop(1, 2, 3, 4, 5, 6)",                                   nullptr},
+            {"noop_7",                 "baseline", "local noop = noop",
+                    "noop(1, 2, 3, 4, 5, 6, 7)",                                nullptr},
+            {"noop_8",                 "baseline", "local noop = noop",
+                    "noop(1, 2, 3, 4, 5, 6, 7, 8)",                             nullptr},
+            {"noop_12",                "baseline", "local noop = noop",
+                    "noop(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12)",              nullptr},
+
+            {"timer.get_delta_time",   "getter",   "local f = PGE.timer.get_delta_time",
+                    "f()",                                                      "noop_0"},
+            {"window.screen_width",    "getter",   "local f = PGE.window.screen_width",
+                    "f()",                                                      "noop_0"},
+            {"input.mouse_x",          "getter",   "local f = PGE.input.mouse_x",
+                    "f()",                                                      "noop_0"},
+            {"graphics.get_pixel_mode", "getter",  "local f = PGE.graphics.get_pixel_mode",
+                    "f()",                                                      "noop_0"},
+
+            {"graphics.draw",          "color",    "local f = PGE.graphics.draw",
+                    "f(3, 4, 255, 128, 0)",                                     "noop_5"},
+            {"graphics.fill_circle",   "color",    "local f = PGE.graphics.fill_circle",
+                    "f(16, 16, 2, 0, 255, 255)",                                "noop_6"},
+            {"graphics.fill_rect",     "color",    "local f = PGE.graphics.fill_rect",
+                    "f(8, 8, 2, 2, 255, 0, 0, 255)",                            "noop_8"},
+            {"graphics.draw_line",     "color",    "local f = PGE.graphics.draw_line",
+                    "f(0, 0, 3, 3, 255, 255, 255)",                             "noop_7"},
+
+            {"graphics.draw_sprite",   "handle",   "local f = PGE.graphics.draw_sprite local s = PGE.graphics.create_sprite(2, 2)",
+                    "f(4, 4, s)",                                               "noop_3"},
+            {"sprite:width",           "handle",   "local s = PGE.graphics.create_sprite(2, 2)",
+                    "s:width()",                                                "noop_1"},
+            {"graphics.draw_partial_sprite", "many", "local f = PGE.graphics.draw_partial_sprite local s = PGE.graphics.create_sprite(4, 4)",
+                    "f(4, 4, s, 0, 0, 2, 2, 1)",                                "noop_8"},
+            {"graphics.draw_rotated_decal", "many", "local f = PGE.graphics.draw_rotated_decal local d = PGE.graphics.create_decal(PGE.graphics.create_sprite(4, 4))",
+                    "f(8, 8, d, 0.5, 2, 2, 1, 1, 255, 255, 255, 255)",          "noop_12"},
+    };
+
+    struct BenchResult {
+        const BenchCase *test;
+        double nsPerCall;
+        double nsMin;
+        double overhead;
+    };
+
+    int Noop(lua_State *) {
+        return 0;
+    }
+
+    std::string MakeChunk(const BenchCase &test) {
+        std::string chunk;
+        chunk += test.setup;
+        chunk += "\nreturn function(n) for i = 1, n do ";
+        chunk += test.call;
+        chunk += " end end";
+        return chunk;
+    }
+
+    // Returns ns per call of each repetition, empty when the case failed
+    std::vector<double> RunCase(PGEApp::_::App *app, lua_State *L, const BenchCase &test, long iterations, int repeat) {
+        std::vector<double> samples;
+
+        std::string chunk = MakeChunk(test);
+        if (luaL_loadstring(L, chunk.c_str()) != LUA_OK || lua_pcall(L, 0, 1, 0) != LUA_OK) {
+            std::fprintf(stderr, "%s: %s\n", test.name, lua_tostring(L, -1));
+            lua_pop(L, 1);
+            return samples;
+        }
+
+        int loop = lua_gettop(L);
+        for (int r = -1; r < repeat; r++) {
+            lua_pushvalue(L, loop);
+            lua_pushinteger(L, iterations);
+
+            auto start = std::chrono::steady_clock::now();
+            int ret = lua_pcall(L, 1, 0, 0);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            // decals are only recorded headless, drop them between runs
+            for (auto &layer : app->GetLayers())
+                layer.vecDecalInstance.clear();
+
+            if (ret != LUA_OK) {
+                std::fprintf(stderr, "%s: %s\n", test.name, lua_tostring(L, -1));
+                samples.clear();
+                break;
+            }
+
+            // the first run only warms up
+            if (r >= 0)
+                samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / double(iterations));
+        }
+
+        lua_settop(L, loop - 1);
+        lua_gc(L, LUA_GCCOLLECT);
+        return samples;
+    }
+
+    void WriteJson(std::FILE *out, const std::vector<BenchResult> &results, long iterations, int repeat) {
+        std::fprintf(out, "{\n  \"iterations\": %ld,\n  \"repeat\": %d,\n  \"results\": [\n", iterations, repeat);
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult &r = results[i];
+            std::fprintf(out, "    {\"name\": \"%s\", \"category\": \"%s\", \"ns_per_call\": %.3f, \"ns_min\": %.3f, \"overhead_ns\": %.3f}%s\n",
+                         r.test->name, r.test->category, r.nsPerCall, r.nsMin, r.overhead,
+                         i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    long iterations = 1000000;
+    int repeat = 5;
+    const char *filter = nullptr;
+    const char *jsonPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = std::max(1L, std::atol(argv[++i]));
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+            jsonPath = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: %s [--iterations N] [--repeat R] [--filter text] [--json file|-]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    auto app = new PGEApp::_::App();
+
+    // headless screen, layer 0 is the draw target like in the demo
+    app->Construct(app->GetScreenWidth(), app->GetScreenHeight(), 1, 1);
+    app->CreateLayer();
+    app->SetDrawTarget(nullptr);
+
+    lua_State *L = app->GetLuaState();
+    lua_register(L, "noop", Noop);
+
+    std::vector<BenchResult> results;
+    for (const BenchCase &test : Cases) {
+        bool isBaseline = test.baseline == nullptr;
+        if (filter && !isBaseline && !std::strstr(test.name, filter))
+            continue;
+
+        std::vector<double> samples = RunCase(app, L, test, iterations, repeat);
+        if (samples.empty())
+            continue;
+
+        std::sort(samples.begin(), samples.end());
+
+        BenchResult result = {&test, samples[samples.size() / 2], samples.front(), 0.0};
+        if (!isBaseline) {
+            for (const BenchResult &base : results) {
+                if (!std::strcmp(base.test->name, test.baseline))
+                    result.overhead = result.nsPerCall - base.nsPerCall;
+            }
+        }
+        results.push_back(result);
+    }
+
+    // with --json - stdout carries only the JSON
+    std::FILE *table = jsonPath && !std::strcmp(jsonPath, "-") ? stderr : stdout;
+    std::fprintf(table, "%-32s %-10s %12s %12s %12s\n", "binding", "category", "ns/call", "min", "overhead");
+    for (const BenchResult &r : results)
+        std::fprintf(table, "%-32s %-10s %12.2f %12.2f %12.2f\n", r.test->name, r.test->category, r.nsPerCall, r.nsMin, r.overhead);
+
+    if (jsonPath) {
+        std::FILE *out = std::strcmp(jsonPath, "-") ? std::fopen(jsonPath, "w") : stdout;
+        if (out == nullptr) {
+            std::fprintf(stderr, "cannot write %s\n", jsonPath);
+        } else {
+            WriteJson(out, results, iterations, repeat);
+            if (out != stdout)
+                std::fclose(out);
+        }
+    }
+
+    delete app;
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Job system scaling benchmark
+//
+// Runs the same workloads on job systems of 1 to N threads and prints
+// the median time of each with its speedup over one thread. "axpy"
+// and "tint" are the built in Lua kernels and mostly measure memory
+// bandwidth, "heavy" is compute bound, "graph" is a layered task graph
+// where every task depends on two tasks of the layer before.
+//
+//   PGE_JobsBench [--threads N] [--size N] [--repeat R]
+
+#define OLC_PGE_APPLICATION
+#include "olcPixelGameEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "JobKernels.h"
+
+namespace {
+    using PGEApp::Buffer;
+
+    struct Workload {
+        const char *name;
+        std::function<void(olc::JobSystem &)> run;
+    };
+
+    Buffer MakeBuffer(Buffer::Type type, std::vector<uint32_t> &storage) {
+        Buffer buffer{};
+        buffer.type = type;
+        buffer.length = storage.size();
+        buffer.data = (uint8_t *) storage.data();
+        buffer.sprite = nullptr;
+        buffer.heap = nullptr;
+        return buffer;
+    }
+
+    void RunKernel(olc::JobSystem &jobs, const char *name, std::vector<Buffer *> buffers, std::vector<double> numbers) {
+        const PGEApp::JobKernel *kernel = PGEApp::JobKernels::Get().Find(name);
+        jobs.ParallelFor(0, buffers[0]->length, kernel->grain, [&](size_t first, size_t last) {
+            kernel->fn(buffers.data(), numbers.data(), first, last);
+        });
+    }
+
+    float Heavy(float x) {
+        for (int k = 0; k < 32; k++)
+            x = std::sin(x) * 0.5f + std::cos(x * 1.5f);
+        return x;
+    }
+
+    double TimeMs(olc::JobSystem &jobs, const Workload &workload, int repeat) {
+        workload.run(jobs);
+
+        std::vector<double> samples;
+        for (int r = 0; r < repeat; r++) {
+            auto start = std::chrono::steady_clock::now();
+            workload.run(jobs);
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t size = 1 << 22;
+    int repeat = 9;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            maxThreads = uint32_t(std::max(1, std::atoi(argv[++i])));
+        else if (!std::strcmp(argv[i], "--size") && i + 1 < argc)
+            size = size_t(std::max(1L, std::atol(argv[++i])));
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "usage: %s [--threads N] [--size N] [--repeat R]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<uint32_t> ys(size), xs(size), pixels(size, 0xff808080);
+    std::vector<float> heavy(size / 16);
+    for (size_t i = 0; i < size; i++) {
+        float y = 1.0f, x = float(i % 100) * 0.01f;
+        std::memcpy(&ys[i], &y, 4);
+        std::memcpy(&xs[i], &x, 4);
+    }
+    Buffer y = MakeBuffer(Buffer::F32, ys), x = MakeBuffer(Buffer::F32, xs), p = MakeBuffer(Buffer::RGBA, pixels);
+
+    // 16 layers of 64 tasks, each layer waits on its neighbours in the one before
+    const size_t layers = 16, width = 64;
+    std::vector<float> cells(layers * width, 1.0f);
+    olc::TaskGraph graph;
+    for (size_t l = 0; l < layers; l++) {
+        for (size_t w = 0; w < width; w++) {
+            auto id = graph.Add([&cells, l, w, width]() {
+                float v = cells[l * width + w];
+                for (int k = 0; k < 64; k++)
+                    v = Heavy(v);
+                cells[l * width + w] = v;
+            });
+            if (l > 0) {
+                graph.Precede(olc::TaskGraph::TaskId((l - 1) * width + w), id);
+                graph.Precede(olc::TaskGraph::TaskId((l - 1) * width + (w + 1) % width), id);
+            }
+        }
+    }
+
+    const Workload workloads[] = {
+            {"axpy",  [&](olc::JobSystem &jobs) { RunKernel(jobs, "axpy", {&y, &x}, {0.001}); }},
+            {"tint",  [&](olc::JobSystem &jobs) { RunKernel(jobs, "tint", {&p}, {255, 255, 255, 255}); }},
+            {"heavy", [&](olc::JobSystem &jobs) {
+                jobs.ParallelFor(0, heavy.size(), 1024, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++)
+                        heavy[i] = Heavy(float(i));
+                });
+            }},
+            {"graph", [&](olc::JobSystem &jobs) { graph.Run(jobs); }},
+    };
+
+    std::printf("%zu elements, median of %d runs\n\n", size, repeat);
+    std::printf("%-8s %8s %12s %10s %12s\n", "workload", "threads", "ms", "speedup", "efficiency");
+
+    for (const Workload &workload : workloads) {
+        double baseMs = 0.0;
+        for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+            olc::JobSystem jobs(threads);
+            double ms = TimeMs(jobs, workload, repeat);
+            if (threads == 1)
+                baseMs = ms;
+
+            double speedup = baseMs / ms;
+            std::printf("%-8s %8u %12.3f %9.2fx %11.0f%%\n", workload.name, threads, ms, speedup, 100.0 * speedup / threads);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Span cache consistency check
+//
+// MASK-mode blits of a span-cached sprite copy its cached opaque runs.
+// Every engine write into such a sprite has to mark the cache stale, or
+// the next blit copies pixels that are no longer opaque and skips ones
+// that now are. Each case draws into a span-cached target with one pixel
+// mode, MASK-blits the target and compares the result with a per-pixel
+// MASK blit of the same pixels. Exits non-zero on a mismatch.
+//
+//   PGE_SpanCheck
+
+#include <cstdio>
+#include <cstdlib>
+
+#define OLC_PGE_APPLICATION
+
+#include "olcPixelGameEngine.h"
+
+namespace {
+    class Engine : public olc::PixelGameEngine {
+    public:
+        bool OnUserCreate() override { return true; }
+    };
+
+    // Opaque and transparent columns, so the target starts out with several runs
+    void FillPattern(olc::Sprite &sprite) {
+        for (int32_t y = 0; y < sprite.height; y++)
+            for (int32_t x = 0; x < sprite.width; x++)
+                sprite.SetPixel(x, y, (x / 3 + y) % 2 ? olc::Pixel(200, 40, 40, 255) : olc::Pixel(0, 0, 0, 0));
+    }
+
+    // Returns the number of pixels that differ from a per-pixel MASK blit
+    int CheckMode(Engine &engine, olc::Pixel::Mode mode, olc::Pixel source, const char *name) {
+        olc::Sprite target(16, 8);
+        FillPattern(target);
+        target.EnableSpanCache();
+
+        olc::Sprite output(16, 8);
+
+        // first blit builds the cache
+        engine.SetDrawTarget(&output);
+        engine.SetPixelMode(olc::Pixel::MASK);
+        engine.DrawSprite(0, 0, &target);
+
+        engine.SetDrawTarget(&target);
+        engine.SetPixelMode(mode);
+        engine.FillRect(2, 1, 9, 5, source);
+
+        engine.SetDrawTarget(&output);
+        engine.Clear(olc::Pixel(0, 0, 0, 0));
+        engine.SetPixelMode(olc::Pixel::MASK);
+        engine.DrawSprite(0, 0, &target);
+
+        int errors = 0;
+        for (int32_t y = 0; y < target.height; y++) {
+            for (int32_t x = 0; x < target.width; x++) {
+                olc::Pixel p = target.GetPixel(x, y);
+                olc::Pixel expected = p.a == 255 ? p : olc::Pixel(0, 0, 0, 0);
+                if (output.GetPixel(x, y) != expected)
+                    errors++;
+            }
+        }
+
+        std::printf("%-14s %s (%d mismatched pixels)\n", name, errors == 0 ? "ok" : "FAILED", errors);
+        return errors;
+    }
+}
+
+int main() {
+    Engine engine;
+    engine.Construct(16, 8, 1, 1);
+
+    int errors = 0;
+    errors += CheckMode(engine, olc::Pixel::NORMAL, olc::Pixel(20, 220, 20, 255), "normal");
+    errors += CheckMode(engine, olc::Pixel::ALPHA, olc::Pixel(20, 220, 20, 128), "alpha");
+    errors += CheckMode(engine, olc::Pixel::PREMULTIPLIED, olc::Pixel(20, 220, 20, 255), "premultiplied");
+
+    return errors == 0 ? 0 : 1;
+}
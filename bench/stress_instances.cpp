@@ -0,0 +1,108 @@
+// Several engines in one process, each driven by its own thread
+//
+// Every thread builds a PGEApp::_::App (own Lua state, job system and
+// draw target, _pge.lua and game.lua must be in the working directory),
+// runs load / update / draw for a number of frames and destroys it again.
+// Each engine gets a different screen size and clear colour, and its Lua
+// state reads both back through the bindings, so a binding that reaches
+// the wrong engine shows up as a mismatch. Build with -fsanitize=thread
+// to also catch shared state that is not a mismatch yet.
+//
+//   PGE_InstancesStress [--instances N] [--frames N] [--rounds N]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "PGEApp.h"
+
+namespace {
+    // Headless builds decode no images, game.lua only needs sprites of some size
+    class BlankImageLoader : public olc::ImageLoader {
+    public:
+        olc::rcode LoadImageResource(olc::Sprite *spr, const std::string &, olc::ResourcePack *) override {
+            spr->width = 64;
+            spr->height = 64;
+            spr->pColData.assign(size_t(spr->width) * spr->height, olc::WHITE);
+            return olc::rcode::OK;
+        }
+
+        olc::rcode SaveImageResource(olc::Sprite *, const std::string &) override {
+            return olc::rcode::OK;
+        }
+    };
+
+    // Returns the number of mismatches seen by engine `id`
+    int RunInstance(int id, int frames) {
+        auto app = new PGEApp::_::App();
+        const int32_t width = 64 + id;
+        const uint8_t shade = uint8_t(16 + id % 224);
+        int errors = 0;
+
+        app->Construct(width, 48, 1, 1);
+        app->CreateLayer();
+        app->SetDrawTarget(nullptr);
+        app->OnUserCreate();
+
+        lua_State *L = app->GetLuaState();
+        for (int f = 0; f < frames && L != nullptr; f++) {
+            app->OnUserUpdate(1.0f / 60.0f);
+
+            lua_settop(L, 0);
+            lua_pushinteger(L, shade);
+            lua_setglobal(L, "stress_shade");
+            const char *check = "local g = PGE.graphics\n"
+                                "g.clear(stress_shade, 0, 0)\n"
+                                "return g.get_draw_target_width(), g.get_draw_target():get_pixel(0, 0)";
+            if (luaL_dostring(L, check) != LUA_OK) {
+                std::fprintf(stderr, "instance %d: %s\n", id, lua_tostring(L, -1));
+                errors++;
+                break;
+            }
+
+            if (lua_tointeger(L, 1) != width || lua_tointeger(L, 2) != shade)
+                errors++;
+            lua_settop(L, 0);
+        }
+
+        app->OnUserDestroy();
+        delete app;
+        return errors;
+    }
+}
+
+int main(int argc, char **argv) {
+    int instances = int(std::max(2u, std::thread::hardware_concurrency()));
+    int frames = 120;
+    int rounds = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--instances") && i + 1 < argc)
+            instances = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--rounds") && i + 1 < argc)
+            rounds = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "usage: %s [--instances N] [--frames N] [--rounds N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    olc::Sprite::loader = std::make_unique<BlankImageLoader>();
+
+    std::atomic<int> errors{0};
+    for (int round = 0; round < rounds; round++) {
+        std::vector<std::thread> threads;
+        for (int id = 0; id < instances; id++)
+            threads.emplace_back([&errors, id, frames]() { errors += RunInstance(id, frames); });
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    std::printf("%d instances x %d rounds x %d frames, %d mismatches\n", instances, rounds, frames, errors.load());
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+function _pge_error(msg)
+    print(msg)
+end
+
+function _pge_config()
+    if config then
+        return config()
+    else
+        return {
+            title = "PGE",
+            screen_width = 256,
+            screen_height = 240,
+            screen_x_scale = 2,
+            screen_y_scale = 2
+        }
+    end
+end
+
+function _pge_load()
+    load()
+end
+
+function _pge_update(dt)
+    if update then
+        update(dt)
+    end
+end
+
+-- only called with a `fixed_timestep` in the config, dt is always 1 / tick_rate
+function _pge_fixed_update(dt)
+    if fixed_update then
+        fixed_update(dt)
+    end
+end
+
+-- alpha is how far the frame is between the last two fixed ticks, 1 without fixed steps
+function _pge_draw(alpha)
+    if draw then
+        draw(alpha)
+    end
+end
+
+function _pge_on_destroy()
+    if on_destroy then
+        on_destroy()
+    end
+end
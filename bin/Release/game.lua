@@ -0,0 +1,227 @@
+function config()
+    return {
+        title = "Breakout!",
+        screen_width = 512,
+        screen_height = 480,
+        screen_x_scale = 1,
+        screen_y_scale = 1,
+        -- collect garbage after update while the frame has time left
+        gc = {
+            mode = "generational",
+            frame_budget_ms = 16
+        },
+        -- sleep between frames instead of spinning, slower while in the background
+        frame_limit = {
+            fps = 60,
+            unfocused_fps = 10
+        },
+        -- the ball moves in fixed ticks so slow frames cannot push it through a block
+        fixed_timestep = {
+            tick_rate = 120,
+            max_steps = 8
+        },
+        -- threads shared by particles, large fills and PGE.jobs, 0 uses every core
+        jobs = {
+            threads = 0
+        },
+        -- threads running PGE.worker scripts, 0 uses every core but the engine's
+        workers = {
+            threads = 0
+        },
+        -- F9 starts/stops the Lua profiler, stopping writes profile.folded and profile.txt
+        profiler = {
+            key = PGE.input.Key.F9,
+            interval = 1000
+        }
+    }
+end
+
+local g = PGE.graphics
+local i = PGE.input
+
+local bat_pos = 20
+local bat_width = 40
+local bat_speed = 25
+
+local ball_pos = {x = 0, y = 0}
+-- position at the previous tick, draw() interpolates from it
+local ball_prev = {x = 0, y = 0}
+local ball_dir = {x = 0, y = 0}
+local ball_speed = 20
+local ball_radius = 5
+
+local block_size = {w = 16, h = 16}
+local blocks = {}
+local spr_tile = nil
+local tiles = nil
+local dec_fragment = nil
+
+local fragments = nil
+local fragment_emitters = {}
+
+-- block value -> atlas tile drawn for it (0 is empty)
+local block_tiles = {[10] = 1, [1] = 2, [2] = 3, [3] = 4}
+
+local function set_block(idx, v)
+    blocks[idx] = v
+    if tiles then
+        local x, y = (idx - 1) % 24, (idx - 1) // 24
+        tiles:set(x, y, block_tiles[v] or 0)
+    end
+end
+
+function load()
+    print("Version: " .. PGE.MajorVersion .. "." .. PGE.MinorVersion)
+    print("  Screen width " .. PGE.window.screen_width())
+    print("  Screen height " .. PGE.window.screen_height())
+
+    for y = 1, 30 do
+        for x = 1, 24 do
+            local idx = (y - 1) * 24 + x
+
+            if x == 1 or y == 1 or x == 24 then
+                blocks[idx] = 10
+            else
+                blocks[idx] = 0
+            end
+
+            if x > 3 and x <= 21 and y > 4 and y <= 6 then
+                blocks[idx] = 1
+            elseif x > 3 and x <= 21 and y > 6 and y <= 8 then
+                blocks[idx] = 2
+            elseif x > 3 and x <= 21 and y > 8 and y <= 10 then
+                blocks[idx] = 3
+            end
+        end
+    end
+
+    -- load the sprite, tiles are drawn in mask mode so cache their opaque runs
+    spr_tile = g.load_sprite("./assets/tut_tiles.png")
+    g.enable_span_cache(spr_tile)
+
+    -- tile map cell (0, 0) is block 1 and is drawn at (block_size.w, block_size.h)
+    -- the board only changes when a block is hit, keep it cached and let set() redraw those cells
+    tiles = g.create_tilemap(24, 30, spr_tile, block_size.w, block_size.h)
+    tiles:enable_cache()
+    for idx, v in ipairs(blocks) do
+        set_block(idx, v)
+    end
+
+    -- load fragment sprite
+    local spr_frag = g.load_sprite("./assets/tut_fragment.png")
+    -- create decal of fragment
+    dec_fragment = g.create_decal(spr_frag)
+
+    -- fragments live in tile units, like the ball
+    fragments = PGE.particles.create(dec_fragment)
+    fragments:set_gravity(0, 20)
+    local fragment_colors = {{255, 0, 0}, {0, 255, 0}, {255, 255, 0}}
+    for id, color in ipairs(fragment_colors) do
+        fragment_emitters[id] = PGE.particles.emitter({
+            count = 100,
+            speed = {0, 10},
+            direction = {0, 2 * 3.14159},
+            spin = 5,
+            life = 3,
+            color = color
+        })
+    end
+
+    -- start ball
+    local angle = math.random() * 2 * 3.14159
+    angle = -0.4
+    ball_dir.x, ball_dir.y = math.cos(angle), math.sin(angle)
+    ball_pos.x, ball_pos.y = 12.5, 12.5
+    ball_prev.x, ball_prev.y = ball_pos.x, ball_pos.y
+end
+
+function fixed_update(dt)
+    ball_prev.x, ball_prev.y = ball_pos.x, ball_pos.y
+
+    -- a better collision detection
+    -- calculate where ball should be, if no collision
+    local potential_ball_pos = {
+        x = ball_pos.x + ball_dir.x * ball_speed * dt,
+        y = ball_pos.y + ball_dir.y * ball_speed * dt
+    }
+
+    -- test for hits 4 points around ball
+    local tile_ball_radial_dims = {
+        x = ball_radius / block_size.w,
+        y = ball_radius / block_size.h
+    }
+
+    local test_resolve_collision_point = function(point, info)
+        local test_point = {
+            x = math.floor(potential_ball_pos.x + tile_ball_radial_dims.x * point.x),
+            y = math.floor(potential_ball_pos.y + tile_ball_radial_dims.y * point.y)
+        }
+
+        local tile_idx = (test_point.y - 1) * 24 + test_point.x
+        local tile = blocks[tile_idx]
+        if not tile or tile == 0 then
+            return false
+        else
+            -- ball has collided with a tile
+            local tile_hit = tile < 10
+            if tile_hit then
+                info.id = tile
+                info.hit_pos = {
+                    x = test_point.x,
+                    y = test_point.y
+                }
+                set_block(tile_idx, tile - 1)
+            end
+
+            -- collision response
+            if point.x == 0 then
+                ball_dir.y = ball_dir.y * -1
+            end
+
+            if point.y == 0 then
+                ball_dir.x = ball_dir.x * -1
+            end
+
+            return tile_hit
+        end
+    end
+
+    local has_hit_tile = false
+    local info = {}
+    has_hit_tile = test_resolve_collision_point({x = 0, y = -1}, info) or has_hit_tile
+    has_hit_tile = test_resolve_collision_point({x = 0, y = 1}, info) or has_hit_tile
+    has_hit_tile = test_resolve_collision_point({x = -1, y = 0}, info) or has_hit_tile
+    has_hit_tile = test_resolve_collision_point({x = 1, y = 0}, info) or has_hit_tile
+
+    if has_hit_tile then
+        fragments:emit(fragment_emitters[info.id], info.hit_pos.x + 0.5, info.hit_pos.y + 0.5)
+    end
+
+    -- fake floor
+    if ball_pos.y > 20 then
+        ball_dir.y = ball_dir.y * -1
+    end
+
+    -- actually update ball position with modified direction
+    ball_pos.x, ball_pos.y = ball_pos.x + ball_dir.x * ball_speed * dt, ball_pos.y + ball_dir.y * ball_speed * dt
+
+    fragments:update(dt)
+end
+
+function draw(alpha)
+    -- erase previous frame
+    g.clear(0, 0, 128)
+    g.set_pixel_mode(g.PixelMode.Mask)
+
+    tiles:draw(block_size.w, block_size.h)
+
+    g.set_pixel_mode(g.PixelMode.Normal)
+
+    -- draw ball between the last two ticks
+    local x = ball_prev.x + (ball_pos.x - ball_prev.x) * alpha
+    local y = ball_prev.y + (ball_pos.y - ball_prev.y) * alpha
+    g.fill_circle(x * block_size.w, y * block_size.h, ball_radius, 0, 255, 255)
+
+    -- draw fragments
+    fragments:draw(0, 0, block_size.w)
+end
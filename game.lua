@@ -4,7 +4,35 @@ function config()
         screen_width = 512,
         screen_height = 480,
         screen_x_scale = 1,
-        screen_y_scale = 1
+        screen_y_scale = 1,
+        -- collect garbage after update while the frame has time left
+        gc = {
+            mode = "generational",
+            frame_budget_ms = 16
+        },
+        -- sleep between frames instead of spinning, slower while in the background
+        frame_limit = {
+            fps = 60,
+            unfocused_fps = 10
+        },
+        -- the ball moves in fixed ticks so slow frames cannot push it through a block
+        fixed_timestep = {
+            tick_rate = 120,
+            max_steps = 8
+        },
+        -- threads shared by particles, large fills and PGE.jobs, 0 uses every core
+        jobs = {
+            threads = 0
+        },
+        -- threads running PGE.worker scripts, 0 uses every core but the engine's
+        workers = {
+            threads = 0
+        },
+        -- F9 starts/stops the Lua profiler, stopping writes profile.folded and profile.txt
+        profiler = {
+            key = PGE.input.Key.F9,
+            interval = 1000
+        }
     }
 end
 
@@ -16,6 +44,8 @@ local bat_width = 40
 local bat_speed = 25
 
 local ball_pos = {x = 0, y = 0}
+-- position at the previous tick, draw() interpolates from it
+local ball_prev = {x = 0, y = 0}
 local ball_dir = {x = 0, y = 0}
 local ball_speed = 20
 local ball_radius = 5
@@ -23,9 +53,22 @@ local ball_radius = 5
 local block_size = {w = 16, h = 16}
 local blocks = {}
 local spr_tile = nil
+local tiles = nil
 local dec_fragment = nil
 
-local list_fragments = {}
+local fragments = nil
+local fragment_emitters = {}
+
+-- block value -> atlas tile drawn for it (0 is empty)
+local block_tiles = {[10] = 1, [1] = 2, [2] = 3, [3] = 4}
+
+local function set_block(idx, v)
+    blocks[idx] = v
+    if tiles then
+        local x, y = (idx - 1) % 24, (idx - 1) // 24
+        tiles:set(x, y, block_tiles[v] or 0)
+    end
+end
 
 function load()
     print("Version: " .. PGE.MajorVersion .. "." .. PGE.MinorVersion)
@@ -52,22 +95,49 @@ function load()
         end
     end
 
-    -- load the sprite
+    -- load the sprite, tiles are drawn in mask mode so cache their opaque runs
     spr_tile = g.load_sprite("./assets/tut_tiles.png")
+    g.enable_span_cache(spr_tile)
+
+    -- tile map cell (0, 0) is block 1 and is drawn at (block_size.w, block_size.h)
+    -- the board only changes when a block is hit, keep it cached and let set() redraw those cells
+    tiles = g.create_tilemap(24, 30, spr_tile, block_size.w, block_size.h)
+    tiles:enable_cache()
+    for idx, v in ipairs(blocks) do
+        set_block(idx, v)
+    end
 
     -- load fragment sprite
     local spr_frag = g.load_sprite("./assets/tut_fragment.png")
     -- create decal of fragment
     dec_fragment = g.create_decal(spr_frag)
 
+    -- fragments live in tile units, like the ball
+    fragments = PGE.particles.create(dec_fragment)
+    fragments:set_gravity(0, 20)
+    local fragment_colors = {{255, 0, 0}, {0, 255, 0}, {255, 255, 0}}
+    for id, color in ipairs(fragment_colors) do
+        fragment_emitters[id] = PGE.particles.emitter({
+            count = 100,
+            speed = {0, 10},
+            direction = {0, 2 * 3.14159},
+            spin = 5,
+            life = 3,
+            color = color
+        })
+    end
+
     -- start ball
     local angle = math.random() * 2 * 3.14159
     angle = -0.4
     ball_dir.x, ball_dir.y = math.cos(angle), math.sin(angle)
     ball_pos.x, ball_pos.y = 12.5, 12.5
+    ball_prev.x, ball_prev.y = ball_pos.x, ball_pos.y
 end
 
-function update(dt)
+function fixed_update(dt)
+    ball_prev.x, ball_prev.y = ball_pos.x, ball_pos.y
+
     -- a better collision detection
     -- calculate where ball should be, if no collision
     local potential_ball_pos = {
@@ -100,7 +170,7 @@ function update(dt)
                     x = test_point.x,
                     y = test_point.y
                 }
-                blocks[tile_idx] = tile - 1
+                set_block(tile_idx, tile - 1)
             end
 
             -- collision response
@@ -124,31 +194,7 @@ function update(dt)
     has_hit_tile = test_resolve_collision_point({x = 1, y = 0}, info) or has_hit_tile
 
     if has_hit_tile then
-        for i = 1, 100 do
-            local f = {
-                pos = {
-                    x = info.hit_pos.x + 0.5,
-                    y = info.hit_pos.y + 0.5
-                }
-            }
-            local angle = math.random() * 2 * 3.14159
-            local velocity = math.random() * 10
-            f.vel = {
-                x = velocity * math.cos(angle),
-                y = velocity * math.sin(angle)
-            }
-            f.angle = angle
-            f.time = 3
-            if info.id == 1 then
-                f.color = {r = 255, g = 0, b = 0, a = 255}
-            elseif info.id == 2 then
-                f.color = {r = 0, g = 255, b = 0, a = 255}
-            elseif info.id == 3 then
-                f.color = {r = 255, g = 255, b = 0, a = 255}
-            end
-
-            list_fragments[#list_fragments + 1] = f
-        end
+        fragments:emit(fragment_emitters[info.id], info.hit_pos.x + 0.5, info.hit_pos.y + 0.5)
     end
 
     -- fake floor
@@ -159,96 +205,23 @@ function update(dt)
     -- actually update ball position with modified direction
     ball_pos.x, ball_pos.y = ball_pos.x + ball_dir.x * ball_speed * dt, ball_pos.y + ball_dir.y * ball_speed * dt
 
-    local remove_idx = {}
-    -- update list_fragments
-    for i, f in ipairs(list_fragments) do
-        f.vel.y = f.vel.y + 20 * dt
-        f.pos.x, f.pos.y = f.pos.x + f.vel.x * dt, f.pos.y + f.vel.y * dt
-        f.angle = f.angle + 5 * dt
-        f.time = f.time - dt
-        f.color.a = math.floor(f.time / 3 * 255)
-
-        if f.time < 0 then
-            remove_idx[#remove_idx + 1] = i
-        end
-    end
-
-    -- remove dead fragments
-    for i, idx in ipairs(remove_idx) do
-        table.remove(list_fragments, idx)
-    end
+    fragments:update(dt)
+end
 
+function draw(alpha)
     -- erase previous frame
     g.clear(0, 0, 128)
     g.set_pixel_mode(g.PixelMode.Mask)
 
-    for y = 1, 30 do
-        for x = 1, 24 do
-            local v = blocks[(y - 1) * 24 + x]
-            if v == 10 then
-                g.draw_partial_sprite(
-                    x * block_size.w,
-                    y * block_size.h,
-                    spr_tile,
-                    0 * block_size.w,
-                    0 * block_size.h,
-                    block_size.w,
-                    block_size.h
-                )
-            elseif v == 1 then
-                g.draw_partial_sprite(
-                    x * block_size.w,
-                    y * block_size.h,
-                    spr_tile,
-                    1 * block_size.w,
-                    0 * block_size.h,
-                    block_size.w,
-                    block_size.h
-                )
-            elseif v == 2 then
-                g.draw_partial_sprite(
-                    x * block_size.w,
-                    y * block_size.h,
-                    spr_tile,
-                    2 * block_size.w,
-                    0 * block_size.h,
-                    block_size.w,
-                    block_size.h
-                )
-            elseif v == 3 then
-                g.draw_partial_sprite(
-                    x * block_size.w,
-                    y * block_size.h,
-                    spr_tile,
-                    3 * block_size.w,
-                    0 * block_size.h,
-                    block_size.w,
-                    block_size.h
-                )
-            end
-        end
-    end
+    tiles:draw(block_size.w, block_size.h)
 
     g.set_pixel_mode(g.PixelMode.Normal)
 
-    -- draw ball
-    g.fill_circle(ball_pos.x * block_size.w, ball_pos.y * block_size.h, ball_radius, 0, 255, 255)
+    -- draw ball between the last two ticks
+    local x = ball_prev.x + (ball_pos.x - ball_prev.x) * alpha
+    local y = ball_prev.y + (ball_pos.y - ball_prev.y) * alpha
+    g.fill_circle(x * block_size.w, y * block_size.h, ball_radius, 0, 255, 255)
 
     -- draw fragments
-    for i, f in ipairs(list_fragments) do
-        g.draw_rotated_decal(
-            f.pos.x * block_size.w,
-            f.pos.y * block_size.h,
-            dec_fragment,
-            f.angle,
-            4,
-            4,
-            1,
-            1,
-            f.color.r,
-            f.color.g,
-            f.color.b,
-            f.color.a
-        )
-    end
+    fragments:draw(0, 0, block_size.w)
 end
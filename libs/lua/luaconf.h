@@ -745,8 +745,9 @@
 @@ LUA_EXTRASPACE defines the size of a raw memory area associated with
 ** a Lua state with very fast access.
 ** CHANGE it if you need a different size.
+** PGE keeps two pointers here: the profiler and the engine context.
 */
-#define LUA_EXTRASPACE		(sizeof(void *))
+#define LUA_EXTRASPACE		(2 * sizeof(void *))
 
 
 /*
@@ -345,6 +345,7 @@ int main()
 // O------------------------------------------------------------------------------O
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <iostream>
 #include <streambuf>
@@ -360,6 +361,10 @@ int main()
 #include <algorithm>
 #include <array>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #pragma endregion
 
 #define PGE_VER 217
@@ -400,6 +405,25 @@ int main()
 
 #define UNUSED(x) (void)(x)
 
+// SIMD paths for bulk pixel operations, a scalar path is always available
+#if !defined(OLC_NO_SIMD)
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define OLC_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
+
+// Frame phase timing zones, compiled in with OLC_PROFILE_ZONES
+#if defined(OLC_PROFILE_ZONES)
+	#define OLC_PROFILE_CONCAT_(a, b) a##b
+	#define OLC_PROFILE_CONCAT(a, b) OLC_PROFILE_CONCAT_(a, b)
+	#define OLC_PROFILE_ZONE(name) olc::profile::Zone OLC_PROFILE_CONCAT(olc_zone_, __LINE__)(name)
+	#define OLC_PROFILE_FRAME() olc::profile::EndFrame()
+#else
+	#define OLC_PROFILE_ZONE(name)
+	#define OLC_PROFILE_FRAME()
+#endif
+
 // O------------------------------------------------------------------------------O
 // | PLATFORM SELECTION CODE, Thanks slavka!                                      |
 // O------------------------------------------------------------------------------O
@@ -484,6 +508,8 @@ int main()
 		#include <X11/X.h>
 		#include <X11/Xlib.h>
 	}
+	#include <poll.h>
+	#include <cerrno>
 #endif
 
 #if defined(OLC_PLATFORM_GLUT)
@@ -527,7 +553,7 @@ namespace olc
 			struct { uint8_t r; uint8_t g; uint8_t b; uint8_t a; };
 		};
 
-		enum Mode { NORMAL, MASK, ALPHA, CUSTOM };
+		enum Mode { NORMAL, MASK, ALPHA, CUSTOM, PREMULTIPLIED };
 
 		Pixel();
 		Pixel(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = nDefaultAlpha);
@@ -751,10 +777,65 @@ namespace olc
 		Pixel* GetData();
 		olc::Sprite* Duplicate();
 		olc::Sprite* Duplicate(const olc::vi2d& vPos, const olc::vi2d& vSize);
+		// Converts straight alpha to premultiplied alpha in place, once
+		void Premultiply();
+		bool IsPremultiplied() const;
 		std::vector<olc::Pixel> pColData;
 		Mode modeSample = Mode::NORMAL;
 
 		static std::unique_ptr<olc::ImageLoader> loader;
+
+	public:
+		// Runs of fully opaque pixels, per row, used to accelerate MASK mode blits.
+		// The cache is rebuilt lazily after SetPixel(), GetData() or loading, if
+		// pColData is written directly call InvalidateSpanCache() afterwards
+		struct sSpan { int32_t nStart; int32_t nLength; };
+		void EnableSpanCache(bool bEnable = true);
+		bool HasSpanCache() const;
+		void InvalidateSpanCache();
+		const sSpan* GetRowSpans(int32_t y, const sSpan*& pEnd);
+
+	private:
+		void BuildSpanCache();
+		bool bPremultiplied = false;
+		bool bSpanCache = false;
+		bool bSpansDirty = true;
+		std::vector<sSpan> vSpans;
+		std::vector<uint32_t> vSpanRows;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::IndexedSprite - An image of 8-bit indices into a 256 colour palette     |
+	// O------------------------------------------------------------------------------O
+	class IndexedSprite
+	{
+	public:
+		IndexedSprite();
+		IndexedSprite(int32_t w, int32_t h);
+		IndexedSprite(const olc::IndexedSprite&) = delete;
+		~IndexedSprite();
+
+	public:
+		// Builds the index image and palette from an RGBA sprite, fails if
+		// the sprite uses more than 256 distinct colours
+		olc::rcode FromSprite(const olc::Sprite* spr);
+		olc::rcode LoadFromFile(const std::string& sImageFile, olc::ResourcePack* pack = nullptr);
+
+	public:
+		int32_t width = 0;
+		int32_t height = 0;
+		uint32_t nPaletteSize = 0;
+
+	public:
+		uint8_t GetIndex(int32_t x, int32_t y) const;
+		bool  SetIndex(int32_t x, int32_t y, uint8_t i);
+		Pixel GetPixel(int32_t x, int32_t y) const;
+		// Palette swaps recolour every pixel using that entry, for free
+		void  SetPaletteEntry(uint8_t i, Pixel p);
+		Pixel GetPaletteEntry(uint8_t i) const;
+		uint8_t* GetData();
+		std::vector<uint8_t> pIndexData;
+		std::array<olc::Pixel, 256> pPalette;
 	};
 
 	// O------------------------------------------------------------------------------O
@@ -773,6 +854,9 @@ namespace olc
 		int32_t id = -1;
 		olc::Sprite* sprite = nullptr;
 		olc::vf2d vUVScale = { 1.0f, 1.0f };
+		bool premultiplied = false;
+		// Engine whose renderer holds the texture, the one current when the decal was made
+		olc::PixelGameEngine* pEngine = nullptr;
 	};
 
 	enum class DecalMode
@@ -862,7 +946,7 @@ namespace olc
 		virtual void       ApplyTexture(uint32_t id) = 0;
 		virtual void       UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) = 0;
 		virtual void       ClearBuffer(olc::Pixel p, bool bDepth) = 0;
-		static olc::PixelGameEngine* ptrPGE;
+		olc::PixelGameEngine* ptrPGE = nullptr;
 	};
 
 	class Platform
@@ -878,16 +962,312 @@ namespace olc
 		virtual olc::rcode SetWindowTitle(const std::string& s) = 0;
 		virtual olc::rcode StartSystemEventLoop() = 0;
 		virtual olc::rcode HandleSystemEvent() = 0;
-		static olc::PixelGameEngine* ptrPGE;
+		// Blocks the engine thread until system events may be pending or the
+		// timeout passes. Platforms that deliver events on another thread just
+		// nap, the engine checks again when it returns.
+		virtual olc::rcode WaitSystemEvent(std::chrono::microseconds tTimeout)
+		{
+			std::this_thread::sleep_for(std::min<std::chrono::microseconds>(tTimeout, std::chrono::milliseconds(10)));
+			return olc::OK;
+		}
+		olc::PixelGameEngine* ptrPGE = nullptr;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::Renderer_Pipelined - Marshals renderer calls onto the render thread     |
+	// O------------------------------------------------------------------------------O
+	// Stands in for the renderer while the engine runs pipelined. Calls made on the
+	// render thread go straight through, calls from the simulation thread are queued
+	// and run between frames, in order. Texture creation, readback and deletion
+	// wait for their command, so ids are valid on return. That alone does not keep
+	// a decal alive for the frames that draw it, decals go through RetireDecal()
+	// for that. Uploads copy the sprite and return.
+	class Renderer_Pipelined : public olc::Renderer
+	{
+	public:
+		Renderer_Pipelined(std::unique_ptr<olc::Renderer> pRenderer);
+		// Hands the real renderer back, the queue must be empty
+		std::unique_ptr<olc::Renderer> Release();
+
+		// Runs fn under the queue lock and wakes every waiter
+		template<typename F> void Signal(F fn)
+		{
+			{ std::lock_guard<std::mutex> lock(mtxQueue); fn(); }
+			cvQueue.notify_all();
+		}
+
+		// Blocks until pred() holds, pred runs under the queue lock
+		template<typename P> void Wait(P pred)
+		{
+			std::unique_lock<std::mutex> lock(mtxQueue);
+			cvQueue.wait(lock, pred);
+		}
+
+		// Render thread only, runs queued commands while waiting for pred()
+		template<typename P> void ServeUntil(P pred)
+		{
+			std::unique_lock<std::mutex> lock(mtxQueue);
+			for (;;)
+			{
+				while (!qCommands.empty())
+				{
+					std::function<void()> fn = std::move(qCommands.front());
+					qCommands.pop_front();
+					lock.unlock();
+					fn();
+					lock.lock();
+				}
+				if (pred()) return;
+				cvQueue.wait(lock);
+			}
+		}
+
+	public:
+		void       PrepareDevice() override;
+		olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) override;
+		olc::rcode DestroyDevice() override;
+		void       DisplayFrame() override;
+		void       PrepareDrawing() override;
+		void	   SetDecalMode(const olc::DecalMode& mode) override;
+		void       DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) override;
+		void       DrawDecal(const olc::DecalInstance& decal) override;
+		uint32_t   CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) override;
+		void       UpdateTexture(uint32_t id, olc::Sprite* spr) override;
+		void       ReadTexture(uint32_t id, olc::Sprite* spr) override;
+		uint32_t   DeleteTexture(const uint32_t id) override;
+		void       ApplyTexture(uint32_t id) override;
+		void       UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override;
+		void       ClearBuffer(olc::Pixel p, bool bDepth) override;
+
+	private:
+		// Runs fn now on the render thread, otherwise queues it
+		void Post(std::function<void()> fn);
+		// Runs fn on the render thread and waits for it
+		void Call(std::function<void()> fn);
+
+	private:
+		std::unique_ptr<olc::Renderer> pRenderer;
+		std::thread::id idRenderThread;
+		std::mutex mtxQueue;
+		std::condition_variable cvQueue;
+		std::deque<std::function<void()>> qCommands;
 	};
 
 	class PGEX;
 
-	// The Static Twins (plus one)
-	static std::unique_ptr<Renderer> renderer;
-	static std::unique_ptr<Platform> platform;
+	// Key translation table, filled the same way by every platform instance
 	static std::map<size_t, uint8_t> mapKeys;
 
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameInfo - Where the last frame went, always measured                  |
+	// O------------------------------------------------------------------------------O
+	struct FrameInfo
+	{
+		// Phase durations in milliseconds
+		float fInputMs = 0.0f;
+		float fUpdateMs = 0.0f;
+		float fLayersMs = 0.0f;
+		float fDisplayMs = 0.0f;
+		// Decal instances submitted, layer quads + decals drawn
+		uint32_t nDecals = 0;
+		uint32_t nDrawCalls = 0;
+		uint64_t nUploadBytes = 0;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameHistogram - HDR style histogram of frame times                     |
+	// O------------------------------------------------------------------------------O
+	// Microsecond values below 2*SubBuckets are counted exactly, above that every
+	// power of two is split into SubBuckets linear buckets (about 3% precision),
+	// up to 2^40 us. Recording is a couple of shifts, percentiles walk the buckets.
+	class FrameHistogram
+	{
+	public:
+		static constexpr uint32_t SubBucketBits = 5;
+		static constexpr uint32_t SubBuckets = 1 << SubBucketBits;
+		static constexpr uint32_t MaxBits = 40;
+		static constexpr uint32_t BucketCount = 2 * SubBuckets + (MaxBits - SubBucketBits - 1) * SubBuckets;
+
+	public:
+		FrameHistogram();
+		void Record(std::chrono::microseconds tFrame);
+		void Reset();
+		// Frames longer than the budget are counted as over budget
+		void SetBudget(std::chrono::microseconds tBudget);
+
+	public:
+		uint64_t Count() const;
+		uint64_t CountOverBudget() const;
+		// Times in milliseconds, 0 when nothing was recorded
+		double Percentile(double p) const;
+		double Mean() const;
+		double Min() const;
+		double Max() const;
+		double Budget() const;
+
+	private:
+		static uint32_t BucketOf(uint64_t us);
+		// Highest value that lands in bucket i
+		static uint64_t BucketHigh(uint32_t i);
+
+	private:
+		std::vector<uint64_t> vBuckets;
+		uint64_t nCount = 0;
+		uint64_t nOverBudget = 0;
+		uint64_t nTotalUs = 0;
+		uint64_t nMinUs = UINT64_MAX;
+		uint64_t nMaxUs = 0;
+		uint64_t nBudgetUs = 16667;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameLimiter - Paces the engine loop to a target frame rate             |
+	// O------------------------------------------------------------------------------O
+	// Waits for each frame deadline by sleeping in 1 ms steps while the remaining
+	// time is above the expected cost of a sleep (mean + stddev of the measured
+	// sleeps), then yield-spins the last part. Deadlines advance by a whole period
+	// so rounding does not drift, a frame that misses its deadline restarts pacing.
+	struct FramePacing
+	{
+		// Wakes more than this after the deadline count as late
+		static constexpr double LateUs = 1000.0;
+
+		// Frames that waited for their deadline
+		uint64_t nFrames = 0;
+		// Frames already past their deadline, these do not wait
+		uint64_t nOverruns = 0;
+		uint64_t nLate = 0;
+		// Wake time minus deadline, negative when woken early
+		double fErrorSumUs = 0.0;
+		double fAbsErrorSumUs = 0.0;
+		double fMaxErrorUs = 0.0;
+		// Time spent waiting
+		double fSleepMs = 0.0;
+		double fSpinMs = 0.0;
+
+		double MeanErrorUs() const { return nFrames ? fErrorSumUs / double(nFrames) : 0.0; }
+		double MeanAbsErrorUs() const { return nFrames ? fAbsErrorSumUs / double(nFrames) : 0.0; }
+	};
+
+	class FrameLimiter
+	{
+	public:
+		// Blocks until the next deadline at fFps, 0 returns at once
+		void Wait(float fFps);
+		// The next Wait starts a new pace instead of catching up
+		void Restart();
+		void ResetStats();
+		const FramePacing& GetStats() const;
+
+	private:
+		void RecordSleep(double fSeconds);
+
+	private:
+		FramePacing stats;
+		std::chrono::steady_clock::time_point tpDeadline;
+		std::chrono::steady_clock::duration tPeriod{ 0 };
+		// Running estimate of how long a 1 ms sleep really takes
+		double fSleepMean = 0.002;
+		double fSleepM2 = 0.0;
+		uint64_t nSleepSamples = 1;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::JobSystem - Work stealing thread pool                                   |
+	// O------------------------------------------------------------------------------O
+	// Every worker owns a deque, it pushes and pops its own jobs at the back and
+	// steals from the front of the others when it runs dry. Jobs submitted from
+	// outside the pool go to a shared queue. A thread waiting on a counter runs
+	// jobs instead of blocking, so jobs may submit and wait on further jobs.
+	class JobSystem
+	{
+	public:
+		// Counts unfinished jobs, Wait() returns once it is back at zero
+		struct Counter
+		{
+			std::atomic<uint32_t> nPending{ 0 };
+		};
+
+	public:
+		// Runs jobs on nThreads threads, the one waiting included, so nThreads - 1
+		// workers are started. 0 uses every hardware thread.
+		explicit JobSystem(uint32_t nThreads = 0);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// Workers plus the thread that waits
+		uint32_t ThreadCount() const;
+		void Submit(std::function<void()> fnJob, Counter* pCounter = nullptr);
+		void Wait(Counter& counter);
+		// Calls fn(nFirst, nLast) over [nBegin, nEnd) in chunks of at least nGrain
+		// elements, the calling thread takes part. Returns when every chunk ran.
+		void ParallelFor(size_t nBegin, size_t nEnd, size_t nGrain, const std::function<void(size_t, size_t)>& fn);
+
+	private:
+		struct Job
+		{
+			std::function<void()> fn;
+			Counter* pCounter = nullptr;
+		};
+
+		struct Queue
+		{
+			std::mutex mtx;
+			std::deque<Job> jobs;
+		};
+
+		void WorkerMain(uint32_t nIndex);
+		// Runs one job from the own queue, the shared queue or a victim
+		bool RunOne(uint32_t nIndex);
+		bool Pop(Queue& queue, bool bBack, Job& job);
+		uint32_t CurrentIndex() const;
+
+	private:
+		// One per worker, the last one takes jobs from outside the pool
+		std::vector<std::unique_ptr<Queue>> vQueues;
+		std::vector<std::thread> vWorkers;
+		std::atomic<bool> bRunning{ true };
+		std::atomic<uint32_t> nQueued{ 0 };
+		std::mutex mtxSleep;
+		std::condition_variable cvSleep;
+		// Signalled when a counter drops to zero, Wait() blocks on it once helping runs dry
+		std::mutex mtxDone;
+		std::condition_variable cvDone;
+	};
+
+	// O------------------------------------------------------------------------------O
+	// | olc::TaskGraph - Jobs with dependencies                                      |
+	// O------------------------------------------------------------------------------O
+	// A task is submitted once all tasks it depends on finished. The graph can be
+	// run again after it completed.
+	class TaskGraph
+	{
+	public:
+		using TaskId = uint32_t;
+
+		TaskId Add(std::function<void()> fnTask);
+		// Task b runs after task a
+		void Precede(TaskId a, TaskId b);
+		// Returns false without running anything when the dependencies form a cycle
+		bool Run(JobSystem& jobs);
+		void Clear();
+		size_t Size() const;
+
+	private:
+		void Launch(JobSystem& jobs, JobSystem::Counter& counter, TaskId id);
+
+	private:
+		struct Task
+		{
+			std::function<void()> fn;
+			std::vector<TaskId> vNext;
+			uint32_t nDepends = 0;
+		};
+		std::vector<Task> vTasks;
+		std::unique_ptr<std::atomic<uint32_t>[]> pPending;
+	};
+
 	// O------------------------------------------------------------------------------O
 	// | olc::PixelGameEngine - The main BASE class for your application              |
 	// O------------------------------------------------------------------------------O
@@ -949,6 +1329,43 @@ namespace olc
 		uint32_t GetFPS() const;
 		// Gets last update of elapsed time
 		float GetElapsedTime() const;
+		// Gets the distribution of frame times since start (or the last reset)
+		const olc::FrameHistogram& GetFrameHistogram() const;
+		// Gets the phase timings and counters of the last complete frame
+		const olc::FrameInfo& GetLastFrameInfo() const;
+		// Frames slower than this count as over budget, in seconds
+		void SetFrameBudget(float fBudget);
+		// Also resets the frame pacing stats
+		void ResetFrameStats();
+		// Caps the frame rate by waiting after each frame, 0 runs unlimited. The
+		// unfocused limit applies while the window has no input focus, 0 keeps
+		// the focused one. Not used on platforms that drive their own loop.
+		void SetFrameLimit(float fFps);
+		void SetUnfocusedFrameLimit(float fFps);
+		// Gets the limit in effect right now
+		float GetFrameLimit() const;
+		// Gets how closely frames hit their deadlines since start (or the last reset)
+		const olc::FramePacing& GetFramePacing() const;
+		// In reactive mode a frame only runs after input or a redraw request,
+		// otherwise the engine thread sleeps on the platform event queue.
+		// Like the frame limit it is not used on platforms with their own loop.
+		void SetReactive(bool bEnable);
+		bool IsReactive() const;
+		// Asks for a frame in fDelay seconds, the earliest request wins
+		void RequestRedraw(float fDelay = 0.0f);
+		// Frames skipped in reactive mode since start
+		uint64_t GetSkippedFrames() const;
+		// Runs OnUserUpdate for frame N+1 on a simulation thread while the engine
+		// thread uploads and presents frame N. Layers and decal lists are copied at
+		// the hand off, renderer calls from OnUserUpdate are marshalled to the
+		// engine thread. Set before Start(), reactive mode is ignored while on.
+		void SetPipelined(bool bEnable);
+		bool IsPipelined() const;
+		// Threads of the job system including the one waiting, 0 uses every
+		// hardware thread. Takes effect when the job system is first used.
+		void SetJobThreads(uint32_t nThreads);
+		// The engine's job system, started on first use
+		olc::JobSystem& GetJobs();
 		// Gets Actual Window size
 		const olc::vi2d& GetWindowSize() const;
 		// Gets pixel scale
@@ -974,6 +1391,7 @@ namespace olc
 		// olc::Pixel::NORMAL = No transparency
 		// olc::Pixel::MASK   = Transparent if alpha is < 255
 		// olc::Pixel::ALPHA  = Full transparency
+		// olc::Pixel::PREMULTIPLIED = Full transparency, source colour is premultiplied
 		void SetPixelMode(Pixel::Mode m);
 		Pixel::Mode GetPixelMode();
 		// Use a custom blend function
@@ -1015,6 +1433,10 @@ namespace olc
 		// selected area is (ox,oy) to (ox+w,oy+h)
 		void DrawPartialSprite(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1, uint8_t flip = olc::Sprite::NONE);
 		void DrawPartialSprite(const olc::vi2d& pos, Sprite* sprite, const olc::vi2d& sourcepos, const olc::vi2d& size, uint32_t scale = 1, uint8_t flip = olc::Sprite::NONE);
+		// Draws an entire indexed sprite at location (x,y), looking colours up in its palette
+		void DrawIndexedSprite(int32_t x, int32_t y, IndexedSprite* sprite, uint32_t scale = 1, uint8_t flip = olc::Sprite::NONE);
+		// Draws an area of an indexed sprite at location (x,y)
+		void DrawPartialIndexedSprite(int32_t x, int32_t y, IndexedSprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1, uint8_t flip = olc::Sprite::NONE);
 		// Draws a single line of text - traditional monospaced
 		void DrawString(int32_t x, int32_t y, const std::string& sText, Pixel col = olc::WHITE, uint32_t scale = 1);
 		void DrawString(const olc::vi2d& pos, const std::string& sText, Pixel col = olc::WHITE, uint32_t scale = 1);
@@ -1027,6 +1449,10 @@ namespace olc
 		// Decal Quad functions
 		void SetDecalMode(const olc::DecalMode& mode);
 		void SetDecalStructure(const olc::DecalStructure& structure);
+		olc::DecalStructure GetDecalStructure() const;
+		// Takes ownership of a decal nobody uses any more. Draws of it may still be
+		// queued, so it is deleted once the frame holding them has been presented.
+		void RetireDecal(olc::Decal* decal);
 		// Draws a whole decal, with optional scale and tinting
 		void DrawDecal(const olc::vf2d& pos, olc::Decal* decal, const olc::vf2d& scale = { 1.0f,1.0f }, const olc::Pixel& tint = olc::WHITE);
 		// Draws a region of a decal, with optional scale and tinting
@@ -1056,6 +1482,8 @@ namespace olc
 		void DrawPolygonDecal(olc::Decal* decal, const std::vector<olc::vf2d>& pos, const std::vector<olc::vf2d>& uv, const olc::Pixel tint = olc::WHITE);
 		void DrawPolygonDecal(olc::Decal* decal, const std::vector<olc::vf2d>& pos, const std::vector<float>& depth, const std::vector<olc::vf2d>& uv, const olc::Pixel tint = olc::WHITE);
 		void DrawPolygonDecal(olc::Decal* decal, const std::vector<olc::vf2d>& pos, const std::vector<olc::vf2d>& uv, const std::vector<olc::Pixel>& tint);
+		// Draws from caller owned arrays, a tint stride of 0 applies tint[0] to every point
+		void DrawPolygonDecal(olc::Decal* decal, const olc::vf2d* pos, const olc::vf2d* uv, const olc::Pixel* tint, uint32_t points, uint32_t tintStride = 1);
 
 		// Draws a line in Decal Space
 		void DrawLineDecal(const olc::vf2d& pos1, const olc::vf2d& pos2, Pixel p = olc::WHITE);
@@ -1133,7 +1561,34 @@ namespace olc
 		DecalMode   nDecalMode = DecalMode::NORMAL;
 		DecalStructure nDecalStructure = DecalStructure::FAN;
 		std::function<olc::Pixel(const int x, const int y, const olc::Pixel&, const olc::Pixel&)> funcPixelMode;
-		std::chrono::time_point<std::chrono::system_clock> m_tp1, m_tp2;
+		std::chrono::time_point<std::chrono::steady_clock> m_tp1, m_tp2;
+		olc::FrameHistogram frameHistogram;
+		olc::FrameInfo frameInfo;
+		// The first frame also spans OnUserCreate, it is kept out of the histogram
+		bool bFirstFrame = true;
+		olc::FrameLimiter frameLimiter;
+		float		fFrameLimit = 0.0f;
+		float		fUnfocusedFrameLimit = 0.0f;
+		// Reactive mode, the first frame always runs
+		bool		bReactive = false;
+		std::atomic<bool> bInputEvent{ true };
+		std::chrono::time_point<std::chrono::steady_clock> tpRedraw;
+		bool		bRedrawRequested = true;
+		uint64_t	nSkippedFrames = 0;
+		// Pipelined mode, the engine thread draws these copies of the layers
+		bool		bPipelined = false;
+		std::vector<LayerDesc> vRenderLayers;
+		// Decals handed to RetireDecal() since the last presented frame
+		std::mutex	mtxRetired;
+		std::vector<std::unique_ptr<olc::Decal>> vRetiredDecals;
+		// Pipelined mode, decals retired before the hand off of the frame being
+		// drawn, the engine thread frees them once that frame is presented
+		std::vector<std::unique_ptr<olc::Decal>> vRetiredCaptured;
+		uint32_t	nJobThreads = 0;
+		std::unique_ptr<olc::JobSystem> pJobs;
+		std::mutex	mtxJobs;
+		// Clears and opaque fills at least this large use the job system
+		static constexpr size_t nParallelFillPixels = 1 << 18;
 		std::vector<olc::vi2d> vFontSpacing;
 
 		// State of keyboard		
@@ -1149,10 +1604,30 @@ namespace olc
 		// The main engine thread
 		void		EngineThread();
 
+		// MASK mode fast path, copies the cached opaque runs of a sprite region
+		bool		DrawSpans(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h);
+		// NORMAL and MASK mode fast path, palette lookup blit of an indexed sprite region
+		bool		DrawIndexedRows(int32_t x, int32_t y, IndexedSprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h);
+
 
 		// If anything sets this flag to false, the engine
 		// "should" shut down gracefully
-		static std::atomic<bool> bAtomActive;
+		std::atomic<bool> bAtomActive{ false };
+
+	public: // Engine components, one set per instance
+		// Platform code and decals reach the renderer through the engine they belong to
+		std::unique_ptr<olc::Renderer> renderer;
+		std::unique_ptr<olc::Platform> platform;
+		// Bytes sent to textures by Decal::Update() so far, for frame statistics
+		std::atomic<uint64_t> nUploadBytes{ 0 };
+
+		// Makes this the engine of the calling thread, decals and extensions
+		// created or run on it belong to this engine. The engine does this for
+		// the threads it starts, hosts driving an engine from their own threads
+		// call it before touching the engine there.
+		void MakeCurrent();
+		// The engine of the calling thread, nullptr if there is none
+		static PixelGameEngine* GetCurrent();
 
 	public:
 		// "Break In" Functions
@@ -1162,6 +1637,18 @@ namespace olc
 		void olc_UpdateViewport();
 		void olc_ConstructFontSheet();
 		void olc_CoreUpdate();
+		// Parts of olc_CoreUpdate, shared with the pipelined loop
+		float olc_UpdateTiming();
+		void olc_UpdateInput();
+		void olc_UpdateUser(float fElapsedTime);
+		void olc_DrawLayers(std::vector<LayerDesc>& layers, olc::FrameInfo& info);
+		void olc_UpdateTitle(float fElapsedTime);
+		void olc_RunPipelined();
+		void olc_CaptureLayers();
+		// Deletes the retired decals, no queued draw may refer to them any more
+		void olc_FreeRetiredDecals();
+		// Returns when the next frame should run, false if it is not due yet
+		bool olc_WaitForFrame();
 		void olc_PrepareEngine();
 		void olc_UpdateMouseState(int32_t button, bool state);
 		void olc_UpdateKeyState(int32_t key, bool state);
@@ -1205,8 +1692,66 @@ namespace olc
 		virtual void OnAfterUserUpdate(float fElapsedTime);
 
 	protected:
-		static PixelGameEngine* pge;
+		// The engine current on the calling thread
+		static thread_local PixelGameEngine* pge;
 	};
+
+
+
+	// O------------------------------------------------------------------------------O
+	// | olc::profile - Scoped timing zones with per thread ring buffers              |
+	// O------------------------------------------------------------------------------O
+	// Zones are recorded when they close into a ring owned by the recording thread,
+	// so recording takes no locks. EndFrame() folds the zones the calling thread
+	// closed since the last frame into averages published every WindowFrames frames.
+	// Everything here is a no-op unless OLC_PROFILE_ZONES is defined.
+	namespace profile
+	{
+		static constexpr bool Enabled =
+#if defined(OLC_PROFILE_ZONES)
+			true;
+#else
+			false;
+#endif
+		static constexpr size_t RingCapacity = 1 << 16;
+		static constexpr uint32_t WindowFrames = 60;
+
+		struct ZoneEvent
+		{
+			// must outlive the profile, zone names are string literals
+			const char* name;
+			int64_t start;
+			int64_t end;
+		};
+
+		struct ZoneStats
+		{
+			const char* name;
+			double avgMs;
+			double maxMs;
+			double callsPerFrame;
+		};
+
+		class Zone
+		{
+		public:
+			explicit Zone(const char* name);
+			~Zone();
+		private:
+			const char* name;
+			int64_t start;
+		};
+
+		// Nanoseconds since the first zone of the process
+		int64_t Now();
+		void SetThreadName(const std::string& name);
+		void EndFrame();
+		// Averages over each thread's last complete window, zones of the same name
+		// on several threads are added up (max is the largest), slowest first
+		std::vector<ZoneStats> GetZoneStats();
+		// Every zone still in the rings as Chrome trace "complete" events (chrome://tracing, Perfetto)
+		bool WriteChromeTrace(const std::string& sFile);
+	}
 }
 
 #pragma endregion
@@ -1374,6 +1919,7 @@ namespace olc
 		if (x >= 0 && x < width && y >= 0 && y < height)
 		{
 			pColData[y * width + x] = p;
+			bSpansDirty = true;
 			return true;
 		}
 		else
@@ -1403,19 +1949,115 @@ namespace olc
 		olc::Pixel p3 = GetPixel(std::max(x, 0), std::min(y + 1, (int)height - 1));
 		olc::Pixel p4 = GetPixel(std::min(x + 1, (int)width - 1), std::min(y + 1, (int)height - 1));
 
+		// Premultiplied texels can be filtered including alpha without
+		// bleeding the colour of transparent neighbours into the edges
+		uint8_t a = nDefaultAlpha;
+		if (bPremultiplied)
+			a = (uint8_t)((p1.a * u_opposite + p2.a * u_ratio) * v_opposite + (p3.a * u_opposite + p4.a * u_ratio) * v_ratio);
+
 		return olc::Pixel(
 			(uint8_t)((p1.r * u_opposite + p2.r * u_ratio) * v_opposite + (p3.r * u_opposite + p4.r * u_ratio) * v_ratio),
 			(uint8_t)((p1.g * u_opposite + p2.g * u_ratio) * v_opposite + (p3.g * u_opposite + p4.g * u_ratio) * v_ratio),
-			(uint8_t)((p1.b * u_opposite + p2.b * u_ratio) * v_opposite + (p3.b * u_opposite + p4.b * u_ratio) * v_ratio));
+			(uint8_t)((p1.b * u_opposite + p2.b * u_ratio) * v_opposite + (p3.b * u_opposite + p4.b * u_ratio) * v_ratio), a);
 	}
 
 	Pixel* Sprite::GetData()
-	{ return pColData.data(); }
+	{ bSpansDirty = true; return pColData.data(); }
+
+	void Sprite::EnableSpanCache(bool bEnable)
+	{
+		bSpanCache = bEnable;
+		bSpansDirty = true;
+		if (!bEnable) { vSpans.clear(); vSpans.shrink_to_fit(); vSpanRows.clear(); vSpanRows.shrink_to_fit(); }
+	}
+
+	bool Sprite::HasSpanCache() const
+	{ return bSpanCache; }
+
+	void Sprite::InvalidateSpanCache()
+	{ bSpansDirty = true; }
+
+	const Sprite::sSpan* Sprite::GetRowSpans(int32_t y, const sSpan*& pEnd)
+	{
+		if (bSpansDirty) BuildSpanCache();
+		pEnd = vSpans.data() + vSpanRows[y + 1];
+		return vSpans.data() + vSpanRows[y];
+	}
+
+	void Sprite::BuildSpanCache()
+	{
+		vSpans.clear();
+		vSpanRows.resize(height + 1);
+		for (int32_t y = 0; y < height; y++)
+		{
+			vSpanRows[y] = uint32_t(vSpans.size());
+			const Pixel* row = pColData.data() + y * width;
+			int32_t x = 0;
+			while (x < width)
+			{
+				while (x < width && row[x].a != 255) x++;
+				int32_t nStart = x;
+				while (x < width && row[x].a == 255) x++;
+				if (x > nStart) vSpans.push_back({ nStart, x - nStart });
+			}
+		}
+		vSpanRows[height] = uint32_t(vSpans.size());
+		bSpansDirty = false;
+	}
+
+	bool Sprite::IsPremultiplied() const
+	{ return bPremultiplied; }
+
+	void Sprite::Premultiply()
+	{
+		if (bPremultiplied) return;
+		bPremultiplied = true;
+
+		// c' = c * a / 255, rounded, alpha channel is left untouched
+		uint8_t* p = (uint8_t*)pColData.data();
+		size_t nPixels = pColData.size();
+		size_t i = 0;
+
+#if defined(OLC_SIMD_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi16(128);
+		const __m128i keepAlpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+		for (; i + 4 <= nPixels; i += 4)
+		{
+			__m128i px = _mm_loadu_si128((const __m128i*)(p + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(px, zero);
+			__m128i hi = _mm_unpackhi_epi8(px, zero);
+
+			// Broadcast alpha across each pixel, but multiply alpha itself by 255
+			__m128i alo = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF), keepAlpha);
+			__m128i ahi = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF), keepAlpha);
+
+			lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), half);
+			hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), half);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+			_mm_storeu_si128((__m128i*)(p + i * 4), _mm_packus_epi16(lo, hi));
+		}
+#endif
+
+		for (; i < nPixels; i++)
+		{
+			uint8_t* px = p + i * 4;
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t v = px[c] * px[3] + 128;
+				px[c] = uint8_t((v + (v >> 8)) >> 8);
+			}
+		}
+	}
 
 
 	olc::rcode Sprite::LoadFromFile(const std::string& sImageFile, olc::ResourcePack* pack)
 	{
 		UNUSED(pack);
+		bPremultiplied = false;
+		bSpansDirty = true;
 		return loader->LoadImageResource(this, sImageFile, pack);
 	}
 
@@ -1424,6 +2066,7 @@ namespace olc
 		olc::Sprite* spr = new olc::Sprite(width, height);
 		std::memcpy(spr->GetData(), GetData(), width * height * sizeof(olc::Pixel));
 		spr->modeSample = modeSample;
+		spr->bPremultiplied = bPremultiplied;
 		return spr;
 	}
 
@@ -1433,9 +2076,101 @@ namespace olc
 		for (int y = 0; y < vSize.y; y++)
 			for (int x = 0; x < vSize.x; x++)
 				spr->SetPixel(x, y, GetPixel(vPos.x + x, vPos.y + y));
+		spr->bPremultiplied = bPremultiplied;
 		return spr;
 	}
 
+	// O------------------------------------------------------------------------------O
+	// | olc::IndexedSprite IMPLEMENTATION                                            |
+	// O------------------------------------------------------------------------------O
+	IndexedSprite::IndexedSprite()
+	{ width = 0; height = 0; pPalette.fill(Pixel(0, 0, 0, 0)); }
+
+	IndexedSprite::IndexedSprite(int32_t w, int32_t h)
+	{
+		width = w;		height = h;
+		pIndexData.resize(width * height, 0);
+		pPalette.fill(Pixel(0, 0, 0, 0));
+	}
+
+	IndexedSprite::~IndexedSprite()
+	{ pIndexData.clear(); }
+
+	olc::rcode IndexedSprite::FromSprite(const olc::Sprite* spr)
+	{
+		if (spr == nullptr) return olc::rcode::FAIL;
+
+		std::map<uint32_t, uint8_t> mapColours;
+		std::vector<uint8_t> vIndices(spr->width * spr->height);
+		std::array<olc::Pixel, 256> vPalette;
+		vPalette.fill(Pixel(0, 0, 0, 0));
+
+		for (size_t i = 0; i < vIndices.size(); i++)
+		{
+			// Fully transparent pixels all share one entry, whatever their colour
+			uint32_t n = spr->pColData[i].a == 0 ? 0 : spr->pColData[i].n;
+			auto it = mapColours.find(n);
+			if (it == mapColours.end())
+			{
+				if (mapColours.size() == 256) return olc::rcode::FAIL;
+				uint8_t nIndex = uint8_t(mapColours.size());
+				it = mapColours.insert({ n, nIndex }).first;
+				vPalette[nIndex] = Pixel(n);
+			}
+			vIndices[i] = it->second;
+		}
+
+		width = spr->width; height = spr->height;
+		nPaletteSize = uint32_t(mapColours.size());
+		pIndexData = std::move(vIndices);
+		pPalette = vPalette;
+		return olc::rcode::OK;
+	}
+
+	olc::rcode IndexedSprite::LoadFromFile(const std::string& sImageFile, olc::ResourcePack* pack)
+	{
+		olc::Sprite spr;
+		olc::rcode r = spr.LoadFromFile(sImageFile, pack);
+		if (r != olc::rcode::OK) return r;
+		return FromSprite(&spr);
+	}
+
+	uint8_t IndexedSprite::GetIndex(int32_t x, int32_t y) const
+	{
+		if (x >= 0 && x < width && y >= 0 && y < height)
+			return pIndexData[y * width + x];
+		else
+			return 0;
+	}
+
+	bool IndexedSprite::SetIndex(int32_t x, int32_t y, uint8_t i)
+	{
+		if (x >= 0 && x < width && y >= 0 && y < height)
+		{
+			pIndexData[y * width + x] = i;
+			return true;
+		}
+		else
+			return false;
+	}
+
+	Pixel IndexedSprite::GetPixel(int32_t x, int32_t y) const
+	{
+		if (x >= 0 && x < width && y >= 0 && y < height)
+			return pPalette[pIndexData[y * width + x]];
+		else
+			return Pixel(0, 0, 0, 0);
+	}
+
+	void IndexedSprite::SetPaletteEntry(uint8_t i, Pixel p)
+	{ pPalette[i] = p; }
+
+	Pixel IndexedSprite::GetPaletteEntry(uint8_t i) const
+	{ return pPalette[i]; }
+
+	uint8_t* IndexedSprite::GetData()
+	{ return pIndexData.data(); }
+
 	// O------------------------------------------------------------------------------O
 	// | olc::Decal IMPLEMENTATION                                                    |
 	// O------------------------------------------------------------------------------O
@@ -1444,7 +2179,9 @@ namespace olc
 		id = -1;
 		if (spr == nullptr) return;
 		sprite = spr;
-		id = renderer->CreateTexture(sprite->width, sprite->height, filter, clamp);
+		pEngine = PixelGameEngine::GetCurrent();
+		// Headless builds have no renderer, the decal still records draws
+		if (pEngine && pEngine->renderer) id = pEngine->renderer->CreateTexture(sprite->width, sprite->height, filter, clamp);
 		Update();
 	}
 
@@ -1452,28 +2189,32 @@ namespace olc
 	{
 		if (spr == nullptr) return;
 		id = nExistingTextureResource;
+		pEngine = PixelGameEngine::GetCurrent();
 	}
 
 	void Decal::Update()
 	{
 		if (sprite == nullptr) return;
 		vUVScale = { 1.0f / float(sprite->width), 1.0f / float(sprite->height) };
-		renderer->ApplyTexture(id);
-		renderer->UpdateTexture(id, sprite);
+		premultiplied = sprite->IsPremultiplied();
+		if (pEngine == nullptr || pEngine->renderer == nullptr) return;
+		pEngine->renderer->ApplyTexture(id);
+		pEngine->renderer->UpdateTexture(id, sprite);
+		pEngine->nUploadBytes += uint64_t(sprite->width) * uint64_t(sprite->height) * sizeof(olc::Pixel);
 	}
 
 	void Decal::UpdateSprite()
 	{
-		if (sprite == nullptr) return;
-		renderer->ApplyTexture(id);
-		renderer->ReadTexture(id, sprite);
+		if (sprite == nullptr || pEngine == nullptr || pEngine->renderer == nullptr) return;
+		pEngine->renderer->ApplyTexture(id);
+		pEngine->renderer->ReadTexture(id, sprite);
 	}
 
 	Decal::~Decal()
 	{
-		if (id != -1)
+		if (id != -1 && pEngine && pEngine->renderer)
 		{
-			renderer->DeleteTexture(id);
+			pEngine->renderer->DeleteTexture(id);
 			id = -1;
 		}
 	}
@@ -1687,7 +2428,7 @@ namespace olc
 	PixelGameEngine::PixelGameEngine()
 	{
 		sAppName = "Undefined";
-		olc::PGEX::pge = this;
+		MakeCurrent();
 
 		// Bring in relevant Platform & Rendering systems depending
 		// on compiler parameters
@@ -1695,7 +2436,18 @@ namespace olc
 	}
 
 	PixelGameEngine::~PixelGameEngine()
-	{}
+	{
+		// Their textures go through the renderer, which is still alive here
+		vRetiredCaptured.clear();
+		olc_FreeRetiredDecals();
+		if (GetCurrent() == this) olc::PGEX::pge = nullptr;
+	}
+
+	void PixelGameEngine::MakeCurrent()
+	{ olc::PGEX::pge = this; }
+
+	PixelGameEngine* PixelGameEngine::GetCurrent()
+	{ return olc::PGEX::pge; }
 
 
 	olc::rcode PixelGameEngine::Construct(int32_t screen_w, int32_t screen_h, int32_t pixel_w, int32_t pixel_h, bool full_screen, bool vsync, bool cohesion)
@@ -1734,6 +2486,7 @@ namespace olc
 #if !defined(PGE_USE_CUSTOM_START)
 	olc::rcode PixelGameEngine::Start()
 	{
+		MakeCurrent();
 		if (platform->ApplicationStartUp() != olc::OK) return olc::FAIL;
 
 		// Construct the window
@@ -1863,6 +2616,62 @@ namespace olc
 	float PixelGameEngine::GetElapsedTime() const
 	{ return fLastElapsed; }
 
+	const olc::FrameHistogram& PixelGameEngine::GetFrameHistogram() const
+	{ return frameHistogram; }
+
+	const olc::FrameInfo& PixelGameEngine::GetLastFrameInfo() const
+	{ return frameInfo; }
+
+	void PixelGameEngine::SetFrameBudget(float fBudget)
+	{ frameHistogram.SetBudget(std::chrono::microseconds(int64_t(fBudget * 1e6f))); }
+
+	void PixelGameEngine::ResetFrameStats()
+	{ frameHistogram.Reset(); frameLimiter.ResetStats(); }
+
+	void PixelGameEngine::SetFrameLimit(float fFps)
+	{ fFrameLimit = std::max(0.0f, fFps); }
+
+	void PixelGameEngine::SetUnfocusedFrameLimit(float fFps)
+	{ fUnfocusedFrameLimit = std::max(0.0f, fFps); }
+
+	float PixelGameEngine::GetFrameLimit() const
+	{ return (bHasInputFocus || fUnfocusedFrameLimit <= 0.0f) ? fFrameLimit : fUnfocusedFrameLimit; }
+
+	const olc::FramePacing& PixelGameEngine::GetFramePacing() const
+	{ return frameLimiter.GetStats(); }
+
+	void PixelGameEngine::SetReactive(bool bEnable)
+	{ bReactive = bEnable; }
+
+	bool PixelGameEngine::IsReactive() const
+	{ return bReactive; }
+
+	void PixelGameEngine::RequestRedraw(float fDelay)
+	{
+		auto tp = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(std::max(0.0f, fDelay)));
+		if (!bRedrawRequested || tp < tpRedraw) tpRedraw = tp;
+		bRedrawRequested = true;
+	}
+
+	uint64_t PixelGameEngine::GetSkippedFrames() const
+	{ return nSkippedFrames; }
+
+	void PixelGameEngine::SetPipelined(bool bEnable)
+	{ bPipelined = bEnable; }
+
+	bool PixelGameEngine::IsPipelined() const
+	{ return bPipelined; }
+
+	void PixelGameEngine::SetJobThreads(uint32_t nThreads)
+	{ nJobThreads = nThreads; }
+
+	olc::JobSystem& PixelGameEngine::GetJobs()
+	{
+		std::lock_guard<std::mutex> lock(mtxJobs);
+		if (!pJobs) pJobs = std::make_unique<olc::JobSystem>(nJobThreads);
+		return *pJobs;
+	}
+
 	const olc::vi2d& PixelGameEngine::GetWindowSize() const
 	{ return vWindowSize; }
 
@@ -1905,6 +2714,20 @@ namespace olc
 			return pDrawTarget->SetPixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b/*, (uint8_t)(p.a * fBlendFactor)*/));
 		}
 
+		if (nPixelMode == Pixel::PREMULTIPLIED)
+		{
+			// Source is already scaled by its alpha, so only the destination
+			// needs weighting: d' = s + d * (1 - sa)
+			if (x < 0 || x >= pDrawTarget->width || y < 0 || y >= pDrawTarget->height) return false;
+			if (fBlendFactor < 1.0f) p = Pixel(uint8_t(p.r * fBlendFactor), uint8_t(p.g * fBlendFactor), uint8_t(p.b * fBlendFactor), uint8_t(p.a * fBlendFactor));
+			// GetData() marks the target's span cache stale, the blend can turn pixels opaque
+			Pixel& d = pDrawTarget->GetData()[y * pDrawTarget->width + x];
+			uint32_t ia = 255 - p.a;
+			auto blend = [ia](uint8_t s, uint8_t c) { uint32_t v = c * ia + 128; return uint8_t(std::min(255u, s + ((v + (v >> 8)) >> 8))); };
+			d = Pixel(blend(p.r, d.r), blend(p.g, d.g), blend(p.b, d.b), blend(p.a, d.a));
+			return true;
+		}
+
 		if (nPixelMode == Pixel::CUSTOM)
 		{
 			return pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)));
@@ -2096,9 +2919,13 @@ namespace olc
 
 	void PixelGameEngine::Clear(Pixel p)
 	{
-		int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
+		size_t pixels = size_t(GetDrawTargetWidth()) * GetDrawTargetHeight();
 		Pixel* m = GetDrawTarget()->GetData();
-		for (int i = 0; i < pixels; i++) m[i] = p;
+		auto fill = [m, p](size_t nFirst, size_t nLast) { std::fill(m + nFirst, m + nLast, p); };
+		if (pixels >= nParallelFillPixels)
+			GetJobs().ParallelFor(0, pixels, nParallelFillPixels / 4, fill);
+		else
+			fill(0, pixels);
 	}
 
 	void PixelGameEngine::ClearBuffer(Pixel p, bool bDepth)
@@ -2159,6 +2986,24 @@ namespace olc
 		if (y2 < 0) y2 = 0;
 		if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
 
+		// Opaque fills are plain stores, large ones are split into row bands
+		if (x < x2 && y < y2 && (nPixelMode == Pixel::NORMAL || (nPixelMode == Pixel::MASK && p.a == 255)))
+		{
+			int32_t nWidth = GetDrawTargetWidth();
+			Pixel* m = GetDrawTarget()->GetData();
+			auto fill = [=](size_t nFirst, size_t nLast)
+			{
+				for (size_t j = nFirst; j < nLast; j++)
+					std::fill(m + j * nWidth + x, m + j * nWidth + x2, p);
+			};
+			size_t nRowPixels = size_t(x2 - x);
+			if (nRowPixels * size_t(y2 - y) >= nParallelFillPixels)
+				GetJobs().ParallelFor(size_t(y), size_t(y2), std::max<size_t>(1, nParallelFillPixels / 4 / nRowPixels), fill);
+			else
+				fill(size_t(y), size_t(y2));
+			return;
+		}
+
 		for (int i = x; i < x2; i++)
 			for (int j = y; j < y2; j++)
 				Draw(i, j, p);
@@ -2321,6 +3166,9 @@ namespace olc
 		if (sprite == nullptr)
 			return;
 
+		if (scale == 1 && flip == olc::Sprite::NONE && DrawSpans(x, y, sprite, 0, 0, sprite->width, sprite->height))
+			return;
+
 		int32_t fxs = 0, fxm = 1, fx = 0;
 		int32_t fys = 0, fym = 1, fy = 0;
 		if (flip & olc::Sprite::Flip::HORIZ) { fxs = sprite->width - 1; fxm = -1; }
@@ -2358,6 +3206,9 @@ namespace olc
 		if (sprite == nullptr)
 			return;
 
+		if (scale == 1 && flip == olc::Sprite::NONE && DrawSpans(x, y, sprite, ox, oy, w, h))
+			return;
+
 		int32_t fxs = 0, fxm = 1, fx = 0;
 		int32_t fys = 0, fym = 1, fy = 0;
 		if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
@@ -2387,12 +3238,152 @@ namespace olc
 		}
 	}
 
+	bool PixelGameEngine::DrawSpans(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h)
+	{
+		if (nPixelMode != Pixel::MASK || !sprite->HasSpanCache() || pDrawTarget == nullptr || sprite == pDrawTarget)
+			return false;
+
+		// Wrapping sample modes can read outside of the sprite, leave those to the slow path
+		bool bInside = ox >= 0 && oy >= 0 && ox + w <= sprite->width && oy + h <= sprite->height;
+		if (sprite->modeSample != olc::Sprite::Mode::NORMAL && !bInside)
+			return false;
+
+		// Clip source region against the sprite and against the draw target
+		int32_t sx0 = std::max({ ox, 0, ox - x });
+		int32_t sx1 = std::min({ ox + w, sprite->width, ox - x + pDrawTarget->width });
+		int32_t sy0 = std::max({ oy, 0, oy - y });
+		int32_t sy1 = std::min({ oy + h, sprite->height, oy - y + pDrawTarget->height });
+		if (sx0 >= sx1 || sy0 >= sy1) return true;
+
+		Pixel* pDst = pDrawTarget->GetData();
+		const Pixel* pSrc = sprite->pColData.data();
+		for (int32_t sy = sy0; sy < sy1; sy++)
+		{
+			Pixel* pDstRow = pDst + (y + sy - oy) * pDrawTarget->width + (x - ox);
+			const Pixel* pSrcRow = pSrc + sy * sprite->width;
+			const Sprite::sSpan* pEnd = nullptr;
+			for (const Sprite::sSpan* span = sprite->GetRowSpans(sy, pEnd); span != pEnd; ++span)
+			{
+				int32_t s0 = std::max(span->nStart, sx0);
+				int32_t s1 = std::min(span->nStart + span->nLength, sx1);
+				if (s1 > s0) std::memcpy(pDstRow + s0, pSrcRow + s0, (s1 - s0) * sizeof(Pixel));
+			}
+		}
+		return true;
+	}
+
+	void PixelGameEngine::DrawIndexedSprite(int32_t x, int32_t y, IndexedSprite* sprite, uint32_t scale, uint8_t flip)
+	{
+		if (sprite == nullptr)
+			return;
+
+		DrawPartialIndexedSprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale, flip);
+	}
+
+	void PixelGameEngine::DrawPartialIndexedSprite(int32_t x, int32_t y, IndexedSprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip)
+	{
+		if (sprite == nullptr)
+			return;
+
+		if (scale == 1 && flip == olc::Sprite::NONE && DrawIndexedRows(x, y, sprite, ox, oy, w, h))
+			return;
+
+		int32_t fxs = 0, fxm = 1, fx = 0;
+		int32_t fys = 0, fym = 1, fy = 0;
+		if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
+		if (flip & olc::Sprite::Flip::VERT) { fys = h - 1; fym = -1; }
+
+		fx = fxs;
+		for (int32_t i = 0; i < w; i++, fx += fxm)
+		{
+			fy = fys;
+			for (int32_t j = 0; j < h; j++, fy += fym)
+				for (uint32_t is = 0; is < scale; is++)
+					for (uint32_t js = 0; js < scale; js++)
+						Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
+		}
+	}
+
+	bool PixelGameEngine::DrawIndexedRows(int32_t x, int32_t y, IndexedSprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h)
+	{
+		if ((nPixelMode != Pixel::NORMAL && nPixelMode != Pixel::MASK) || pDrawTarget == nullptr)
+			return false;
+
+		// Out of range source pixels are transparent, so clipping to the sprite is exact
+		int32_t sx0 = std::max({ ox, 0, ox - x });
+		int32_t sx1 = std::min({ ox + w, sprite->width, ox - x + pDrawTarget->width });
+		int32_t sy0 = std::max({ oy, 0, oy - y });
+		int32_t sy1 = std::min({ oy + h, sprite->height, oy - y + pDrawTarget->height });
+		if (sx0 >= sx1 || sy0 >= sy1) return true;
+
+		// NORMAL mode still writes transparent pixels outside of the sprite area
+		if (nPixelMode == Pixel::NORMAL && (sx0 != std::max(ox, ox - x) || sx1 != std::min(ox + w, ox - x + pDrawTarget->width) ||
+			sy0 != std::max(oy, oy - y) || sy1 != std::min(oy + h, oy - y + pDrawTarget->height)))
+			return false;
+
+		const bool bMask = nPixelMode == Pixel::MASK;
+		const Pixel* pal = sprite->pPalette.data();
+		Pixel* pDst = pDrawTarget->GetData();
+		const int32_t n = sx1 - sx0;
+
+		for (int32_t sy = sy0; sy < sy1; sy++)
+		{
+			Pixel* dst = pDst + (y + sy - oy) * pDrawTarget->width + (x - ox) + sx0;
+			const uint8_t* src = sprite->pIndexData.data() + sy * sprite->width + sx0;
+			int32_t i = 0;
+
+#if defined(OLC_SIMD_SSE2)
+			const __m128i opaque = _mm_set1_epi32(255);
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i c = _mm_set_epi32(int(pal[src[i + 3]].n), int(pal[src[i + 2]].n), int(pal[src[i + 1]].n), int(pal[src[i]].n));
+				if (bMask)
+				{
+					// Keep destination wherever the palette colour is not fully opaque
+					__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+					__m128i m = _mm_cmpeq_epi32(_mm_srli_epi32(c, 24), opaque);
+					c = _mm_or_si128(_mm_and_si128(m, c), _mm_andnot_si128(m, d));
+				}
+				_mm_storeu_si128((__m128i*)(dst + i), c);
+			}
+#endif
+
+			for (; i < n; i++)
+			{
+				const Pixel c = pal[src[i]];
+				if (!bMask || c.a == 255) dst[i] = c;
+			}
+		}
+		return true;
+	}
+
 	void PixelGameEngine::SetDecalMode(const olc::DecalMode& mode)
 	{ nDecalMode = mode; }
 
 	void PixelGameEngine::SetDecalStructure(const olc::DecalStructure& structure)
 	{ nDecalStructure = structure; }
 
+	void PixelGameEngine::RetireDecal(olc::Decal* decal)
+	{
+		if (decal == nullptr) return;
+		std::lock_guard<std::mutex> lock(mtxRetired);
+		vRetiredDecals.emplace_back(decal);
+	}
+
+	void PixelGameEngine::olc_FreeRetiredDecals()
+	{
+		std::vector<std::unique_ptr<olc::Decal>> vFree;
+		{
+			std::lock_guard<std::mutex> lock(mtxRetired);
+			vFree.swap(vRetiredDecals);
+		}
+		// Destructors delete the textures, outside the lock
+		vFree.clear();
+	}
+
+	olc::DecalStructure PixelGameEngine::GetDecalStructure() const
+	{ return nDecalStructure; }
+
 	void PixelGameEngine::DrawPartialDecal(const olc::vf2d& pos, olc::Decal* decal, const olc::vf2d& source_pos, const olc::vf2d& source_size, const olc::vf2d& scale, const olc::Pixel& tint)
 	{
 		olc::vf2d vScreenSpacePos =
@@ -2541,7 +3532,27 @@ namespace olc
 		}
 		di.mode = nDecalMode;
 		di.structure = nDecalStructure;
-		vLayers[nTargetLayer].vecDecalInstance.push_back(di);
+		vLayers[nTargetLayer].vecDecalInstance.push_back(std::move(di));
+	}
+
+	void PixelGameEngine::DrawPolygonDecal(olc::Decal* decal, const olc::vf2d* pos, const olc::vf2d* uv, const olc::Pixel* tint, uint32_t points, uint32_t tintStride)
+	{
+		DecalInstance di;
+		di.decal = decal;
+		di.points = points;
+		di.pos.resize(di.points);
+		di.uv.resize(di.points);
+		di.w.assign(di.points, 1.0f);
+		di.tint.resize(di.points);
+		for (uint32_t i = 0; i < di.points; i++)
+		{
+			di.pos[i] = { (pos[i].x * vInvScreenSize.x) * 2.0f - 1.0f, ((pos[i].y * vInvScreenSize.y) * 2.0f - 1.0f) * -1.0f };
+			di.uv[i] = uv[i];
+			di.tint[i] = tint[i * tintStride];
+		}
+		di.mode = nDecalMode;
+		di.structure = nDecalStructure;
+		vLayers[nTargetLayer].vecDecalInstance.push_back(std::move(di));
 	}
 
 	void PixelGameEngine::DrawPolygonDecal(olc::Decal* decal, const std::vector<olc::vf2d>& pos, const std::vector<float>& depth, const std::vector<olc::vf2d>& uv, const olc::Pixel tint)
@@ -3045,17 +4056,19 @@ namespace olc
 
 	void PixelGameEngine::olc_UpdateWindowSize(int32_t x, int32_t y)
 	{
+		bInputEvent = true;
 		vWindowSize = { x, y };
 		olc_UpdateViewport();
 	}
 
 	void PixelGameEngine::olc_UpdateMouseWheel(int32_t delta)
-	{ nMouseWheelDeltaCache += delta; }
+	{ nMouseWheelDeltaCache += delta; bInputEvent = true; }
 
 	void PixelGameEngine::olc_UpdateMouse(int32_t x, int32_t y)
 	{
 		// Mouse coords come in screen space
 		// But leave in pixel space
+		bInputEvent = true;
 		bHasMouseFocus = true;
 		vMouseWindowPos = { x, y };
 		// Full Screen mode may have a weird viewport we must clamp to
@@ -3069,258 +4082,1204 @@ namespace olc
 		if (vMousePosCache.y < 0) vMousePosCache.y = 0;
 	}
 
-	void PixelGameEngine::olc_UpdateMouseState(int32_t button, bool state)
-	{ pMouseNewState[button] = state; }
+	void PixelGameEngine::olc_UpdateMouseState(int32_t button, bool state)
+	{ pMouseNewState[button] = state; bInputEvent = true; }
+
+	void PixelGameEngine::olc_UpdateKeyState(int32_t key, bool state)
+	{ pKeyNewState[key] = state; bInputEvent = true; }
+
+	void PixelGameEngine::olc_UpdateMouseFocus(bool state)
+	{ bHasMouseFocus = state; bInputEvent = true; }
+
+	void PixelGameEngine::olc_UpdateKeyFocus(bool state)
+	{ bHasInputFocus = state; bInputEvent = true; }
+
+	void PixelGameEngine::olc_Reanimate()
+	{ bAtomActive = true; }
+
+	bool PixelGameEngine::olc_IsRunning()
+	{ return bAtomActive; }
+
+	void PixelGameEngine::olc_Terminate()
+	{ bAtomActive = false; }
+
+	void PixelGameEngine::EngineThread()
+	{
+		// Allow platform to do stuff here if needed, since its now in the
+		// context of this thread
+		MakeCurrent();
+		if (platform->ThreadStartUp() == olc::FAIL)	return;
+		profile::SetThreadName("PGE Engine");
+
+		// Do engine context specific initialisation
+		olc_PrepareEngine();
+
+		// Create user resources as part of this thread
+		for (auto& ext : vExtensions) ext->OnBeforeUserCreate();
+		if (!OnUserCreate()) bAtomActive = false;
+		for (auto& ext : vExtensions) ext->OnAfterUserCreate();
+
+		while (bAtomActive)
+		{
+			// Run as fast as possible, or as fast as the frame limit allows
+			if (bPipelined) olc_RunPipelined();
+			while (bAtomActive)
+			{
+				if (bReactive && !olc_WaitForFrame()) continue;
+				olc_CoreUpdate();
+				frameLimiter.Wait(GetFrameLimit());
+				OLC_PROFILE_FRAME();
+			}
+
+			// Allow the user to free resources if they have overrided the destroy function
+			if (!OnUserDestroy())
+			{
+				// User denied destroy for some reason, so continue running
+				bAtomActive = true;
+			}
+			else
+			{
+				// No frame will draw what is still queued, free decals retired on the way out
+				for (auto& layer : vLayers) layer.vecDecalInstance.clear();
+				olc_FreeRetiredDecals();
+			}
+		}
+
+		platform->ThreadCleanUp();
+	}
+
+	bool PixelGameEngine::olc_WaitForFrame()
+	{
+		using namespace std::chrono;
+
+		// Events are read here too, on X11 they only reach the input state this way
+		platform->HandleSystemEvent();
+		bool bInput = bInputEvent.exchange(false);
+
+		// The frame about to run is any due redraw, requests made during it stay pending
+		auto tNow = steady_clock::now();
+		bool bRedraw = bRedrawRequested && tpRedraw <= tNow;
+		if (bRedraw) bRedrawRequested = false;
+		if (bInput || bRedraw || !bReactive) return true;
+
+		// Nothing to draw, sleep until an event or the requested redraw. The
+		// timeout is capped so a termination from another thread is noticed.
+		OLC_PROFILE_ZONE("Idle");
+		auto tTimeout = milliseconds(250);
+		if (bRedrawRequested) tTimeout = std::min(tTimeout, duration_cast<milliseconds>(tpRedraw - tNow) + milliseconds(1));
+		platform->WaitSystemEvent(duration_cast<microseconds>(tTimeout));
+
+		// The idle time is neither frame time nor elapsed time, and the frame
+		// limiter paces again from the next frame
+		auto tIdle = steady_clock::now() - tNow;
+		m_tp1 += tIdle;
+		frameLimiter.Restart();
+		nSkippedFrames++;
+		return false;
+	}
+
+	void PixelGameEngine::olc_PrepareEngine()
+	{
+		// Start OpenGL, the context is owned by the game thread
+		if (platform->CreateGraphics(bFullScreen, bEnableVSYNC, vViewPos, vViewSize) == olc::FAIL) return;
+
+		// Construct default font sheet
+		olc_ConstructFontSheet();
+
+		// Create Primary Layer "0"
+		CreateLayer();
+		vLayers[0].bUpdate = true;
+		vLayers[0].bShow = true;
+		SetDrawTarget(nullptr);
+
+		m_tp1 = std::chrono::steady_clock::now();
+		m_tp2 = std::chrono::steady_clock::now();
+	}
+
+
+	void PixelGameEngine::olc_CoreUpdate()
+	{
+		OLC_PROFILE_ZONE("Frame");
+
+		// Phase timings, published when the frame is complete
+		olc::FrameInfo info;
+		uint64_t nUploadStart = nUploadBytes;
+
+		// Handle Timing
+		float fElapsedTime = olc_UpdateTiming();
+		auto tpPhase = m_tp2;
+		auto PhaseMs = [&tpPhase]()
+		{
+			auto tp = std::chrono::steady_clock::now();
+			float ms = std::chrono::duration<float, std::milli>(tp - tpPhase).count();
+			tpPhase = tp;
+			return ms;
+		};
+
+		olc_UpdateInput();
+		info.fInputMs = PhaseMs();
+
+		olc_UpdateUser(fElapsedTime);
+		info.fUpdateMs = PhaseMs();
+
+		SetDecalMode(DecalMode::NORMAL);
+		olc_DrawLayers(vLayers, info);
+		info.fLayersMs = PhaseMs();
+
+		// Present Graphics to screen
+		{
+			OLC_PROFILE_ZONE("DisplayFrame");
+			renderer->DisplayFrame();
+		}
+		info.fDisplayMs = PhaseMs();
+
+		// Every draw queued before now has been presented
+		olc_FreeRetiredDecals();
+		info.nUploadBytes = nUploadBytes - nUploadStart;
+		frameInfo = info;
+
+		olc_UpdateTitle(fElapsedTime);
+	}
+
+	float PixelGameEngine::olc_UpdateTiming()
+	{
+		m_tp2 = std::chrono::steady_clock::now();
+		std::chrono::duration<float> elapsedTime = m_tp2 - m_tp1;
+		if (!bFirstFrame)
+			frameHistogram.Record(std::chrono::duration_cast<std::chrono::microseconds>(m_tp2 - m_tp1));
+		bFirstFrame = false;
+		m_tp1 = m_tp2;
+
+		// Our time per frame coefficient
+		fLastElapsed = elapsedTime.count();
+		return fLastElapsed;
+	}
+
+	void PixelGameEngine::olc_UpdateInput()
+	{
+		OLC_PROFILE_ZONE("Input");
+
+		// Some platforms will need to check for events
+		platform->HandleSystemEvent();
+
+		// Compare hardware input states from previous frame
+		auto ScanHardware = [&](HWButton* pKeys, bool* pStateOld, bool* pStateNew, uint32_t nKeyCount)
+		{
+			for (uint32_t i = 0; i < nKeyCount; i++)
+			{
+				pKeys[i].bPressed = false;
+				pKeys[i].bReleased = false;
+				if (pStateNew[i] != pStateOld[i])
+				{
+					if (pStateNew[i])
+					{
+						pKeys[i].bPressed = !pKeys[i].bHeld;
+						pKeys[i].bHeld = true;
+					}
+					else
+					{
+						pKeys[i].bReleased = true;
+						pKeys[i].bHeld = false;
+					}
+				}
+				pStateOld[i] = pStateNew[i];
+			}
+		};
+
+		ScanHardware(pKeyboardState, pKeyOldState, pKeyNewState, 256);
+		ScanHardware(pMouseState, pMouseOldState, pMouseNewState, nMouseButtons);
+
+		// Cache mouse coordinates so they remain consistent during frame
+		vMousePos = vMousePosCache;
+		nMouseWheelDelta = nMouseWheelDeltaCache;
+		nMouseWheelDeltaCache = 0;
+	}
+
+	void PixelGameEngine::olc_UpdateUser(float fElapsedTime)
+	{
+		OLC_PROFILE_ZONE("OnUserUpdate");
+		bool bExtensionBlockFrame = false;
+		for (auto& ext : vExtensions) bExtensionBlockFrame |= ext->OnBeforeUserUpdate(fElapsedTime);
+		if (!bExtensionBlockFrame)
+		{
+			if (!OnUserUpdate(fElapsedTime)) bAtomActive = false;
+		}
+		for (auto& ext : vExtensions) ext->OnAfterUserUpdate(fElapsedTime);
+	}
+
+	void PixelGameEngine::olc_DrawLayers(std::vector<LayerDesc>& layers, olc::FrameInfo& info)
+	{
+		OLC_PROFILE_ZONE("Layers");
+		renderer->UpdateViewport(vViewPos, vViewSize);
+		renderer->ClearBuffer(olc::BLACK, true);
+
+		// Layer 0 must always exist
+		layers[0].bUpdate = true;
+		layers[0].bShow = true;
+		renderer->PrepareDrawing();
+
+		for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer)
+		{
+			if (layer->bShow)
+			{
+				if (layer->funcHook == nullptr)
+				{
+					renderer->ApplyTexture(layer->pDrawTarget.Decal()->id);
+					if (layer->bUpdate)
+					{
+						OLC_PROFILE_ZONE("Layer Upload");
+						layer->pDrawTarget.Decal()->Update();
+						layer->bUpdate = false;
+					}
+
+					renderer->DrawLayerQuad(layer->vOffset, layer->vScale, layer->tint);
+					info.nDecals += uint32_t(layer->vecDecalInstance.size());
+					info.nDrawCalls += 1 + uint32_t(layer->vecDecalInstance.size());
+
+					// Display Decals in order for this layer
+					OLC_PROFILE_ZONE("Decals");
+					for (auto& decal : layer->vecDecalInstance)
+						renderer->DrawDecal(decal);
+					layer->vecDecalInstance.clear();
+				}
+				else
+				{
+					// Mwa ha ha.... Have Fun!!!
+					layer->funcHook();
+					info.nDrawCalls++;
+				}
+			}
+			else
+			{
+				// Hidden layers drop their decals too, or they would outlive retired decals
+				layer->vecDecalInstance.clear();
+			}
+		}
+	}
+
+	void PixelGameEngine::olc_RunPipelined()
+	{
+		auto pipe = new olc::Renderer_Pipelined(std::move(renderer));
+		renderer.reset(pipe);
+
+		// Hand off state, guarded by the renderer queue lock
+		bool bSimGo = false;
+		bool bSimDone = true;
+		bool bSimExit = false;
+		float fSimElapsed = 0.0f;
+		float fSimUpdateMs = 0.0f;
+
+		std::thread tSimulation([&]()
+		{
+			MakeCurrent();
+			profile::SetThreadName("PGE Simulation");
+			for (;;)
+			{
+				bool bExit = false;
+				pipe->Wait([&]() { bExit = bSimExit; return bSimGo || bSimExit; });
+				if (bExit) return;
+
+				auto tpStart = std::chrono::steady_clock::now();
+				olc_UpdateUser(fSimElapsed);
+				float fUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+				OLC_PROFILE_FRAME();
+				pipe->Signal([&]() { fSimUpdateMs = fUpdateMs; bSimGo = false; bSimDone = true; });
+			}
+		});
+
+		// Render phases of the frame drawn last, published with the next hand off
+		olc::FrameInfo renderInfo;
+		uint64_t nUploadStart = nUploadBytes;
+
+		for (;;)
+		{
+			// Wait for the simulation to finish its frame, running its renderer calls
+			pipe->ServeUntil([&]() { return bSimDone; });
+			if (!bAtomActive) break;
+
+			olc::FrameInfo info;
+			{
+				OLC_PROFILE_ZONE("Hand Off");
+				// The simulation is idle, take its frame and start the next one
+				olc_CaptureLayers();
+				float fElapsedTime = olc_UpdateTiming();
+				auto tpInput = std::chrono::steady_clock::now();
+				olc_UpdateInput();
+
+				info = renderInfo;
+				info.fInputMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - tpInput).count();
+				info.fUpdateMs = fSimUpdateMs;
+				info.nUploadBytes = nUploadBytes - nUploadStart;
+				nUploadStart = nUploadBytes;
+				frameInfo = info;
+
+				olc_UpdateTitle(fElapsedTime);
+				pipe->Signal([&]() { fSimElapsed = fElapsedTime; bSimGo = true; bSimDone = false; });
+			}
+
+			// Draw the captured frame while the next one is simulated
+			{
+				OLC_PROFILE_ZONE("Frame");
+				auto tpLayers = std::chrono::steady_clock::now();
+				renderInfo = olc::FrameInfo();
+				olc_DrawLayers(vRenderLayers, renderInfo);
+				auto tpDisplay = std::chrono::steady_clock::now();
+				{
+					OLC_PROFILE_ZONE("DisplayFrame");
+					renderer->DisplayFrame();
+				}
+				renderInfo.fLayersMs = std::chrono::duration<float, std::milli>(tpDisplay - tpLayers).count();
+				renderInfo.fDisplayMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - tpDisplay).count();
+			}
+
+			// Retired before this frame was captured, nothing queued can draw them now.
+			// Decals the simulation retires meanwhile wait for the next frame.
+			vRetiredCaptured.clear();
+
+			// Calls queued meanwhile would otherwise wait out the frame limit
+			pipe->ServeUntil([]() { return true; });
+			frameLimiter.Wait(GetFrameLimit());
+			OLC_PROFILE_FRAME();
+		}
+
+		pipe->Signal([&]() { bSimExit = true; });
+		tSimulation.join();
+
+		// The render copies own textures, free them while the proxy still accepts calls
+		pipe->ServeUntil([]() { return true; });
+		vRenderLayers.clear();
+		vRetiredCaptured.clear();
+		renderer = pipe->Release();
+	}
+
+	// Runs on the engine thread while the simulation thread waits
+	void PixelGameEngine::olc_CaptureLayers()
+	{
+		// Layer 0 must always exist
+		vLayers[0].bUpdate = true;
+		vLayers[0].bShow = true;
+		SetDecalMode(DecalMode::NORMAL);
+
+		while (vRenderLayers.size() > vLayers.size())
+			vRenderLayers.pop_back();
+		while (vRenderLayers.size() < vLayers.size())
+			vRenderLayers.emplace_back();
+
+		// Decals retired so far may be drawn by the captured frame, they are freed
+		// after it is presented. Later ones may be drawn by the next capture.
+		{
+			std::lock_guard<std::mutex> lock(mtxRetired);
+			for (auto& decal : vRetiredDecals) vRetiredCaptured.push_back(std::move(decal));
+			vRetiredDecals.clear();
+		}
+
+		for (size_t i = 0; i < vLayers.size(); i++)
+		{
+			LayerDesc& src = vLayers[i];
+			LayerDesc& dst = vRenderLayers[i];
+			dst.vOffset = src.vOffset;
+			dst.vScale = src.vScale;
+			dst.bShow = src.bShow;
+			dst.tint = src.tint;
+			dst.funcHook = src.funcHook;
+
+			// Decal lists only live for one frame, swap in the new one
+			std::swap(dst.vecDecalInstance, src.vecDecalInstance);
+			src.vecDecalInstance.clear();
+
+			// Pixels persist between frames, so the layer is copied, not swapped
+			olc::Sprite* pSource = src.pDrawTarget.Sprite();
+			if (src.bUpdate && pSource != nullptr)
+			{
+				olc::Sprite* pTarget = dst.pDrawTarget.Sprite();
+				if (pTarget == nullptr || pTarget->width != pSource->width || pTarget->height != pSource->height)
+				{
+					dst.pDrawTarget.Create(pSource->width, pSource->height);
+					pTarget = dst.pDrawTarget.Sprite();
+				}
+				pTarget->pColData = pSource->pColData;
+				dst.bUpdate = true;
+				src.bUpdate = false;
+			}
+		}
+	}
+
+	void PixelGameEngine::olc_UpdateTitle(float fElapsedTime)
+	{
+		fFrameTimer += fElapsedTime;
+		nFrameCount++;
+		if (fFrameTimer >= 1.0f)
+		{
+			nLastFPS = nFrameCount;
+			fFrameTimer -= 1.0f;
+			std::string sTitle = "OneLoneCoder.com - Pixel Game Engine - " + sAppName + " - FPS: " + std::to_string(nFrameCount);
+			platform->SetWindowTitle(sTitle);
+			nFrameCount = 0;
+		}
+	}
+
+	void PixelGameEngine::olc_ConstructFontSheet()
+	{
+		std::string data;
+		data += "?Q`0001oOch0o01o@F40o0<AGD4090LAGD<090@A7ch0?00O7Q`0600>00000000";
+		data += "O000000nOT0063Qo4d8>?7a14Gno94AA4gno94AaOT0>o3`oO400o7QN00000400";
+		data += "Of80001oOg<7O7moBGT7O7lABET024@aBEd714AiOdl717a_=TH013Q>00000000";
+		data += "720D000V?V5oB3Q_HdUoE7a9@DdDE4A9@DmoE4A;Hg]oM4Aj8S4D84@`00000000";
+		data += "OaPT1000Oa`^13P1@AI[?g`1@A=[OdAoHgljA4Ao?WlBA7l1710007l100000000";
+		data += "ObM6000oOfMV?3QoBDD`O7a0BDDH@5A0BDD<@5A0BGeVO5ao@CQR?5Po00000000";
+		data += "Oc``000?Ogij70PO2D]??0Ph2DUM@7i`2DTg@7lh2GUj?0TO0C1870T?00000000";
+		data += "70<4001o?P<7?1QoHg43O;`h@GT0@:@LB@d0>:@hN@L0@?aoN@<0O7ao0000?000";
+		data += "OcH0001SOglLA7mg24TnK7ln24US>0PL24U140PnOgl0>7QgOcH0K71S0000A000";
+		data += "00H00000@Dm1S007@DUSg00?OdTnH7YhOfTL<7Yh@Cl0700?@Ah0300700000000";
+		data += "<008001QL00ZA41a@6HnI<1i@FHLM81M@@0LG81?O`0nC?Y7?`0ZA7Y300080000";
+		data += "O`082000Oh0827mo6>Hn?Wmo?6HnMb11MP08@C11H`08@FP0@@0004@000000000";
+		data += "00P00001Oab00003OcKP0006@6=PMgl<@440MglH@000000`@000001P00000000";
+		data += "Ob@8@@00Ob@8@Ga13R@8Mga172@8?PAo3R@827QoOb@820@0O`0007`0000007P0";
+		data += "O`000P08Od400g`<3V=P0G`673IP0`@3>1`00P@6O`P00g`<O`000GP800000000";
+		data += "?P9PL020O`<`N3R0@E4HC7b0@ET<ATB0@@l6C4B0O`H3N7b0?P01L3R000000020";
+
+		fontSprite = new olc::Sprite(128, 48);
+		int px = 0, py = 0;
+		for (size_t b = 0; b < 1024; b += 4)
+		{
+			uint32_t sym1 = (uint32_t)data[b + 0] - 48;
+			uint32_t sym2 = (uint32_t)data[b + 1] - 48;
+			uint32_t sym3 = (uint32_t)data[b + 2] - 48;
+			uint32_t sym4 = (uint32_t)data[b + 3] - 48;
+			uint32_t r = sym1 << 18 | sym2 << 12 | sym3 << 6 | sym4;
+
+			for (int i = 0; i < 24; i++)
+			{
+				int k = r & (1 << i) ? 255 : 0;
+				fontSprite->SetPixel(px, py, olc::Pixel(k, k, k, k));
+				if (++py == 48) { px++; py = 0; }
+			}
+		}
+
+		fontDecal = new olc::Decal(fontSprite);
+
+		constexpr std::array<uint8_t, 96> vSpacing = { {
+			0x03,0x25,0x16,0x08,0x07,0x08,0x08,0x04,0x15,0x15,0x08,0x07,0x15,0x07,0x24,0x08,
+			0x08,0x17,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x24,0x15,0x06,0x07,0x16,0x17,
+			0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x17,0x08,0x08,0x17,0x08,0x08,0x08,
+			0x08,0x08,0x08,0x08,0x17,0x08,0x08,0x08,0x08,0x17,0x08,0x15,0x08,0x15,0x08,0x08,
+			0x24,0x18,0x17,0x17,0x17,0x17,0x17,0x17,0x17,0x33,0x17,0x17,0x33,0x18,0x17,0x17,
+			0x17,0x17,0x17,0x17,0x07,0x17,0x17,0x18,0x18,0x17,0x17,0x07,0x33,0x07,0x08,0x00, } };
+
+		for (auto c : vSpacing) vFontSpacing.push_back({ c >> 4, c & 15 });
+
+	}
+
+	void PixelGameEngine::pgex_Register(olc::PGEX* pgex)
+	{
+		if (std::find(vExtensions.begin(), vExtensions.end(), pgex) == vExtensions.end())
+			vExtensions.push_back(pgex);			
+	}
+
+
+	PGEX::PGEX(bool bHook) { if(bHook) pge->pgex_Register(this); }
+	void PGEX::OnBeforeUserCreate() {}
+	void PGEX::OnAfterUserCreate()	{}
+	bool PGEX::OnBeforeUserUpdate(float& fElapsedTime) { return false; }
+	void PGEX::OnAfterUserUpdate(float fElapsedTime) {}
+
+
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameHistogram IMPLEMENTATION                                           |
+	// O------------------------------------------------------------------------------O
+	FrameHistogram::FrameHistogram() : vBuckets(BucketCount, 0)
+	{ }
+
+	uint32_t FrameHistogram::BucketOf(uint64_t us)
+	{
+		if (us < 2 * SubBuckets) return uint32_t(us);
+
+		uint32_t nMsb = 63;
+		while (!(us >> nMsb)) nMsb--;
+		if (nMsb >= MaxBits) return BucketCount - 1;
+
+		// the top SubBucketBits + 1 bits pick the bucket
+		uint32_t nShift = nMsb - SubBucketBits;
+		return 2 * SubBuckets + (nShift - 1) * SubBuckets + uint32_t(us >> nShift) - SubBuckets;
+	}
+
+	uint64_t FrameHistogram::BucketHigh(uint32_t i)
+	{
+		if (i < 2 * SubBuckets) return i;
+
+		uint32_t k = i - 2 * SubBuckets;
+		uint32_t nShift = k / SubBuckets + 1;
+		uint64_t nTop = k % SubBuckets + SubBuckets;
+		return ((nTop + 1) << nShift) - 1;
+	}
+
+	void FrameHistogram::Record(std::chrono::microseconds tFrame)
+	{
+		uint64_t us = uint64_t(std::max<int64_t>(0, tFrame.count()));
+		vBuckets[BucketOf(us)]++;
+		nCount++;
+		nTotalUs += us;
+		nMinUs = std::min(nMinUs, us);
+		nMaxUs = std::max(nMaxUs, us);
+		if (us > nBudgetUs) nOverBudget++;
+	}
+
+	void FrameHistogram::Reset()
+	{
+		std::fill(vBuckets.begin(), vBuckets.end(), 0);
+		nCount = nOverBudget = nTotalUs = nMaxUs = 0;
+		nMinUs = UINT64_MAX;
+	}
+
+	// Only frames recorded from now on are checked against the new budget
+	void FrameHistogram::SetBudget(std::chrono::microseconds tBudget)
+	{ nBudgetUs = uint64_t(std::max<int64_t>(0, tBudget.count())); }
+
+	uint64_t FrameHistogram::Count() const
+	{ return nCount; }
+
+	uint64_t FrameHistogram::CountOverBudget() const
+	{ return nOverBudget; }
+
+	double FrameHistogram::Percentile(double p) const
+	{
+		if (nCount == 0) return 0.0;
+
+		// smallest value with at least p% of the frames at or below it
+		uint64_t nTarget = std::max<uint64_t>(1, uint64_t(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * double(nCount))));
+		uint64_t nSeen = 0;
+		for (uint32_t i = 0; i < BucketCount; i++)
+		{
+			nSeen += vBuckets[i];
+			if (nSeen >= nTarget)
+				return double(std::clamp(BucketHigh(i), nMinUs, nMaxUs)) / 1000.0;
+		}
+		return Max();
+	}
+
+	double FrameHistogram::Mean() const
+	{ return nCount ? double(nTotalUs) / double(nCount) / 1000.0 : 0.0; }
+
+	double FrameHistogram::Min() const
+	{ return nCount ? double(nMinUs) / 1000.0 : 0.0; }
+
+	double FrameHistogram::Max() const
+	{ return double(nMaxUs) / 1000.0; }
+
+	double FrameHistogram::Budget() const
+	{ return double(nBudgetUs) / 1000.0; }
+
+
+	// O------------------------------------------------------------------------------O
+	// | olc::JobSystem IMPLEMENTATION                                                |
+	// O------------------------------------------------------------------------------O
+	// Which pool the current thread works for, and its queue there
+	static thread_local const JobSystem* pJobOwner = nullptr;
+	static thread_local uint32_t nJobIndex = 0;
+
+	JobSystem::JobSystem(uint32_t nThreads)
+	{
+		if (nThreads == 0)
+			nThreads = std::max(1u, std::thread::hardware_concurrency());
+		uint32_t nWorkers = nThreads - 1;
+
+		for (uint32_t i = 0; i <= nWorkers; i++)
+			vQueues.push_back(std::make_unique<Queue>());
+		for (uint32_t i = 0; i < nWorkers; i++)
+			vWorkers.emplace_back(&JobSystem::WorkerMain, this, i);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtxSleep);
+			bRunning = false;
+		}
+		cvSleep.notify_all();
+		for (auto& t : vWorkers) t.join();
+	}
+
+	uint32_t JobSystem::ThreadCount() const
+	{ return uint32_t(vWorkers.size()) + 1; }
+
+	uint32_t JobSystem::CurrentIndex() const
+	{ return pJobOwner == this ? nJobIndex : uint32_t(vQueues.size()) - 1; }
+
+	void JobSystem::Submit(std::function<void()> fnJob, Counter* pCounter)
+	{
+		if (pCounter) pCounter->nPending.fetch_add(1, std::memory_order_relaxed);
+
+		Queue& queue = *vQueues[CurrentIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			queue.jobs.push_back({ std::move(fnJob), pCounter });
+		}
+
+		// Taking the sleep lock orders the count with a worker about to sleep
+		{
+			std::lock_guard<std::mutex> lock(mtxSleep);
+			nQueued.fetch_add(1);
+		}
+		cvSleep.notify_one();
+	}
+
+	void JobSystem::Wait(Counter& counter)
+	{
+		uint32_t nIndex = CurrentIndex();
+		uint32_t nIdle = 0;
+		while (counter.nPending.load(std::memory_order_acquire) > 0)
+		{
+			// Help instead of blocking, the remaining jobs may be running elsewhere
+			if (RunOne(nIndex)) { nIdle = 0; continue; }
+			if (++nIdle < 64) { std::this_thread::yield(); continue; }
+
+			// Nothing left to steal, sleep until a counter finishes. The timeout
+			// picks up jobs submitted meanwhile, Submit only wakes the workers.
+			std::unique_lock<std::mutex> lock(mtxDone);
+			cvDone.wait_for(lock, std::chrono::microseconds(200), [this, &counter]()
+				{ return counter.nPending.load(std::memory_order_acquire) == 0 || nQueued.load() > 0; });
+		}
+	}
+
+	void JobSystem::ParallelFor(size_t nBegin, size_t nEnd, size_t nGrain, const std::function<void(size_t, size_t)>& fn)
+	{
+		if (nEnd <= nBegin) return;
+		size_t nCount = nEnd - nBegin;
+		nGrain = std::max<size_t>(1, nGrain);
+
+		// A few chunks per thread so stealing can even out uneven work
+		size_t nChunks = std::min((nCount + nGrain - 1) / nGrain, size_t(ThreadCount()) * 4);
+		if (nChunks <= 1) { fn(nBegin, nEnd); return; }
+
+		size_t nChunk = (nCount + nChunks - 1) / nChunks;
+		Counter counter;
+		for (size_t nFirst = nBegin + nChunk; nFirst < nEnd; nFirst += nChunk)
+		{
+			size_t nLast = std::min(nEnd, nFirst + nChunk);
+			Submit([&fn, nFirst, nLast]() { fn(nFirst, nLast); }, &counter);
+		}
+
+		fn(nBegin, std::min(nEnd, nBegin + nChunk));
+		Wait(counter);
+	}
+
+	bool JobSystem::Pop(Queue& queue, bool bBack, Job& job)
+	{
+		std::lock_guard<std::mutex> lock(queue.mtx);
+		if (queue.jobs.empty()) return false;
+		if (bBack)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		return true;
+	}
+
+	bool JobSystem::RunOne(uint32_t nIndex)
+	{
+		Job job;
+		uint32_t nShared = uint32_t(vQueues.size()) - 1;
+
+		// Own jobs newest first while they are hot in cache, then the oldest of everyone else
+		bool bFound = Pop(*vQueues[nIndex], nIndex != nShared, job);
+		if (!bFound && nIndex != nShared) bFound = Pop(*vQueues[nShared], false, job);
+		// Every worker queue but the own one, threads outside the pool have none
+		for (uint32_t i = 1; !bFound && i <= nShared; i++)
+		{
+			uint32_t nVictim = (nIndex + i) % nShared;
+			if (nVictim != nIndex) bFound = Pop(*vQueues[nVictim], false, job);
+		}
+		if (!bFound) return false;
+
+		nQueued.fetch_sub(1);
+		job.fn();
+		if (job.pCounter && job.pCounter->nPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			// The waiter may free the counter as soon as it sees zero, only the pool is touched here
+			std::lock_guard<std::mutex> lock(mtxDone);
+			cvDone.notify_all();
+		}
+		return true;
+	}
+
+	void JobSystem::WorkerMain(uint32_t nIndex)
+	{
+		pJobOwner = this;
+		nJobIndex = nIndex;
+		profile::SetThreadName("PGE Worker " + std::to_string(nIndex));
+
+		while (bRunning)
+		{
+			if (RunOne(nIndex)) continue;
+
+			std::unique_lock<std::mutex> lock(mtxSleep);
+			cvSleep.wait(lock, [this]() { return !bRunning || nQueued.load() > 0; });
+		}
+	}
+
+	// O------------------------------------------------------------------------------O
+	// | olc::TaskGraph IMPLEMENTATION                                                |
+	// O------------------------------------------------------------------------------O
+	TaskGraph::TaskId TaskGraph::Add(std::function<void()> fnTask)
+	{
+		vTasks.push_back({ std::move(fnTask), {}, 0 });
+		return TaskId(vTasks.size() - 1);
+	}
+
+	void TaskGraph::Precede(TaskId a, TaskId b)
+	{
+		vTasks[a].vNext.push_back(b);
+		vTasks[b].nDepends++;
+	}
+
+	void TaskGraph::Clear()
+	{ vTasks.clear(); }
+
+	size_t TaskGraph::Size() const
+	{ return vTasks.size(); }
+
+	bool TaskGraph::Run(JobSystem& jobs)
+	{
+		// Kahn's walk, every task is reached exactly when there is no cycle
+		std::vector<uint32_t> vDepends(vTasks.size());
+		std::vector<TaskId> vReady;
+		for (TaskId i = 0; i < vTasks.size(); i++)
+		{
+			vDepends[i] = vTasks[i].nDepends;
+			if (vDepends[i] == 0) vReady.push_back(i);
+		}
+		std::vector<TaskId> vRoots = vReady;
+		for (size_t i = 0; i < vReady.size(); i++)
+			for (TaskId next : vTasks[vReady[i]].vNext)
+				if (--vDepends[next] == 0) vReady.push_back(next);
+		if (vReady.size() != vTasks.size()) return false;
+
+		pPending.reset(new std::atomic<uint32_t>[vTasks.size()]);
+		for (TaskId i = 0; i < vTasks.size(); i++)
+			pPending[i].store(vTasks[i].nDepends, std::memory_order_relaxed);
+
+		JobSystem::Counter counter;
+		for (TaskId id : vRoots) Launch(jobs, counter, id);
+		jobs.Wait(counter);
+		return true;
+	}
+
+	void TaskGraph::Launch(JobSystem& jobs, JobSystem::Counter& counter, TaskId id)
+	{
+		jobs.Submit([this, &jobs, &counter, id]()
+		{
+			vTasks[id].fn();
+			// Successors are counted before this task, the counter cannot hit zero early
+			for (TaskId next : vTasks[id].vNext)
+				if (pPending[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+					Launch(jobs, counter, next);
+		}, &counter);
+	}
+
+	// O------------------------------------------------------------------------------O
+	// | olc::Renderer_Pipelined IMPLEMENTATION                                       |
+	// O------------------------------------------------------------------------------O
+	Renderer_Pipelined::Renderer_Pipelined(std::unique_ptr<olc::Renderer> pRenderer)
+		: pRenderer(std::move(pRenderer)), idRenderThread(std::this_thread::get_id())
+	{ }
+
+	std::unique_ptr<olc::Renderer> Renderer_Pipelined::Release()
+	{ return std::move(pRenderer); }
+
+	void Renderer_Pipelined::Post(std::function<void()> fn)
+	{
+		if (std::this_thread::get_id() == idRenderThread) { fn(); return; }
+		Signal([&]() { qCommands.push_back(std::move(fn)); });
+	}
+
+	void Renderer_Pipelined::Call(std::function<void()> fn)
+	{
+		if (std::this_thread::get_id() == idRenderThread) { fn(); return; }
+		bool bDone = false;
+		Post([&]() { fn(); Signal([&]() { bDone = true; }); });
+		Wait([&]() { return bDone; });
+	}
+
+	void Renderer_Pipelined::PrepareDevice()
+	{ Post([this]() { pRenderer->PrepareDevice(); }); }
+
+	olc::rcode Renderer_Pipelined::CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC)
+	{
+		olc::rcode result = olc::FAIL;
+		Call([&]() { result = pRenderer->CreateDevice(params, bFullScreen, bVSYNC); });
+		return result;
+	}
+
+	olc::rcode Renderer_Pipelined::DestroyDevice()
+	{
+		olc::rcode result = olc::FAIL;
+		Call([&]() { result = pRenderer->DestroyDevice(); });
+		return result;
+	}
+
+	void Renderer_Pipelined::DisplayFrame()
+	{ Post([this]() { pRenderer->DisplayFrame(); }); }
+
+	void Renderer_Pipelined::PrepareDrawing()
+	{ Post([this]() { pRenderer->PrepareDrawing(); }); }
+
+	void Renderer_Pipelined::SetDecalMode(const olc::DecalMode& mode)
+	{ Post([this, mode]() { pRenderer->SetDecalMode(mode); }); }
+
+	void Renderer_Pipelined::DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint)
+	{ Post([this, offset, scale, tint]() { pRenderer->DrawLayerQuad(offset, scale, tint); }); }
+
+	void Renderer_Pipelined::DrawDecal(const olc::DecalInstance& decal)
+	{ Post([this, decal]() { pRenderer->DrawDecal(decal); }); }
+
+	uint32_t Renderer_Pipelined::CreateTexture(const uint32_t width, const uint32_t height, const bool filtered, const bool clamp)
+	{
+		uint32_t id = 0;
+		Call([&]() { id = pRenderer->CreateTexture(width, height, filtered, clamp); });
+		return id;
+	}
+
+	void Renderer_Pipelined::UpdateTexture(uint32_t id, olc::Sprite* spr)
+	{
+		if (std::this_thread::get_id() == idRenderThread) { pRenderer->UpdateTexture(id, spr); return; }
 
-	void PixelGameEngine::olc_UpdateKeyState(int32_t key, bool state)
-	{ pKeyNewState[key] = state; }
+		// The sprite may change before the upload runs, send a snapshot
+		auto pCopy = std::make_shared<olc::Sprite>(spr->width, spr->height);
+		pCopy->pColData = spr->pColData;
+		Post([this, id, pCopy]() { pRenderer->ApplyTexture(id); pRenderer->UpdateTexture(id, pCopy.get()); });
+	}
 
-	void PixelGameEngine::olc_UpdateMouseFocus(bool state)
-	{ bHasMouseFocus = state; }
+	void Renderer_Pipelined::ReadTexture(uint32_t id, olc::Sprite* spr)
+	{ Call([&]() { pRenderer->ApplyTexture(id); pRenderer->ReadTexture(id, spr); }); }
 
-	void PixelGameEngine::olc_UpdateKeyFocus(bool state)
-	{ bHasInputFocus = state; }
+	uint32_t Renderer_Pipelined::DeleteTexture(const uint32_t id)
+	{
+		uint32_t result = 0;
+		Call([&]() { result = pRenderer->DeleteTexture(id); });
+		return result;
+	}
 
-	void PixelGameEngine::olc_Reanimate()
-	{ bAtomActive = true; }
+	void Renderer_Pipelined::ApplyTexture(uint32_t id)
+	{ Post([this, id]() { pRenderer->ApplyTexture(id); }); }
 
-	bool PixelGameEngine::olc_IsRunning()
-	{ return bAtomActive; }
+	void Renderer_Pipelined::UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size)
+	{ Post([this, pos, size]() { pRenderer->UpdateViewport(pos, size); }); }
 
-	void PixelGameEngine::olc_Terminate()
-	{ bAtomActive = false; }
+	void Renderer_Pipelined::ClearBuffer(olc::Pixel p, bool bDepth)
+	{ Post([this, p, bDepth]() { pRenderer->ClearBuffer(p, bDepth); }); }
 
-	void PixelGameEngine::EngineThread()
-	{
-		// Allow platform to do stuff here if needed, since its now in the
-		// context of this thread
-		if (platform->ThreadStartUp() == olc::FAIL)	return;
 
-		// Do engine context specific initialisation
-		olc_PrepareEngine();
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameLimiter IMPLEMENTATION                                             |
+	// O------------------------------------------------------------------------------O
+	void FrameLimiter::Wait(float fFps)
+	{
+		using namespace std::chrono;
 
-		// Create user resources as part of this thread
-		for (auto& ext : vExtensions) ext->OnBeforeUserCreate();
-		if (!OnUserCreate()) bAtomActive = false;
-		for (auto& ext : vExtensions) ext->OnAfterUserCreate();
+		if (fFps <= 0.0f)
+		{
+			tPeriod = steady_clock::duration::zero();
+			return;
+		}
 
-		while (bAtomActive)
+		auto tNow = steady_clock::now();
+		auto tNewPeriod = duration_cast<steady_clock::duration>(duration<double>(1.0 / double(fFps)));
+		if (tNewPeriod != tPeriod)
 		{
-			// Run as fast as possible
-			while (bAtomActive) { olc_CoreUpdate(); }
+			// (Re)started or the rate changed, the current frame is the first of the new pace
+			tPeriod = tNewPeriod;
+			tpDeadline = tNow;
+		}
 
-			// Allow the user to free resources if they have overrided the destroy function
-			if (!OnUserDestroy())
-			{
-				// User denied destroy for some reason, so continue running
-				bAtomActive = true;
-			}
+		tpDeadline += tPeriod;
+		if (tpDeadline <= tNow)
+		{
+			stats.nOverruns++;
+			tpDeadline = tNow;
+			return;
 		}
 
-		platform->ThreadCleanUp();
-	}
+		OLC_PROFILE_ZONE("Frame Limit");
 
-	void PixelGameEngine::olc_PrepareEngine()
-	{
-		// Start OpenGL, the context is owned by the game thread
-		if (platform->CreateGraphics(bFullScreen, bEnableVSYNC, vViewPos, vViewSize) == olc::FAIL) return;
+		// Sleep while a whole sleep, pessimistically estimated, still fits
+		auto tpSleepStart = tNow;
+		for (;;)
+		{
+			double fEstimate = fSleepMean + std::sqrt(fSleepM2 / double(nSleepSamples));
+			if (duration<double>(tpDeadline - tNow).count() <= fEstimate) break;
 
-		// Construct default font sheet
-		olc_ConstructFontSheet();
+			std::this_thread::sleep_for(milliseconds(1));
+			auto tWoke = steady_clock::now();
+			RecordSleep(duration<double>(tWoke - tNow).count());
+			tNow = tWoke;
+		}
+		auto tpSpinStart = tNow;
 
-		// Create Primary Layer "0"
-		CreateLayer();
-		vLayers[0].bUpdate = true;
-		vLayers[0].bShow = true;
-		SetDrawTarget(nullptr);
+		// Spin out the rest, yielding so other threads and processes keep the core
+		while (tNow < tpDeadline)
+		{
+			std::this_thread::yield();
+			tNow = steady_clock::now();
+		}
+
+		double fErrorUs = duration<double, std::micro>(tNow - tpDeadline).count();
+		stats.nFrames++;
+		stats.fErrorSumUs += fErrorUs;
+		stats.fAbsErrorSumUs += std::abs(fErrorUs);
+		stats.fMaxErrorUs = std::max(stats.fMaxErrorUs, fErrorUs);
+		if (fErrorUs > FramePacing::LateUs) stats.nLate++;
+		stats.fSleepMs += duration<double, std::milli>(tpSpinStart - tpSleepStart).count();
+		stats.fSpinMs += duration<double, std::milli>(tNow - tpSpinStart).count();
 
-		m_tp1 = std::chrono::system_clock::now();
-		m_tp2 = std::chrono::system_clock::now();
+		// A sleep that overshot past the deadline pushes the next one back,
+		// so the following frame still gets a full period
+		if (tNow - tpDeadline > tPeriod) tpDeadline = tNow;
 	}
 
+	void FrameLimiter::Restart()
+	{ tPeriod = std::chrono::steady_clock::duration::zero(); }
 
-	void PixelGameEngine::olc_CoreUpdate()
-	{
-		// Handle Timing
-		m_tp2 = std::chrono::system_clock::now();
-		std::chrono::duration<float> elapsedTime = m_tp2 - m_tp1;
-		m_tp1 = m_tp2;
+	void FrameLimiter::ResetStats()
+	{ stats = FramePacing(); }
 
-		// Our time per frame coefficient
-		float fElapsedTime = elapsedTime.count();
-		fLastElapsed = fElapsedTime;
+	const FramePacing& FrameLimiter::GetStats() const
+	{ return stats; }
 
-		// Some platforms will need to check for events
-		platform->HandleSystemEvent();
+	// Welford update, the sample count is capped so the estimate keeps
+	// following the scheduler instead of settling on startup behaviour
+	void FrameLimiter::RecordSleep(double fSeconds)
+	{
+		if (nSleepSamples < 256) nSleepSamples++;
+		double fDelta = fSeconds - fSleepMean;
+		fSleepMean += fDelta / double(nSleepSamples);
+		fSleepM2 += fDelta * (fSeconds - fSleepMean);
+		if (nSleepSamples == 256) fSleepM2 *= 255.0 / 256.0;
+	}
 
-		// Compare hardware input states from previous frame
-		auto ScanHardware = [&](HWButton* pKeys, bool* pStateOld, bool* pStateNew, uint32_t nKeyCount)
+
+	// O------------------------------------------------------------------------------O
+	// | olc::profile IMPLEMENTATION                                                  |
+	// O------------------------------------------------------------------------------O
+	namespace profile
+	{
+		// Ring entry other threads may read while the owner overwrites it. The
+		// fields are relaxed atomics, readers check nWritten afterwards to drop
+		// entries that changed under them (a seqlock keyed on nWritten).
+		struct EventSlot
 		{
-			for (uint32_t i = 0; i < nKeyCount; i++)
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<int64_t> start{ 0 };
+			std::atomic<int64_t> end{ 0 };
+
+			void Store(const ZoneEvent& e)
 			{
-				pKeys[i].bPressed = false;
-				pKeys[i].bReleased = false;
-				if (pStateNew[i] != pStateOld[i])
-				{
-					if (pStateNew[i])
-					{
-						pKeys[i].bPressed = !pKeys[i].bHeld;
-						pKeys[i].bHeld = true;
-					}
-					else
-					{
-						pKeys[i].bReleased = true;
-						pKeys[i].bHeld = false;
-					}
-				}
-				pStateOld[i] = pStateNew[i];
+				name.store(e.name, std::memory_order_relaxed);
+				start.store(e.start, std::memory_order_relaxed);
+				end.store(e.end, std::memory_order_relaxed);
 			}
-		};
 
-		ScanHardware(pKeyboardState, pKeyOldState, pKeyNewState, 256);
-		ScanHardware(pMouseState, pMouseOldState, pMouseNewState, nMouseButtons);
+			ZoneEvent Load() const
+			{ return { name.load(std::memory_order_relaxed), start.load(std::memory_order_relaxed), end.load(std::memory_order_relaxed) }; }
+		};
 
-		// Cache mouse coordinates so they remain consistent during frame
-		vMousePos = vMousePosCache;
-		nMouseWheelDelta = nMouseWheelDeltaCache;
-		nMouseWheelDeltaCache = 0;
+		struct ThreadRing
+		{
+			std::vector<EventSlot> vEvents = std::vector<EventSlot>(RingCapacity);
+			// Events ever written, the next one goes to nWritten % RingCapacity
+			std::atomic<uint64_t> nWritten{ 0 };
+			uint32_t nThreadId = 0;
+			std::string sName;
+			// Stats of the last complete window, guarded by the registry lock
+			std::vector<ZoneStats> vPublished;
+
+			// EndFrame() state, only touched by the owning thread
+			struct Accum { int64_t nTotal = 0; int64_t nMax = 0; int64_t nFrame = 0; uint64_t nCalls = 0; };
+			std::map<const char*, Accum> mapWindow;
+			uint64_t nFrameStart = 0;
+			uint32_t nFrames = 0;
+		};
 
-		//	renderer->ClearBuffer(olc::BLACK, true);
+		struct Registry
+		{
+			std::mutex mux;
+			// Rings outlive their threads so a trace still shows them
+			std::vector<std::shared_ptr<ThreadRing>> vRings;
+		};
 
-		// Handle Frame Update
-		bool bExtensionBlockFrame = false;
-		for (auto& ext : vExtensions) bExtensionBlockFrame |= ext->OnBeforeUserUpdate(fElapsedTime);
-		if (!bExtensionBlockFrame)
+		static Registry& GetRegistry()
 		{
-			if (!OnUserUpdate(fElapsedTime)) bAtomActive = false;
+			static Registry registry;
+			return registry;
 		}
-		for (auto& ext : vExtensions) ext->OnAfterUserUpdate(fElapsedTime);
 
-		// Display Frame
-		renderer->UpdateViewport(vViewPos, vViewSize);
-		renderer->ClearBuffer(olc::BLACK, true);
+		// Keeps a thread's ring registered, its stats leave GetZoneStats() with the thread
+		struct RingOwner
+		{
+			std::shared_ptr<ThreadRing> ring;
 
-		// Layer 0 must always exist
-		vLayers[0].bUpdate = true;
-		vLayers[0].bShow = true;
-		SetDecalMode(DecalMode::NORMAL);
-		renderer->PrepareDrawing();
+			~RingOwner()
+			{
+				std::scoped_lock lock(GetRegistry().mux);
+				ring->vPublished.clear();
+			}
+		};
 
-		for (auto layer = vLayers.rbegin(); layer != vLayers.rend(); ++layer)
+		// Created on the first zone of a thread, the only time a lock is taken
+		static ThreadRing& GetThreadRing()
 		{
-			if (layer->bShow)
+			thread_local RingOwner owner = []()
 			{
-				if (layer->funcHook == nullptr)
-				{
-					renderer->ApplyTexture(layer->pDrawTarget.Decal()->id);
-					if (layer->bUpdate)
-					{
-						layer->pDrawTarget.Decal()->Update();
-						layer->bUpdate = false;
-					}
-
-					renderer->DrawLayerQuad(layer->vOffset, layer->vScale, layer->tint);
+				auto r = std::make_shared<ThreadRing>();
+				Registry& reg = GetRegistry();
+				std::scoped_lock lock(reg.mux);
+				r->nThreadId = uint32_t(reg.vRings.size()) + 1;
+				r->sName = "Thread " + std::to_string(r->nThreadId);
+				reg.vRings.push_back(r);
+				return RingOwner{ r };
+			}();
+			return *owner.ring;
+		}
 
-					// Display Decals in order for this layer
-					for (auto& decal : layer->vecDecalInstance)
-						renderer->DrawDecal(decal);
-					layer->vecDecalInstance.clear();
-				}
-				else
-				{
-					// Mwa ha ha.... Have Fun!!!
-					layer->funcHook();
-				}
-			}
+		int64_t Now()
+		{
+			static const auto tpEpoch = std::chrono::steady_clock::now();
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tpEpoch).count();
 		}
 
-		// Present Graphics to screen
-		renderer->DisplayFrame();
+		Zone::Zone(const char* name) : name(name), start(Now())
+		{ }
 
-		// Update Title Bar
-		fFrameTimer += fElapsedTime;
-		nFrameCount++;
-		if (fFrameTimer >= 1.0f)
+		Zone::~Zone()
 		{
-			nLastFPS = nFrameCount;
-			fFrameTimer -= 1.0f;
-			std::string sTitle = "OneLoneCoder.com - Pixel Game Engine - " + sAppName + " - FPS: " + std::to_string(nFrameCount);
-			platform->SetWindowTitle(sTitle);
-			nFrameCount = 0;
+			ThreadRing& ring = GetThreadRing();
+			uint64_t n = ring.nWritten.load(std::memory_order_relaxed);
+			// A reader that sees any of the new fields also sees nWritten == n,
+			// which tells it event n - RingCapacity is gone
+			std::atomic_thread_fence(std::memory_order_release);
+			ring.vEvents[n % RingCapacity].Store({ name, start, Now() });
+			ring.nWritten.store(n + 1, std::memory_order_release);
 		}
-	}
 
-	void PixelGameEngine::olc_ConstructFontSheet()
-	{
-		std::string data;
-		data += "?Q`0001oOch0o01o@F40o0<AGD4090LAGD<090@A7ch0?00O7Q`0600>00000000";
-		data += "O000000nOT0063Qo4d8>?7a14Gno94AA4gno94AaOT0>o3`oO400o7QN00000400";
-		data += "Of80001oOg<7O7moBGT7O7lABET024@aBEd714AiOdl717a_=TH013Q>00000000";
-		data += "720D000V?V5oB3Q_HdUoE7a9@DdDE4A9@DmoE4A;Hg]oM4Aj8S4D84@`00000000";
-		data += "OaPT1000Oa`^13P1@AI[?g`1@A=[OdAoHgljA4Ao?WlBA7l1710007l100000000";
-		data += "ObM6000oOfMV?3QoBDD`O7a0BDDH@5A0BDD<@5A0BGeVO5ao@CQR?5Po00000000";
-		data += "Oc``000?Ogij70PO2D]??0Ph2DUM@7i`2DTg@7lh2GUj?0TO0C1870T?00000000";
-		data += "70<4001o?P<7?1QoHg43O;`h@GT0@:@LB@d0>:@hN@L0@?aoN@<0O7ao0000?000";
-		data += "OcH0001SOglLA7mg24TnK7ln24US>0PL24U140PnOgl0>7QgOcH0K71S0000A000";
-		data += "00H00000@Dm1S007@DUSg00?OdTnH7YhOfTL<7Yh@Cl0700?@Ah0300700000000";
-		data += "<008001QL00ZA41a@6HnI<1i@FHLM81M@@0LG81?O`0nC?Y7?`0ZA7Y300080000";
-		data += "O`082000Oh0827mo6>Hn?Wmo?6HnMb11MP08@C11H`08@FP0@@0004@000000000";
-		data += "00P00001Oab00003OcKP0006@6=PMgl<@440MglH@000000`@000001P00000000";
-		data += "Ob@8@@00Ob@8@Ga13R@8Mga172@8?PAo3R@827QoOb@820@0O`0007`0000007P0";
-		data += "O`000P08Od400g`<3V=P0G`673IP0`@3>1`00P@6O`P00g`<O`000GP800000000";
-		data += "?P9PL020O`<`N3R0@E4HC7b0@ET<ATB0@@l6C4B0O`H3N7b0?P01L3R000000020";
+		void SetThreadName(const std::string& name)
+		{
+			if (!Enabled) return;
+			ThreadRing& ring = GetThreadRing();
+			std::scoped_lock lock(GetRegistry().mux);
+			ring.sName = name;
+		}
 
-		fontSprite = new olc::Sprite(128, 48);
-		int px = 0, py = 0;
-		for (size_t b = 0; b < 1024; b += 4)
+		void EndFrame()
 		{
-			uint32_t sym1 = (uint32_t)data[b + 0] - 48;
-			uint32_t sym2 = (uint32_t)data[b + 1] - 48;
-			uint32_t sym3 = (uint32_t)data[b + 2] - 48;
-			uint32_t sym4 = (uint32_t)data[b + 3] - 48;
-			uint32_t r = sym1 << 18 | sym2 << 12 | sym3 << 6 | sym4;
+			if (!Enabled) return;
+			ThreadRing& ring = GetThreadRing();
 
-			for (int i = 0; i < 24; i++)
+			// Zones closed since the last frame, minus any the ring already overwrote
+			uint64_t nEnd = ring.nWritten.load(std::memory_order_relaxed);
+			uint64_t nBegin = std::max(ring.nFrameStart, nEnd > RingCapacity ? nEnd - RingCapacity : 0);
+			for (auto& [name, acc] : ring.mapWindow) acc.nFrame = 0;
+			for (uint64_t i = nBegin; i < nEnd; i++)
 			{
-				int k = r & (1 << i) ? 255 : 0;
-				fontSprite->SetPixel(px, py, olc::Pixel(k, k, k, k));
-				if (++py == 48) { px++; py = 0; }
+				ZoneEvent e = ring.vEvents[i % RingCapacity].Load();
+				auto& acc = ring.mapWindow[e.name];
+				acc.nFrame += e.end - e.start;
+				acc.nCalls++;
 			}
-		}
+			for (auto& [name, acc] : ring.mapWindow)
+			{
+				acc.nTotal += acc.nFrame;
+				acc.nMax = std::max(acc.nMax, acc.nFrame);
+			}
+			ring.nFrameStart = nEnd;
 
-		fontDecal = new olc::Decal(fontSprite);
+			if (++ring.nFrames < WindowFrames) return;
 
-		constexpr std::array<uint8_t, 96> vSpacing = { {
-			0x03,0x25,0x16,0x08,0x07,0x08,0x08,0x04,0x15,0x15,0x08,0x07,0x15,0x07,0x24,0x08,
-			0x08,0x17,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x24,0x15,0x06,0x07,0x16,0x17,
-			0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x08,0x17,0x08,0x08,0x17,0x08,0x08,0x08,
-			0x08,0x08,0x08,0x08,0x17,0x08,0x08,0x08,0x08,0x17,0x08,0x15,0x08,0x15,0x08,0x08,
-			0x24,0x18,0x17,0x17,0x17,0x17,0x17,0x17,0x17,0x33,0x17,0x17,0x33,0x18,0x17,0x17,
-			0x17,0x17,0x17,0x17,0x07,0x17,0x17,0x18,0x18,0x17,0x17,0x07,0x33,0x07,0x08,0x00, } };
+			std::vector<ZoneStats> vStats;
+			for (auto& [name, acc] : ring.mapWindow)
+			{
+				if (acc.nCalls == 0) continue;
+				vStats.push_back({ name, double(acc.nTotal) / 1e6 / ring.nFrames, double(acc.nMax) / 1e6, double(acc.nCalls) / ring.nFrames });
+			}
+			std::sort(vStats.begin(), vStats.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.avgMs > b.avgMs; });
+			ring.mapWindow.clear();
+			ring.nFrames = 0;
 
-		for (auto c : vSpacing) vFontSpacing.push_back({ c >> 4, c & 15 });
+			std::scoped_lock lock(GetRegistry().mux);
+			ring.vPublished = std::move(vStats);
+		}
 
-	}
+		std::vector<ZoneStats> GetZoneStats()
+		{
+			std::vector<ZoneStats> vStats;
+			{
+				Registry& reg = GetRegistry();
+				std::scoped_lock lock(reg.mux);
+				for (auto& ring : reg.vRings)
+				{
+					for (const ZoneStats& zone : ring->vPublished)
+					{
+						auto it = std::find_if(vStats.begin(), vStats.end(), [&zone](const ZoneStats& s) { return s.name == zone.name; });
+						if (it == vStats.end()) { vStats.push_back(zone); continue; }
+						it->avgMs += zone.avgMs;
+						it->maxMs = std::max(it->maxMs, zone.maxMs);
+						it->callsPerFrame += zone.callsPerFrame;
+					}
+				}
+			}
+			std::sort(vStats.begin(), vStats.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.avgMs > b.avgMs; });
+			return vStats;
+		}
 
-	void PixelGameEngine::pgex_Register(olc::PGEX* pgex)
-	{
-		if (std::find(vExtensions.begin(), vExtensions.end(), pgex) == vExtensions.end())
-			vExtensions.push_back(pgex);			
-	}
+		bool WriteChromeTrace(const std::string& sFile)
+		{
+			std::ofstream file(sFile);
+			if (!file.is_open()) return false;
 
+			Registry& reg = GetRegistry();
+			std::scoped_lock lock(reg.mux);
 
-	PGEX::PGEX(bool bHook) { if(bHook) pge->pgex_Register(this); }
-	void PGEX::OnBeforeUserCreate() {}
-	void PGEX::OnAfterUserCreate()	{}
-	bool PGEX::OnBeforeUserUpdate(float& fElapsedTime) { return false; }
-	void PGEX::OnAfterUserUpdate(float fElapsedTime) {}
+			char buf[256];
+			std::vector<ZoneEvent> vCopy;
+			const char* sep = "\n";
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			for (auto& ring : reg.vRings)
+			{
+				file << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->nThreadId
+					<< ",\"args\":{\"name\":\"" << ring->sName << "\"}}";
+				sep = ",\n";
+
+				// Other threads keep recording, copy first and then drop the oldest
+				// events if the owner got around to overwriting them meanwhile
+				uint64_t nEnd = ring->nWritten.load(std::memory_order_acquire);
+				uint64_t nBegin = nEnd > RingCapacity ? nEnd - RingCapacity : 0;
+				vCopy.clear();
+				for (uint64_t i = nBegin; i < nEnd; i++)
+					vCopy.push_back(ring->vEvents[i % RingCapacity].Load());
+				std::atomic_thread_fence(std::memory_order_acquire);
+				uint64_t nNow = ring->nWritten.load(std::memory_order_relaxed);
+				// Event i is safe while the writer has not reached i + RingCapacity
+				uint64_t nValid = nNow >= RingCapacity ? nNow - RingCapacity + 1 : 0;
+
+				for (uint64_t i = std::max(nBegin, nValid); i < nEnd; i++)
+				{
+					const ZoneEvent& e = vCopy[i - nBegin];
+					std::snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						e.name, ring->nThreadId, double(e.start) / 1000.0, double(e.end - e.start) / 1000.0);
+					file << sep << buf;
+				}
+			}
+			file << "\n]}\n";
+			return file.good();
+		}
+	}
 
-	// Need a couple of statics as these are singleton instances
-	// read from multiple locations
-	std::atomic<bool> PixelGameEngine::bAtomActive{ false };
-	olc::PixelGameEngine* olc::PGEX::pge = nullptr;
-	olc::PixelGameEngine* olc::Platform::ptrPGE = nullptr;
-	olc::PixelGameEngine* olc::Renderer::ptrPGE = nullptr;
+	// Engine state lives in each PixelGameEngine, only the image loader
+	// is shared and the current engine is tracked per thread
+	thread_local olc::PixelGameEngine* olc::PGEX::pge = nullptr;
 	std::unique_ptr<ImageLoader> olc::Sprite::loader = nullptr;
 };
 #pragma endregion 
@@ -3386,6 +5345,7 @@ namespace olc
 		bool bSync = false;
 		olc::DecalMode nDecalMode = olc::DecalMode(-1); // Thanks Gusgo & Bispoo
 		olc::DecalStructure nDecalStructure = olc::DecalStructure(-1);
+		bool bPremultipliedBlend = false;
 #if defined(OLC_PLATFORM_X11)
 		X11::Display* olc_Display = nullptr;
 		X11::Window* olc_Window = nullptr;
@@ -3522,21 +5482,27 @@ namespace olc
 			glEnable(GL_BLEND);
 			nDecalMode = DecalMode::NORMAL;
 			nDecalStructure = DecalStructure::FAN;
+			bPremultipliedBlend = false;
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		}
 
 		void SetDecalMode(const olc::DecalMode& mode)
+		{ SetDecalMode(mode, false); }
+
+		void SetDecalMode(const olc::DecalMode& mode, bool bPremultiplied)
 		{
-			if (mode != nDecalMode)
+			if (mode != nDecalMode || bPremultiplied != bPremultipliedBlend)
 			{
+				// Premultiplied textures already carry their alpha in the colour
+				GLenum nSrcFactor = bPremultiplied ? GL_ONE : GL_SRC_ALPHA;
 				switch (mode)
 				{
 				case olc::DecalMode::NORMAL:
 				case olc::DecalMode::MODEL3D:
-					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+					glBlendFunc(nSrcFactor, GL_ONE_MINUS_SRC_ALPHA);
 					break;
 				case olc::DecalMode::ADDITIVE:
-					glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+					glBlendFunc(nSrcFactor, GL_ONE);
 					break;
 				case olc::DecalMode::MULTIPLICATIVE:
 					glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
@@ -3548,11 +5514,12 @@ namespace olc
 					glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
 					break;
 				case olc::DecalMode::WIREFRAME:
-					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+					glBlendFunc(nSrcFactor, GL_ONE_MINUS_SRC_ALPHA);
 					break;
 				}
 
 				nDecalMode = mode;
+				bPremultipliedBlend = bPremultiplied;
 			}
 		}
 
@@ -3573,7 +5540,8 @@ namespace olc
 
 		void DrawDecal(const olc::DecalInstance& decal) override
 		{
-			SetDecalMode(decal.mode);
+			const bool bPremultiplied = decal.decal != nullptr && decal.decal->premultiplied;
+			SetDecalMode(decal.mode, bPremultiplied);
 
 			if (decal.decal == nullptr)
 				glBindTexture(GL_TEXTURE_2D, 0);
@@ -3636,7 +5604,14 @@ namespace olc
 				// Render as 2D Spatial entity
 				for (uint32_t n = 0; n < decal.points; n++)
 				{
-					glColor4ub(decal.tint[n].r, decal.tint[n].g, decal.tint[n].b, decal.tint[n].a);
+					if (bPremultiplied)
+					{
+						// Tint must be premultiplied too, or fading decals would brighten
+						const olc::Pixel& t = decal.tint[n];
+						glColor4ub(uint8_t(t.r * t.a / 255), uint8_t(t.g * t.a / 255), uint8_t(t.b * t.a / 255), t.a);
+					}
+					else
+						glColor4ub(decal.tint[n].r, decal.tint[n].g, decal.tint[n].b, decal.tint[n].a);
 					glTexCoord4f(decal.uv[n].x, decal.uv[n].y, 0.0f, decal.w[n]);
 					glVertex2f(decal.pos[n].x, decal.pos[n].y);
 				}
@@ -3824,6 +5799,7 @@ namespace olc
 #endif
 		bool bSync = false;
 		olc::DecalMode nDecalMode = olc::DecalMode(-1); // Thanks Gusgo & Bispoo
+		bool bPremultipliedBlend = false;
 #if defined(OLC_PLATFORM_X11)
 		X11::Display* olc_Display = nullptr;
 		X11::Window* olc_Window = nullptr;
@@ -3863,7 +5839,7 @@ namespace olc
 			olc::Pixel col;
 		};
 
-		locVertex pVertexMem[OLC_MAX_VERTS];
+		std::vector<locVertex> pVertexMem = std::vector<locVertex>(OLC_MAX_VERTS);
 
 		olc::Renderable rendBlankQuad;
 
@@ -4103,6 +6079,7 @@ namespace olc
 		{
 			glEnable(GL_BLEND);
 			nDecalMode = DecalMode::NORMAL;
+			bPremultipliedBlend = false;
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			locUseProgram(m_nQuadShader);
 			locBindVertexArray(m_vaQuad);
@@ -4115,20 +6092,25 @@ namespace olc
 		}
 
 		void SetDecalMode(const olc::DecalMode& mode) override
+		{ SetDecalMode(mode, false); }
+
+		void SetDecalMode(const olc::DecalMode& mode, bool bPremultiplied)
 		{
-			if (mode != nDecalMode)
+			if (mode != nDecalMode || bPremultiplied != bPremultipliedBlend)
 			{
+				GLenum nSrcFactor = bPremultiplied ? GL_ONE : GL_SRC_ALPHA;
 				switch (mode)
 				{
-				case olc::DecalMode::NORMAL: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	break;
-				case olc::DecalMode::ADDITIVE: glBlendFunc(GL_SRC_ALPHA, GL_ONE); break;
+				case olc::DecalMode::NORMAL: glBlendFunc(nSrcFactor, GL_ONE_MINUS_SRC_ALPHA);	break;
+				case olc::DecalMode::ADDITIVE: glBlendFunc(nSrcFactor, GL_ONE); break;
 				case olc::DecalMode::MULTIPLICATIVE: glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);	break;
 				case olc::DecalMode::STENCIL: glBlendFunc(GL_ZERO, GL_SRC_ALPHA); break;
 				case olc::DecalMode::ILLUMINATE: glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);	break;
-				case olc::DecalMode::WIREFRAME: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	break;
+				case olc::DecalMode::WIREFRAME: glBlendFunc(nSrcFactor, GL_ONE_MINUS_SRC_ALPHA);	break;
 				}
 
 				nDecalMode = mode;
+				bPremultipliedBlend = bPremultiplied;
 			}
 		}
 
@@ -4148,7 +6130,8 @@ namespace olc
 
 		void DrawDecal(const olc::DecalInstance& decal) override
 		{
-			SetDecalMode(decal.mode);
+			const bool bPremultiplied = decal.decal != nullptr && decal.decal->premultiplied;
+			SetDecalMode(decal.mode, bPremultiplied);
 			if (decal.decal == nullptr)
 				glBindTexture(GL_TEXTURE_2D, rendBlankQuad.Decal()->id);
 			else
@@ -4156,15 +6139,35 @@ namespace olc
 
 			locBindBuffer(0x8892, m_vbQuad);
 
+			// Batched instances (LIST structure) can carry far more than a single quad
+			if (decal.points > pVertexMem.size())
+				pVertexMem.resize(decal.points);
+
 			for (uint32_t i = 0; i < decal.points; i++)
 				pVertexMem[i] = { { decal.pos[i].x, decal.pos[i].y, decal.w[i] }, { decal.uv[i].x, decal.uv[i].y }, decal.tint[i] };
 
-			locBufferData(0x8892, sizeof(locVertex) * decal.points, pVertexMem, 0x88E0);
+			if (bPremultiplied)
+			{
+				for (uint32_t i = 0; i < decal.points; i++)
+				{
+					olc::Pixel& t = pVertexMem[i].col;
+					t = olc::Pixel(uint8_t(t.r * t.a / 255), uint8_t(t.g * t.a / 255), uint8_t(t.b * t.a / 255), t.a);
+				}
+			}
+
+			locBufferData(0x8892, sizeof(locVertex) * decal.points, pVertexMem.data(), 0x88E0);
 
 			if (nDecalMode == DecalMode::WIREFRAME)
 				glDrawArrays(GL_LINE_LOOP, 0, decal.points);
 			else
-				glDrawArrays(GL_TRIANGLE_FAN, 0, decal.points);
+			{
+				if (decal.structure == olc::DecalStructure::FAN)
+					glDrawArrays(GL_TRIANGLE_FAN, 0, decal.points);
+				else if (decal.structure == olc::DecalStructure::STRIP)
+					glDrawArrays(GL_TRIANGLE_STRIP, 0, decal.points);
+				else if (decal.structure == olc::DecalStructure::LIST)
+					glDrawArrays(GL_TRIANGLES, 0, decal.points);
+			}
 		}
 
 		uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered, const bool clamp) override
@@ -4602,16 +6605,16 @@ namespace olc
 
 		virtual olc::rcode ThreadCleanUp() override
 		{
-			renderer->DestroyDevice();
+			ptrPGE->renderer->DestroyDevice();
 			PostMessage(olc_hWnd, WM_DESTROY, 0, 0);
 			return olc::OK;
 		}
 
 		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
 		{
-			if (renderer->CreateDevice({ olc_hWnd }, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			if (ptrPGE->renderer->CreateDevice({ olc_hWnd }, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
 			{
-				renderer->UpdateViewport(vViewPos, vViewSize);
+				ptrPGE->renderer->UpdateViewport(vViewPos, vViewSize);
 				return olc::rcode::OK;
 			}
 			else
@@ -4733,6 +6736,14 @@ namespace olc
 		// Windows Event Handler - this is statically connected to the windows event system
 		static LRESULT CALLBACK olc_WindowEvent(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		{
+			// Each window carries its own platform, handed over by CreateWindowEx
+			if (uMsg == WM_NCCREATE)
+				SetWindowLongPtr(hWnd, GWLP_USERDATA, LONG_PTR(((CREATESTRUCT*)lParam)->lpCreateParams));
+			auto* pPlatform = (Platform_Windows*)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+			if (pPlatform == nullptr || pPlatform->ptrPGE == nullptr)
+				return DefWindowProc(hWnd, uMsg, wParam, lParam);
+			olc::PixelGameEngine* ptrPGE = pPlatform->ptrPGE;
+
 			switch (uMsg)
 			{
 			case WM_MOUSEMOVE:
@@ -4807,15 +6818,15 @@ namespace olc
 
 		virtual olc::rcode ThreadCleanUp() override
 		{
-			renderer->DestroyDevice();
+			ptrPGE->renderer->DestroyDevice();
 			return olc::OK;
 		}
 
 		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
 		{
-			if (renderer->CreateDevice({ olc_Display, &olc_Window, olc_VisualInfo }, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			if (ptrPGE->renderer->CreateDevice({ olc_Display, &olc_Window, olc_VisualInfo }, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
 			{
-				renderer->UpdateViewport(vViewPos, vViewSize);
+				ptrPGE->renderer->UpdateViewport(vViewPos, vViewSize);
 				return olc::rcode::OK;
 			}
 			else
@@ -5014,6 +7025,19 @@ namespace olc
 			}
 			return olc::OK;
 		}
+
+		virtual olc::rcode WaitSystemEvent(std::chrono::microseconds tTimeout) override
+		{
+			using namespace X11;
+			// Requests still buffered in Xlib would never be answered otherwise
+			XFlush(olc_Display);
+			if (XPending(olc_Display)) return olc::OK;
+
+			pollfd pfd = { ConnectionNumber(olc_Display), POLLIN, 0 };
+			int nTimeoutMs = int((tTimeout.count() + 999) / 1000);
+			if (poll(&pfd, 1, nTimeoutMs) < 0 && errno != EINTR) return olc::FAIL;
+			return olc::OK;
+		}
 	};
 }
 #endif
@@ -5040,6 +7064,8 @@ namespace olc {
 	{
 	public:
 		static std::atomic<bool>* bActiveRef;
+		// GLUT callbacks are plain functions, so there is one engine per process here
+		static olc::PixelGameEngine* ptrPGE;
 
 		virtual olc::rcode ApplicationStartUp() override {
 			return olc::rcode::OK;
@@ -5057,15 +7083,15 @@ namespace olc {
 
 		virtual olc::rcode ThreadCleanUp() override
 		{
-			renderer->DestroyDevice();
+			ptrPGE->renderer->DestroyDevice();
 			return olc::OK;
 		}
 
 		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
 		{
-			if (renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			if (ptrPGE->renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
 			{
-				renderer->UpdateViewport(vViewPos, vViewSize);
+				ptrPGE->renderer->UpdateViewport(vViewPos, vViewSize);
 				return olc::rcode::OK;
 			}
 			else
@@ -5077,8 +7103,8 @@ namespace olc {
 				*bActiveRef = true;
 				return;
 			}
-			platform->ThreadCleanUp();
-			platform->ApplicationCleanUp();
+			ptrPGE->platform->ThreadCleanUp();
+			ptrPGE->platform->ApplicationCleanUp();
 			exit(0);
 		}
 
@@ -5140,7 +7166,7 @@ namespace olc {
 			assert(resultAddMethod);
 #endif
 
-			renderer->PrepareDevice();
+			ptrPGE->renderer->PrepareDevice();
 
 			if (bFullScreen)
 			{
@@ -5291,10 +7317,13 @@ namespace olc {
 	};
 
 	std::atomic<bool>* Platform_GLUT::bActiveRef{ nullptr };
+	olc::PixelGameEngine* Platform_GLUT::ptrPGE{ nullptr };
 
 	//Custom Start
 	olc::rcode PixelGameEngine::Start()
 	{
+		MakeCurrent();
+		Platform_GLUT::ptrPGE = this;
 		if (platform->ApplicationStartUp() != olc::OK) return olc::FAIL;
 
 		// Construct the window
@@ -5348,7 +7377,7 @@ namespace olc {
 extern "C" 
 {
 	EMSCRIPTEN_KEEPALIVE inline int olc_OnPageUnload()
-	{ olc::platform->ApplicationCleanUp(); return 0; }
+	{ olc::PixelGameEngine::GetCurrent()->platform->ApplicationCleanUp(); return 0; }
 }
 
 namespace olc
@@ -5356,6 +7385,8 @@ namespace olc
 	class Platform_Emscripten : public olc::Platform
 	{
 	public:
+		// Browser callbacks are plain functions, so there is one engine per page
+		static olc::PixelGameEngine* ptrPGE;
 
 		virtual olc::rcode ApplicationStartUp() override 
 		{ return olc::rcode::OK; }
@@ -5367,13 +7398,13 @@ namespace olc
 		{ return olc::rcode::OK; }
 
 		virtual olc::rcode ThreadCleanUp() override
-		{ renderer->DestroyDevice(); return olc::OK; }
+		{ ptrPGE->renderer->DestroyDevice(); return olc::OK; }
 
 		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
 		{
-			if (renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			if (ptrPGE->renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
 			{
-				renderer->UpdateViewport(vViewPos, vViewSize);
+				ptrPGE->renderer->UpdateViewport(vViewPos, vViewSize);
 				return olc::rcode::OK;
 			}
 			else
@@ -5700,13 +7731,13 @@ namespace olc
 
 		static void MainLoop()
 		{
-			olc::Platform::ptrPGE->olc_CoreUpdate();
+			ptrPGE->olc_CoreUpdate();
 			if (!ptrPGE->olc_IsRunning())
 			{
 				if (ptrPGE->OnUserDestroy())
 				{
 					emscripten_cancel_main_loop();
-					platform->ApplicationCleanUp();
+					ptrPGE->platform->ApplicationCleanUp();
 				}
 				else
 				{
@@ -5716,10 +7747,14 @@ namespace olc
 		}
 	};
 
+	olc::PixelGameEngine* Platform_Emscripten::ptrPGE{ nullptr };
+
 	//Emscripten needs a special Start function
 	//Much of this is usually done in EngineThread, but that isn't used here
 	olc::rcode PixelGameEngine::Start()
 	{
+		MakeCurrent();
+		Platform_Emscripten::ptrPGE = this;
 		if (platform->ApplicationStartUp() != olc::OK) return olc::FAIL;
 
 		// Construct the window
@@ -5758,7 +7793,7 @@ extern "C"
 	{
 		emscripten_set_canvas_element_size("#canvas", width, height);
 		// Thanks slavka
-		((olc::Platform_Emscripten*)olc::platform.get())->UpdateWindowSize(width, height);
+		((olc::Platform_Emscripten*)olc::Platform_Emscripten::ptrPGE->platform.get())->UpdateWindowSize(width, height);
 	}
 }
 
@@ -5782,21 +7817,26 @@ namespace olc
 
 #if !defined(OLC_PGE_HEADLESS)
 
+		// The image loader is shared, so only the first engine installs it
+		static std::once_flag onceLoader;
+		std::call_once(onceLoader, []()
+		{
 #if defined(OLC_IMAGE_GDI)
-		olc::Sprite::loader = std::make_unique<olc::ImageLoader_GDIPlus>();
+			olc::Sprite::loader = std::make_unique<olc::ImageLoader_GDIPlus>();
 #endif
 
 #if defined(OLC_IMAGE_LIBPNG)
-		olc::Sprite::loader = std::make_unique<olc::ImageLoader_LibPNG>();
+			olc::Sprite::loader = std::make_unique<olc::ImageLoader_LibPNG>();
 #endif
 
 #if defined(OLC_IMAGE_STB)
-		olc::Sprite::loader = std::make_unique<olc::ImageLoader_STB>();
+			olc::Sprite::loader = std::make_unique<olc::ImageLoader_STB>();
 #endif
 
 #if defined(OLC_IMAGE_CUSTOM_EX)
-		olc::Sprite::loader = std::make_unique<OLC_IMAGE_CUSTOM_EX>();
+			olc::Sprite::loader = std::make_unique<OLC_IMAGE_CUSTOM_EX>();
 #endif
+		});
 
 
 
@@ -5851,7 +7891,7 @@ namespace olc
 		platform->ptrPGE = this;
 		renderer->ptrPGE = this;
 #else
-		olc::Sprite::loader = nullptr;
+		// Headless hosts may install their own image loader, keep it
 		platform = nullptr;
 		renderer = nullptr;
 #endif
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
 namespace ray {
     ///////////////////////////////////////////
     // Common Type Define
@@ -0,0 +1,123 @@
+// Prints a flight recorder dump (.pgefr) written by the engine on a frame spike
+//
+//   PGE_FlightDump <file.pgefr> [--csv]
+//
+// The table lists every recorded frame oldest first, the trigger frame is
+// marked with '>'. The summary compares the trigger frame with the median
+// of the other frames to show which phase grew.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "FlightRecorder.h"
+
+namespace {
+    using PGEApp::FlightHeader;
+    using PGEApp::FlightRecord;
+
+    struct Phase {
+        const char *name;
+        float FlightRecord::*field;
+    };
+
+    const Phase Phases[] = {
+            {"input",   &FlightRecord::inputMs},
+            {"update",  &FlightRecord::updateMs},
+            {"  lua",   &FlightRecord::luaMs},
+            {"  gc",    &FlightRecord::gcMs},
+            {"layers",  &FlightRecord::layersMs},
+            {"display", &FlightRecord::displayMs},
+    };
+
+    void PrintCsv(const std::vector<FlightRecord> &records) {
+        std::printf("frame,frame_ms,input_ms,update_ms,lua_ms,gc_ms,layers_ms,display_ms,"
+                    "gc_steps,gc_cycles,gc_full,heap_kb,external_kb,decals,draw_calls,upload_bytes\n");
+        for (const FlightRecord &r : records) {
+            std::printf("%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%u,%u,%u,%u,%u,%u,%u,%u\n",
+                        r.frame, r.frameMs, r.inputMs, r.updateMs, r.luaMs, r.gcMs, r.layersMs, r.displayMs,
+                        r.gcSteps, r.gcCycles, r.gcFullCollect, r.heapKB, r.externalKB, r.decals, r.drawCalls, r.uploadBytes);
+        }
+    }
+
+    void PrintTable(const FlightHeader &header, const std::vector<FlightRecord> &records) {
+        std::printf("%u frames, budget %.2f ms\n\n", header.count, header.budgetMs);
+        std::printf("  %8s %8s %7s %7s %7s %7s %7s %7s %5s %3s %8s %8s %6s %6s %10s\n",
+                    "frame", "ms", "input", "update", "lua", "gc", "layers", "display",
+                    "steps", "cyc", "heap kb", "ext kb", "decals", "draws", "upload");
+
+        for (size_t i = 0; i < records.size(); i++) {
+            const FlightRecord &r = records[i];
+            std::printf("%c %8u %8.2f %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f %5u %3u%c %8u %8u %6u %6u %10u\n",
+                        i == header.trigger ? '>' : ' ', r.frame, r.frameMs, r.inputMs, r.updateMs, r.luaMs, r.gcMs,
+                        r.layersMs, r.displayMs, r.gcSteps, r.gcCycles, r.gcFullCollect ? '!' : ' ',
+                        r.heapKB, r.externalKB, r.decals, r.drawCalls, r.uploadBytes);
+        }
+    }
+
+    float Median(std::vector<float> values) {
+        if (values.empty())
+            return 0.0f;
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    }
+
+    void PrintSummary(const FlightHeader &header, const std::vector<FlightRecord> &records) {
+        if (header.trigger >= records.size())
+            return;
+
+        const FlightRecord &spike = records[header.trigger];
+        std::printf("\nframe %u took %.2f ms, typical frames below\n", spike.frame, spike.frameMs);
+
+        for (const Phase &phase : Phases) {
+            std::vector<float> others;
+            for (size_t i = 0; i < records.size(); i++) {
+                if (i != header.trigger)
+                    others.push_back(records[i].*phase.field);
+            }
+
+            float typical = Median(others);
+            float value = spike.*phase.field;
+            std::printf("  %-8s %8.2f ms  median %8.2f ms  %+8.2f ms\n", phase.name, value, typical, value - typical);
+        }
+
+        if (spike.gcFullCollect)
+            std::printf("  the collector ran a full collection in this frame\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    bool csv = false;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--csv"))
+            csv = true;
+        else if (path == nullptr)
+            path = argv[i];
+        else
+            usage = true;
+    }
+
+    if (path == nullptr || usage) {
+        std::fprintf(stderr, "usage: %s <file.pgefr> [--csv]\n", argv[0]);
+        return 1;
+    }
+
+    FlightHeader header;
+    std::vector<FlightRecord> records;
+    if (!PGEApp::FlightRecorder::Read(path, header, records)) {
+        std::fprintf(stderr, "%s: not a flight recorder dump\n", path);
+        return 1;
+    }
+
+    if (csv) {
+        PrintCsv(records);
+    } else {
+        PrintTable(header, records);
+        PrintSummary(header, records);
+    }
+    return 0;
+}